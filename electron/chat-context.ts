@@ -1,5 +1,7 @@
+import { getClickWindowInfo } from './mouse-block.js'
 import { getSelectedText } from './selected-text.js'
-import { getWindowInfoAtPoint } from './window-capture.js'
+import { getWindowInfoAtPoint, type WindowInfo } from './window-capture.js'
+import { getForegroundWindowInfo } from './window-watch.js'
 
 export type WindowBounds = { x: number; y: number; width: number; height: number }
 
@@ -23,17 +25,59 @@ type CaptureChatContextOptions = {
   excludeCurrentProcessWindows?: boolean
 }
 
+const containsPoint = (info: WindowInfo, point: { x: number; y: number }) =>
+  point.x >= info.bounds.x &&
+  point.x < info.bounds.x + info.bounds.width &&
+  point.y >= info.bounds.y &&
+  point.y < info.bounds.y + info.bounds.height
+
+// Selection and element text via the helper's in-process UI Automation
+// reads; bounded so a hung target app cannot hold up the chat context.
+const UIA_BUDGET_MS = 400
+
+const captureUiaContext = (
+  point: { x: number; y: number },
+  excludePids: number[] | undefined,
+): Promise<WindowInfo | null> => {
+  if (process.platform !== 'win32') return Promise.resolve(null)
+  return getWindowInfoAtPoint(point.x, point.y, { excludePids, uia: true, uiaBudgetMs: UIA_BUDGET_MS })
+}
+
+const resolveWindowInfo = async (
+  point: { x: number; y: number },
+  excludePids: number[] | undefined,
+): Promise<WindowInfo | null> => {
+  // The helper always excludes our own pid, so only trust it when we do too.
+  const clickWindow = excludePids?.includes(process.pid) ? getClickWindowInfo(point.x, point.y) : null
+  if (clickWindow) {
+    const info = await clickWindow
+    if (info !== undefined) return info
+  }
+  const foreground = getForegroundWindowInfo()
+  if (foreground && containsPoint(foreground, point)) return foreground
+  return getWindowInfoAtPoint(point.x, point.y, { excludePids })
+}
+
 export const captureChatContext = async (
   point: { x: number; y: number },
   options?: CaptureChatContextOptions,
 ): Promise<ChatContext> => {
   const excludePids = options?.excludeCurrentProcessWindows ? [process.pid] : undefined
 
-  // Capture selected text and window metadata in parallel.
-  const [selectedText, windowInfo] = await Promise.all([
-    getSelectedText(),
-    getWindowInfoAtPoint(point.x, point.y, { excludePids }),
+  // Capture selected text and window metadata in parallel, cheapest source
+  // first: the window mouse_block resolved for this click, then the watched
+  // foreground window when it covers the point, then a point query. The
+  // selection comes from the helper's UIA read; the PowerShell query is the
+  // fallback when UIA is unavailable or ran out of budget. It starts right
+  // away too, so the fallback does not wait out the UIA budget first.
+  const fallbackSelection = getSelectedText()
+  const [uiaInfo, resolvedInfo] = await Promise.all([
+    captureUiaContext(point, excludePids),
+    resolveWindowInfo(point, excludePids),
   ])
+  const uia = uiaInfo?.uia
+  const selectedText = uia?.selection ?? (uia && !uia.timedOut ? null : await fallbackSelection)
+  const windowInfo = resolvedInfo ?? uiaInfo
 
   const window = windowInfo && (windowInfo.title || windowInfo.process)
     ? {
@@ -14,8 +14,20 @@ import {
 } from './radial-window.js'
 import { createRegionCaptureWindow, showRegionCaptureWindow, hideRegionCaptureWindow, getRegionCaptureWindow } from './region-capture-window.js'
 import { captureChatContext, type ChatContext } from './chat-context.js'
-import { captureWindowScreenshot, type WindowInfo } from './window-capture.js'
+import {
+  captureScreenRect,
+  captureWindowScreenshot,
+  dropPrefetchedWindowScreenshot,
+  prefetchWindowScreenshot,
+  setCaptureTimingsListener,
+  stopWindowInfoServer,
+  takePrefetchedWindowScreenshot,
+  windowDipBounds,
+  type WindowInfo,
+} from './window-capture.js'
 import { initSelectedTextProcess, cleanupSelectedTextProcess, getSelectedText } from './selected-text.js'
+import { startWindowWatch, stopWindowWatch } from './window-watch.js'
+import { stopNativeHost } from './native-host.js'
 import {
   createModifierOverlay,
   showModifierOverlay,
@@ -198,6 +210,10 @@ const miniSize = {
 const RADIAL_SIZE = 280
 const MINI_SHELL_ANIM_MS = 140
 const CAPTURE_OVERLAY_HIDE_DELAY_MS = 80
+// Hover thumbnails only drive the vacuum animation, so cap their size natively.
+const WINDOW_THUMBNAIL_MAX_SIZE = 1280
+const WINDOW_THUMBNAIL_QUALITY = 80
+const SLOW_CAPTURE_WARN_MS = 500
 const TOKEN_REFRESH_INTERVAL_MS = 60 * 1000
 const STELLA_SESSION_PARTITION = 'persist:Stella'
 const SECURITY_POLICY_VERSION = 1
@@ -1301,6 +1317,7 @@ const finalizeRegionCapture = async (selection: RegionSelection) => {
   }
 
   const resolve = pendingRegionCaptureResolve
+  dropPrefetchedWindowScreenshot()
   hideRegionCaptureWindow()
   hideRadialWindow()
   hideModifierOverlay()
@@ -1314,20 +1331,28 @@ const finalizeRegionCapture = async (selection: RegionSelection) => {
     const regionBounds = getRegionCaptureWindow()?.getBounds()
     const globalX = (regionBounds?.x ?? 0) + selection.x
     const globalY = (regionBounds?.y ?? 0) + selection.y
-    const centerX = globalX + selection.width / 2
-    const centerY = globalY + selection.height / 2
 
-    const display = screen.getDisplayNearestPoint({ x: centerX, y: centerY })
+    // The native helper copies just this rect; desktopCapturer is the fallback.
+    screenshot = await captureScreenRect(
+      { x: globalX, y: globalY, width: selection.width, height: selection.height },
+      { space: 'dip', format: 'png' },
+    )
+    if (!screenshot) {
+      const centerX = globalX + selection.width / 2
+      const centerY = globalY + selection.height / 2
+
+      const display = screen.getDisplayNearestPoint({ x: centerX, y: centerY })
+
+      // Make selection coordinates relative to the target display
+      const displayRelativeSelection = {
+        x: globalX - display.bounds.x,
+        y: globalY - display.bounds.y,
+        width: selection.width,
+        height: selection.height,
+      }
 
-    // Make selection coordinates relative to the target display
-    const displayRelativeSelection = {
-      x: globalX - display.bounds.x,
-      y: globalY - display.bounds.y,
-      width: selection.width,
-      height: selection.height,
+      screenshot = await captureRegionScreenshot(display, displayRelativeSelection)
     }
-
-    screenshot = await captureRegionScreenshot(display, displayRelativeSelection)
   } catch (error) {
     console.warn('Failed to capture selected region', error)
     screenshot = null
@@ -1342,6 +1367,7 @@ const finalizeRegionCapture = async (selection: RegionSelection) => {
 }
 
 const cancelRegionCapture = () => {
+  dropPrefetchedWindowScreenshot()
   if (pendingRegionCaptureResolve) {
     pendingRegionCaptureResolve(null)
   }
@@ -1350,6 +1376,8 @@ const cancelRegionCapture = () => {
 
 // Handle radial wedge selection
 const handleRadialSelection = async (wedge: RadialWedge) => {
+  // Only a window capture can use the frame prefetched when the gesture began.
+  if (wedge !== 'capture') dropPrefetchedWindowScreenshot()
   switch (wedge) {
     case 'dismiss':
       // Center/dismiss: cancel this gesture and restore the pre-radial context.
@@ -1527,7 +1555,12 @@ const initMouseHook = () => {
       showRadialWindow(x, y)
       // 2. Show overlay to block context menu on mouseup.
       showModifierOverlay()
-      // 3. Capture context in the background.
+      // 3. Capture the window under the cursor now, so a "capture" pick can
+      // be answered without waiting for a fresh capture on click. Sent before
+      // the context capture: the server handles requests in order, and that
+      // one's UI Automation query can take hundreds of ms.
+      void prefetchWindowScreenshot(x, y, { excludePids: [process.pid] })
+      // 4. Capture context in the background.
       captureRadialContext(x, y)
     },
     onRadialHide: () => {
@@ -1535,6 +1568,7 @@ const initMouseHook = () => {
       // In that path, ignore any in-flight capture from this gesture.
       if (!radialSelectionCommitted) {
         cancelRadialContextCapture()
+        dropPrefetchedWindowScreenshot()
         if (radialStartedWithMiniVisible) {
           if (pendingChatContext !== radialContextBeforeGesture) {
             setPendingChatContext(radialContextBeforeGesture)
@@ -1758,6 +1792,12 @@ app.whenReady().then(async () => {
   
   // Start persistent PowerShell process for fast selected text capture
   initSelectedTextProcess()
+  startWindowWatch({ excludePids: [process.pid] })
+  // Slow-capture reports need to say where the time went: spawn, PrintWindow or encode.
+  setCaptureTimingsListener(({ kind, transport, wallUs, native }) => {
+    if (wallUs < SLOW_CAPTURE_WARN_MS * 1000) return
+    console.warn(`[window-capture] Slow ${kind} capture via ${transport}: ${Math.round(wallUs / 1000)}ms`, native)
+  })
   if (process.platform === 'win32') {
     // Warm up the first UI Automation query so the first radial open doesn't pay
     // the cold-call latency spike.
@@ -2002,24 +2042,22 @@ app.whenReady().then(async () => {
     const regionBounds = getRegionCaptureWindow()?.getBounds()
     if (!regionBounds) return null
 
-    const dipX = regionBounds.x + point.x
-    const dipY = regionBounds.y + point.y
-    const clickDisplay = screen.getDisplayNearestPoint({ x: dipX, y: dipY })
-    const scaleFactor = process.platform === 'darwin' ? 1 : (clickDisplay.scaleFactor ?? 1)
-    const screenX = Math.round(dipX * scaleFactor)
-    const screenY = Math.round(dipY * scaleFactor)
-
-    const capture = await captureWindowScreenshot(screenX, screenY, { excludePids: [process.pid] })
+    // The helper maps DIPs to physical pixels per monitor and reports dipBounds.
+    const capture = await captureWindowScreenshot(regionBounds.x + point.x, regionBounds.y + point.y, {
+      excludePids: [process.pid],
+      space: 'dip',
+      maxWidth: WINDOW_THUMBNAIL_MAX_SIZE,
+      maxHeight: WINDOW_THUMBNAIL_MAX_SIZE,
+      format: 'jpeg',
+      quality: WINDOW_THUMBNAIL_QUALITY,
+      // Clicking the same window again reuses (or patches) the last thumbnail.
+      diff: true,
+    })
     if (!capture) return null
 
-    const { bounds } = capture.windowInfo
+    const bounds = windowDipBounds(capture.windowInfo)
     return {
-      bounds: {
-        x: Math.round(bounds.x / scaleFactor) - regionBounds.x,
-        y: Math.round(bounds.y / scaleFactor) - regionBounds.y,
-        width: Math.round(bounds.width / scaleFactor),
-        height: Math.round(bounds.height / scaleFactor),
-      },
+      bounds: { ...bounds, x: bounds.x - regionBounds.x, y: bounds.y - regionBounds.y },
       thumbnail: capture.screenshot.dataUrl,
     }
   })
@@ -2044,30 +2082,31 @@ app.whenReady().then(async () => {
 
     let capture: Awaited<ReturnType<typeof captureWindowScreenshot>> = null
     try {
-      // Wait briefly for composited overlays to disappear before capture.
-      await new Promise((r) => setTimeout(r, CAPTURE_OVERLAY_HIDE_DELAY_MS))
-
-      // Convert overlay-local click coordinates into global desktop coordinates.
-      // regionWindow bounds are DIP; the native picker expects global coordinates.
+      // Overlay-local click coordinates to global DIPs; the helper converts
+      // them to physical pixels on the monitor they fall on.
       const regionBounds = getRegionCaptureWindow()?.getBounds()
-      let capturePoint = { x: point.x, y: point.y }
-      if (regionBounds) {
-        const dipX = regionBounds.x + point.x
-        const dipY = regionBounds.y + point.y
-        const clickDisplay = screen.getDisplayNearestPoint({ x: dipX, y: dipY })
-        const scaleFactor = process.platform === 'darwin' ? 1 : (clickDisplay.scaleFactor ?? 1)
-        capturePoint = {
-          x: Math.round(dipX * scaleFactor),
-          y: Math.round(dipY * scaleFactor),
-        }
+      const capturePoint = regionBounds
+        ? { x: regionBounds.x + point.x, y: regionBounds.y + point.y }
+        : { x: point.x, y: point.y }
+
+      // Capture window at clicked point using native screenshot. Parts other
+      // windows cover are blacked out so the chat context only shows what
+      // the user could see.
+      const captureOptions = {
+        excludePids: [process.pid],
+        space: 'dip' as const,
+        maskOccluded: true,
       }
 
-      // Capture window at clicked point using native screenshot.
-      capture = await captureWindowScreenshot(
-        capturePoint.x,
-        capturePoint.y,
-        { excludePids: [process.pid] },
-      )
+      // The frame prefetched when the gesture began, if it is of this window
+      // and still current; it was taken with PrintWindow, so our overlays
+      // never covered it and there is nothing to wait for.
+      capture = await takePrefetchedWindowScreenshot(capturePoint.x, capturePoint.y, captureOptions)
+      if (!capture) {
+        // Wait briefly for composited overlays to disappear before capture.
+        await new Promise((r) => setTimeout(r, CAPTURE_OVERLAY_HIDE_DELAY_MS))
+        capture = await captureWindowScreenshot(capturePoint.x, capturePoint.y, captureOptions)
+      }
     } catch (error) {
       console.warn('Failed to capture window at point', error)
       capture = null
@@ -2395,11 +2434,6 @@ app.whenReady().then(async () => {
   ipcMain.handle('screenshot:capture', async (_event, point?: { x: number; y: number }) => {
     const display = getDisplayForPoint(point)
     const cursorDip = point ?? screen.getCursorScreenPoint()
-    const scaleFactor = process.platform === 'darwin' ? 1 : (display.scaleFactor ?? 1)
-    const capturePoint = {
-      x: Math.round(cursorDip.x * scaleFactor),
-      y: Math.round(cursorDip.y * scaleFactor),
-    }
     hideRadialWindow()
     hideModifierOverlay()
     hideRegionCaptureWindow()
@@ -2407,11 +2441,10 @@ app.whenReady().then(async () => {
 
     try {
       await new Promise((r) => setTimeout(r, CAPTURE_OVERLAY_HIDE_DELAY_MS))
-      const windowCapture = await captureWindowScreenshot(
-        capturePoint.x,
-        capturePoint.y,
-        { excludePids: [process.pid] },
-      )
+      const windowCapture = await captureWindowScreenshot(cursorDip.x, cursorDip.y, {
+        excludePids: [process.pid],
+        space: 'dip',
+      })
       if (windowCapture?.screenshot) {
         return windowCapture.screenshot
       }
@@ -2456,6 +2489,9 @@ app.on('will-quit', () => {
     mouseHook.stop()
     mouseHook = null
   }
+  stopWindowInfoServer()
+  stopWindowWatch()
+  stopNativeHost()
   if (localHostRunner) {
     localHostRunner.stop()
     localHostRunner = null
@@ -2,22 +2,237 @@
  * Mouse blocking helper for Windows
  * Spawns a standalone .exe that uses WH_MOUSE_LL to intercept Ctrl+Right-click
  * Communication via stdout - simpler than N-API addon, no node-gyp needed
+ * Runs as a channel of the resident native host when available (native-host.ts)
  */
 
-import { spawn, type ChildProcess } from 'child_process'
+import { spawn } from 'child_process'
 import path from 'path'
 import { fileURLToPath } from 'url'
 import { existsSync } from 'fs'
+import { isNativeHostAvailable, openNativeTool, type NativeToolProcess } from './native-host.js'
+import { toWindowInfo, type WindowInfo } from './window-capture.js'
 
 const __filename = fileURLToPath(import.meta.url)
 const __dirname = path.dirname(__filename)
 
-type MouseBlockEvent = 'down' | 'up'
-type MouseBlockCallback = (event: MouseBlockEvent, x: number, y: number) => void
+type MouseBlockEvent = 'down' | 'up' | 'move'
 
-let helperProcess: ChildProcess | null = null
+export type MouseButtonName = 'left' | 'right' | 'middle' | 'x1' | 'x2'
+export type ModifierName = 'ctrl' | 'shift' | 'alt' | 'win'
+
+/** Which rule matched a DOWN/UP, with the button and modifiers held at DOWN. */
+export type MouseBlockGesture = {
+  rule: string
+  button: MouseButtonName
+  modifiers: ModifierName[]
+}
+
+/**
+ * One entry of the helper's rule table. `modifiers` must all be held at
+ * mousedown; when several rules match, the one requiring more wins.
+ */
+export type MouseBlockRule = {
+  id: string
+  button: MouseButtonName
+  modifiers?: ModifierName[]
+  /** Swallow the down/up so the target app never sees them. */
+  block?: boolean
+  /** Stream cursor movement while the button is held. */
+  emitMove?: boolean
+}
+
+type MouseBlockCallback = (event: MouseBlockEvent, x: number, y: number, gesture?: MouseBlockGesture) => void
+
+const parseGesture = (parts: string[]): MouseBlockGesture | undefined => {
+  if (parts.length < 6) return undefined
+  return {
+    rule: parts[3],
+    button: parts[4] as MouseButtonName,
+    modifiers: parts[5] === '-' ? [] : (parts[5].split('+') as ModifierName[]),
+  }
+}
+
+// Binary framing (helper protocol version 2); see native/src/mouse_block_tool.h.
+const RECORD_SIZE = 24
+const RECORD_DOWN = 1
+const RECORD_UP = 2
+const RECORD_MOVE = 3
+const RECORD_TEXT = 4
+const BUTTON_NAMES: MouseButtonName[] = ['left', 'right', 'middle', 'x1', 'x2']
+const MODIFIER_NAMES: ModifierName[] = ['ctrl', 'shift', 'alt', 'win']
+
+// Modifier arrays are shared per mask so records need no allocation beyond the gesture.
+const MODIFIER_SETS: ModifierName[][] = Array.from({ length: 16 }, (_, mask) =>
+  MODIFIER_NAMES.filter((_, bit) => mask & (1 << bit))
+)
+
+type RecordHandler = (type: number, button: number, mods: number, rule: number, x: number, y: number) => void
+
+/**
+ * Splits helper stdout into text lines until "FORMAT binary", then into
+ * fixed-size records. Partial lines and records are carried across chunks.
+ */
+class HelperOutputReader {
+  private binary = false
+  private partialLine: Buffer | null = null
+  private readonly header = Buffer.alloc(RECORD_SIZE)
+  private headerFilled = 0
+  private text: Buffer | null = null
+  private textFilled = 0
+
+  constructor(
+    private readonly onLine: (line: string) => void,
+    private readonly onRecord: RecordHandler
+  ) {}
+
+  push(chunk: Buffer) {
+    let offset = 0
+    while (offset < chunk.length) {
+      offset = this.binary ? this.readBinary(chunk, offset) : this.readText(chunk, offset)
+    }
+  }
+
+  private readText(chunk: Buffer, offset: number): number {
+    const newline = chunk.indexOf(0x0a, offset)
+    if (newline < 0) {
+      const rest = chunk.subarray(offset)
+      this.partialLine = this.partialLine ? Buffer.concat([this.partialLine, rest]) : Buffer.from(rest)
+      return chunk.length
+    }
+    let bytes = chunk.subarray(offset, newline)
+    if (this.partialLine) {
+      bytes = Buffer.concat([this.partialLine, bytes])
+      this.partialLine = null
+    }
+    const line = bytes.toString('utf8').trim()
+    if (line === 'FORMAT binary') {
+      this.binary = true
+    } else if (line) {
+      this.onLine(line)
+    }
+    return newline + 1
+  }
+
+  private readBinary(chunk: Buffer, offset: number): number {
+    if (this.text) {
+      const copied = chunk.copy(this.text, this.textFilled, offset)
+      this.textFilled += copied
+      if (this.textFilled === this.text.length) {
+        const line = this.text.toString('utf8')
+        this.text = null
+        this.onLine(line)
+      }
+      return offset + copied
+    }
+
+    // Whole records straight from the chunk; only split ones go through header.
+    let record = chunk
+    let at = offset
+    if (this.headerFilled || chunk.length - offset < RECORD_SIZE) {
+      const copied = chunk.copy(this.header, this.headerFilled, offset, offset + RECORD_SIZE - this.headerFilled)
+      this.headerFilled += copied
+      offset += copied
+      if (this.headerFilled < RECORD_SIZE) return offset
+      this.headerFilled = 0
+      record = this.header
+      at = 0
+    } else {
+      offset += RECORD_SIZE
+    }
+
+    const type = record[at]
+    if (type === RECORD_TEXT) {
+      const length = record.readUInt32LE(at + 12)
+      if (length) {
+        this.text = Buffer.allocUnsafe(length)
+        this.textFilled = 0
+      }
+    } else {
+      const x = record.readInt32LE(at + 4)
+      const y = record.readInt32LE(at + 8)
+      this.onRecord(type, record[at + 1], record[at + 2], record[at + 3], x, y)
+    }
+    return offset
+  }
+}
+
+type MouseBlockOptions = {
+  /** Have the helper resolve the window under each DOWN point itself. */
+  emitWindow?: boolean
+  excludePids?: number[]
+}
+
+type ClickWindow = {
+  x: number
+  y: number
+  promise: Promise<WindowInfo | null | undefined>
+  resolve: (info: WindowInfo | null | undefined) => void
+}
+
+// WINDOW lines normally follow DOWN within a few ms; past this the caller
+// falls back to its own query.
+const CLICK_WINDOW_TIMEOUT_MS = 500
+
+// How often to ask the helper for hook latency / drop / rehook counters.
+const STATS_LOG_INTERVAL_MS = 5 * 60 * 1000
+
+let helperProcess: NativeToolProcess | null = null
 let currentCallback: MouseBlockCallback | null = null
 let isReady = false
+let emitsWindow = false
+let clickWindow: ClickWindow | null = null
+let statsTimer: NodeJS.Timeout | null = null
+// Binary records carry the rule's index in the last RULES array sent.
+let ruleIds: string[] = ['radial']
+let pendingRuleIds: string[][] = []
+// Last table passed to setMouseBlockRules, resent to a replacement helper.
+let activeRules: MouseBlockRule[] | null = null
+
+const stopStatsTimer = () => {
+  if (statsTimer) {
+    clearInterval(statsTimer)
+    statsTimer = null
+  }
+}
+
+const expectClickWindow = (x: number, y: number) => {
+  clickWindow?.resolve(undefined)
+  let resolve: ClickWindow['resolve'] = () => {}
+  const promise = new Promise<WindowInfo | null | undefined>((done) => {
+    const timeout = setTimeout(() => done(undefined), CLICK_WINDOW_TIMEOUT_MS)
+    resolve = (info) => {
+      clearTimeout(timeout)
+      done(info)
+    }
+  })
+  clickWindow = { x, y, promise, resolve }
+}
+
+const handleWindowLine = (json: string) => {
+  let info: Record<string, unknown>
+  try {
+    info = JSON.parse(json)
+  } catch {
+    return
+  }
+  const pending = clickWindow
+  if (!pending || pending.x !== info.x || pending.y !== info.y) return
+  if (info.error || typeof info.pid !== 'number' || !info.bounds) {
+    pending.resolve(null)
+    return
+  }
+  pending.resolve(toWindowInfo(info))
+}
+
+/**
+ * Window the helper resolved for the DOWN at (x, y), when started with
+ * `emitWindow`. Resolves to null when no window was found and to undefined
+ * when the helper did not answer; returns null for any other point.
+ */
+export const getClickWindowInfo = (x: number, y: number): Promise<WindowInfo | null | undefined> | null => {
+  if (!emitsWindow || !clickWindow || clickWindow.x !== x || clickWindow.y !== y) return null
+  return clickWindow.promise
+}
 
 /**
  * Find the helper executable
@@ -42,11 +257,142 @@ const findHelperPath = (): string | null => {
   return null
 }
 
+/** Spawns the standalone helper, or returns null when it is not built. */
+const spawnStandaloneHelper = (args: string[]): NativeToolProcess | null => {
+  const helperPath = findHelperPath()
+  if (!helperPath) return null
+  console.log('[mouse-block] Starting helper:', helperPath)
+  return spawn(helperPath, args, {
+    stdio: ['pipe', 'pipe', 'pipe'],
+    windowsHide: true,
+  })
+}
+
+/**
+ * Wire up a started helper. A hosted one that the host refuses ("channel or
+ * tool busy") or whose channel fails later is replaced by the standalone exe,
+ * with the current rule table sent again.
+ */
+const attachHelper = (child: NativeToolProcess, hosted: boolean, args: string[]) => {
+  helperProcess = child
+  isReady = false
+  child.stderr?.setEncoding('utf8')
+  ruleIds = ['radial']
+  pendingRuleIds = []
+
+  const handleLine = (line: string) => {
+    const parts = line.split(' ')
+    const cmd = parts[0]
+
+    if (cmd === 'READY') {
+      isReady = true
+      console.log('[mouse-block] Helper ready')
+      // "READY <version> <formats...>": opt into fixed-size records when offered
+      if (parts.includes('binary')) child.stdin?.write('FORMAT binary\n')
+      stopStatsTimer()
+      statsTimer = setInterval(() => {
+        child.stdin?.write('STATS\n')
+      }, STATS_LOG_INTERVAL_MS)
+      statsTimer.unref?.()
+    } else if (cmd === 'STATS') {
+      // Field diagnostics for "laggy mouse" reports.
+      console.log('[mouse-block] Hook stats:', line.slice('STATS '.length))
+    } else if (cmd === 'DOWN' && parts.length >= 3) {
+      const x = parseInt(parts[1], 10)
+      const y = parseInt(parts[2], 10)
+      if (emitsWindow) expectClickWindow(x, y)
+      currentCallback?.('down', x, y, parseGesture(parts))
+    } else if (cmd === 'WINDOW') {
+      handleWindowLine(line.slice('WINDOW '.length))
+    } else if (cmd === 'UP' && parts.length >= 3) {
+      const x = parseInt(parts[1], 10)
+      const y = parseInt(parts[2], 10)
+      currentCallback?.('up', x, y, parseGesture(parts))
+    } else if (cmd === 'MOVE' && parts.length >= 3) {
+      // Coalesced natively while an emitMove rule's button is held
+      currentCallback?.('move', parseInt(parts[1], 10), parseInt(parts[2], 10))
+    } else if (cmd === 'RULES') {
+      // Replies arrive in the order the tables were sent
+      const ids = pendingRuleIds.shift()
+      if (parts[1] === 'ok') {
+        if (ids) ruleIds = ids
+      } else {
+        console.warn('[mouse-block] Rules rejected:', parts.slice(2).join(' '))
+      }
+    } else if (cmd === 'DROPPED' && parts.length >= 2) {
+      // The helper's event queue overflowed because stdout was not drained.
+      console.warn('[mouse-block] Helper dropped events, total:', parts[1])
+    } else if (cmd === 'EXIT') {
+      console.log('[mouse-block] Helper exited cleanly')
+    } else if (cmd === 'ERROR') {
+      // "ERROR <writer|hook> <win32 error>" in place of READY; the helper exits.
+      console.error('[mouse-block] Helper failed to start:', parts.slice(1).join(' '))
+    }
+  }
+
+  const handleRecord: RecordHandler = (type, button, mods, rule, x, y) => {
+    if (type === RECORD_MOVE) {
+      currentCallback?.('move', x, y)
+      return
+    }
+    if (type !== RECORD_DOWN && type !== RECORD_UP) return
+    const gesture: MouseBlockGesture = {
+      rule: ruleIds[rule] ?? String(rule),
+      button: BUTTON_NAMES[button] ?? 'left',
+      modifiers: MODIFIER_SETS[mods & 15],
+    }
+    if (type === RECORD_DOWN) {
+      if (emitsWindow) expectClickWindow(x, y)
+      currentCallback?.('down', x, y, gesture)
+    } else {
+      currentCallback?.('up', x, y, gesture)
+    }
+  }
+
+  const reader = new HelperOutputReader(handleLine, handleRecord)
+  child.stdout?.on('data', (data: Buffer) => reader.push(data))
+
+  child.stderr?.on('data', (data: string) => {
+    console.error('[mouse-block] Helper error:', data.trim())
+  })
+
+  child.on('exit', (code) => {
+    // A replaced or stopped helper no longer owns the shared state.
+    if (helperProcess !== child) return
+    console.log('[mouse-block] Helper exited with code:', code)
+    stopStatsTimer()
+    helperProcess = null
+    isReady = false
+  })
+
+  child.on('error', (error) => {
+    if (helperProcess !== child) return
+    stopStatsTimer()
+    helperProcess = null
+    isReady = false
+    if (hosted) {
+      let standalone: NativeToolProcess | null = null
+      try {
+        standalone = spawnStandaloneHelper(args)
+      } catch (spawnError) {
+        console.error('[mouse-block] Failed to start helper:', spawnError)
+      }
+      if (standalone) {
+        console.warn('[mouse-block] Native host channel failed, using standalone helper:', error.message)
+        attachHelper(standalone, false, args)
+        if (activeRules) setMouseBlockRules(activeRules)
+        return
+      }
+    }
+    console.error('[mouse-block] Helper spawn error:', error)
+  })
+}
+
 /**
  * Start the mouse blocking helper
  * Returns true if started successfully
  */
-export const startMouseBlock = (callback: MouseBlockCallback): boolean => {
+export const startMouseBlock = (callback: MouseBlockCallback, options?: MouseBlockOptions): boolean => {
   if (process.platform !== 'win32') {
     console.log('[mouse-block] Not on Windows, skipping')
     return false
@@ -57,63 +403,30 @@ export const startMouseBlock = (callback: MouseBlockCallback): boolean => {
     return isReady
   }
 
-  const helperPath = findHelperPath()
-  if (!helperPath) {
+  if (!findHelperPath() && !isNativeHostAvailable()) {
     console.warn('[mouse-block] Helper executable not found')
     console.warn('[mouse-block] Build it with: cl /O2 mouse_block.cpp /link user32.lib')
     return false
   }
 
-  console.log('[mouse-block] Starting helper:', helperPath)
   currentCallback = callback
+  activeRules = null
 
-  try {
-    helperProcess = spawn(helperPath, [], {
-      stdio: ['pipe', 'pipe', 'pipe'],
-      windowsHide: true,
-    })
-
-    helperProcess.stdout?.setEncoding('utf8')
-    helperProcess.stderr?.setEncoding('utf8')
-
-    helperProcess.stdout?.on('data', (data: string) => {
-      const lines = data.trim().split('\n')
-      for (const line of lines) {
-        const parts = line.trim().split(' ')
-        const cmd = parts[0]
-
-        if (cmd === 'READY') {
-          isReady = true
-          console.log('[mouse-block] Helper ready')
-        } else if (cmd === 'DOWN' && parts.length >= 3) {
-          const x = parseInt(parts[1], 10)
-          const y = parseInt(parts[2], 10)
-          currentCallback?.('down', x, y)
-        } else if (cmd === 'UP' && parts.length >= 3) {
-          const x = parseInt(parts[1], 10)
-          const y = parseInt(parts[2], 10)
-          currentCallback?.('up', x, y)
-        } else if (cmd === 'EXIT') {
-          console.log('[mouse-block] Helper exited cleanly')
-        }
-      }
-    })
-
-    helperProcess.stderr?.on('data', (data: string) => {
-      console.error('[mouse-block] Helper error:', data.trim())
-    })
-
-    helperProcess.on('exit', (code) => {
-      console.log('[mouse-block] Helper exited with code:', code)
-      helperProcess = null
-      isReady = false
-    })
+  const args: string[] = []
+  if (options?.emitWindow) {
+    args.push('--emit-window')
+    if (options.excludePids?.length) {
+      args.push(`--exclude-pids=${options.excludePids.join(',')}`)
+    }
+  }
 
-    helperProcess.on('error', (error) => {
-      console.error('[mouse-block] Helper spawn error:', error)
-      helperProcess = null
-      isReady = false
-    })
+  try {
+    const hosted = openNativeTool('mouse_block', args)
+    if (hosted) console.log('[mouse-block] Starting helper in native host')
+    const child = hosted ?? spawnStandaloneHelper(args)
+    if (!child) return false
+    emitsWindow = Boolean(options?.emitWindow)
+    attachHelper(child, hosted !== null, args)
 
     // Wait briefly for READY signal
     return true // Will be ready shortly
@@ -123,6 +436,19 @@ export const startMouseBlock = (callback: MouseBlockCallback): boolean => {
   }
 }
 
+/**
+ * Replace the helper's rule table (default: Ctrl+Right-click as `radial`,
+ * blocked). Returns false when the helper is not running.
+ */
+export const setMouseBlockRules = (rules: MouseBlockRule[]): boolean => {
+  const stdin = helperProcess?.stdin
+  if (!stdin?.writable) return false
+  activeRules = rules
+  stdin.write(`RULES ${JSON.stringify(rules)}\n`)
+  pendingRuleIds.push(rules.map((rule) => rule.id))
+  return true
+}
+
 /**
  * Stop the mouse blocking helper
  */
@@ -132,10 +458,15 @@ export const stopMouseBlock = (): boolean => {
   }
 
   try {
+    stopStatsTimer()
     helperProcess.kill('SIGTERM')
     helperProcess = null
     isReady = false
     currentCallback = null
+    activeRules = null
+    emitsWindow = false
+    clickWindow?.resolve(undefined)
+    clickWindow = null
     return true
   } catch (error) {
     console.error('[mouse-block] Failed to stop helper:', error)
@@ -150,5 +481,5 @@ export const isNativeBlockingAvailable = (): boolean => {
   if (process.platform !== 'win32') {
     return false
   }
-  return findHelperPath() !== null
+  return findHelperPath() !== null || isNativeHostAvailable()
 }
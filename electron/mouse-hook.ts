@@ -1,5 +1,5 @@
 import { uIOhook, UiohookMouseEvent, UiohookKeyboardEvent } from 'uiohook-napi'
-import { startMouseBlock, stopMouseBlock, isNativeBlockingAvailable } from './mouse-block.js'
+import { startMouseBlock, stopMouseBlock, isNativeBlockingAvailable, setMouseBlockRules } from './mouse-block.js'
 
 type MouseHookEvents = {
   onModifierDown: () => void
@@ -45,10 +45,16 @@ export class MouseHookManager {
 
     // Try to use native blocking on Windows (blocks context menu completely)
     if (process.platform === 'win32' && isNativeBlockingAvailable()) {
-      this.useNativeBlocking = startMouseBlock((event, x, y) => {
+      this.useNativeBlocking = startMouseBlock((event, x, y, gesture) => {
+        // Events from other helper rules are not radial gestures
+        if (gesture && gesture.rule !== 'radial') return
         if (event === 'down') {
           this.radialActive = true
           this.events.onRadialShow(x, y)
+        } else if (event === 'move') {
+          if (this.radialActive) {
+            this.events.onMouseMove(x, y)
+          }
         } else if (event === 'up') {
           if (this.radialActive) {
             this.events.onMouseUp(x, y)
@@ -56,10 +62,14 @@ export class MouseHookManager {
             this.radialActive = false
           }
         }
-      })
+      }, { emitWindow: true, excludePids: [process.pid] })
       
       if (this.useNativeBlocking) {
         console.log('[mouse-hook] Using native blocking for Ctrl+right-click')
+        // Same gesture as the helper default, plus coalesced MOVE while held.
+        setMouseBlockRules([
+          { id: 'radial', button: 'right', modifiers: ['ctrl'], block: true, emitMove: true },
+        ])
       }
     }
 
@@ -102,12 +112,14 @@ export class MouseHookManager {
       })
     }
 
-    // Mouse move tracking (always use uiohook for this)
-    uIOhook.on('mousemove', (event: UiohookMouseEvent) => {
-      if (this.radialActive) {
-        this.events.onMouseMove(event.x, event.y)
-      }
-    })
+    // Mouse move tracking; the native helper streams MOVE itself
+    if (!this.useNativeBlocking) {
+      uIOhook.on('mousemove', (event: UiohookMouseEvent) => {
+        if (this.radialActive) {
+          this.events.onMouseMove(event.x, event.y)
+        }
+      })
+    }
 
     // Global left-click tracking (for dismissing popups like mini shell)
     uIOhook.on('mousedown', (event: UiohookMouseEvent) => {
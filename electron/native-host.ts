@@ -0,0 +1,216 @@
+/**
+ * Resident native host for Windows
+ * One stella_native_host.exe runs mouse_block and window_info (--serve,
+ * --watch) as channels multiplexed over its stdin/stdout, so the window
+ * index, GDI+ and capture state are shared and only one process is spawned.
+ * `openNativeTool` hands back a child-process-like handle, so callers keep
+ * their own protocol code and fall back to spawning the standalone exe.
+ */
+
+import { spawn, type ChildProcess } from 'child_process'
+import { EventEmitter } from 'events'
+import path from 'path'
+import { fileURLToPath } from 'url'
+import { existsSync } from 'fs'
+import { PassThrough, Writable, type Readable } from 'stream'
+
+const __filename = fileURLToPath(import.meta.url)
+const __dirname = path.dirname(__filename)
+
+export type NativeToolName = 'mouse_block' | 'window_info'
+
+/** The slice of ChildProcess the native-tool callers use. */
+export interface NativeToolProcess {
+  readonly stdin: Writable | null
+  readonly stdout: Readable | null
+  readonly stderr: Readable | null
+  kill(signal?: NodeJS.Signals | number): boolean
+  on(event: 'exit', listener: (code: number | null) => void): this
+  on(event: 'error', listener: (error: Error) => void): this
+}
+
+// u32 payload length (LE), u8 channel, payload; see stella_native_host.cpp.
+const FRAME_HEADER_SIZE = 5
+const CONTROL_CHANNEL = 0
+const MAX_CHANNEL = 255
+
+class NativeChannel extends EventEmitter implements NativeToolProcess {
+  readonly stdout = new PassThrough()
+  readonly stderr = new PassThrough()
+  readonly stdin: Writable
+  private closed = false
+
+  constructor(readonly id: number) {
+    super()
+    this.stdin = new Writable({
+      write: (chunk: Buffer, _encoding, done) => {
+        sendFrame(this.id, chunk)
+        done()
+      },
+      final: (done) => {
+        sendControl(`CLOSE ${this.id}`)
+        done()
+      },
+    })
+  }
+
+  kill(): boolean {
+    if (!this.closed && !this.stdin.writableEnded) this.stdin.end()
+    return true
+  }
+
+  /** Called once when the host reports CLOSED/ERROR or dies. */
+  finish(code: number | null, error?: Error) {
+    if (this.closed) return
+    this.closed = true
+    channels.delete(this.id)
+    this.stdout.end()
+    this.stderr.end()
+    if (error) this.emit('error', error)
+    this.emit('exit', code)
+  }
+}
+
+let hostProcess: ChildProcess | null = null
+let hostDisabled = false
+const channels = new Map<number, NativeChannel>()
+let nextChannelId = 1
+
+const findHostPath = (): string | null => {
+  const candidates = [
+    // Development: next to dist-electron
+    path.join(__dirname, '..', 'native', 'stella_native_host.exe'),
+    // Production: in resources
+    path.join(__dirname, '..', '..', 'native', 'stella_native_host.exe'),
+  ]
+  return candidates.find((candidate) => existsSync(candidate)) ?? null
+}
+
+const sendFrame = (channel: number, payload: Buffer) => {
+  const stdin = hostProcess?.stdin
+  if (!stdin?.writable) return
+  const header = Buffer.allocUnsafe(FRAME_HEADER_SIZE)
+  header.writeUInt32LE(payload.length, 0)
+  header.writeUInt8(channel, 4)
+  stdin.write(header)
+  if (payload.length) stdin.write(payload)
+}
+
+const sendControl = (line: string) => sendFrame(CONTROL_CHANNEL, Buffer.from(line, 'utf8'))
+
+const handleControl = (line: string) => {
+  const [cmd, idText, ...rest] = line.split(' ')
+  const channel = channels.get(Number(idText))
+  if (cmd === 'READY') {
+    console.log('[native-host] Host ready, protocol', idText)
+  } else if (cmd === 'CLOSED') {
+    channel?.finish(Number(rest[0]))
+  } else if (cmd === 'ERROR') {
+    channel?.finish(null, new Error(`native host: ${rest.join(' ')}`))
+  }
+}
+
+const failAllChannels = (error?: Error) => {
+  for (const channel of [...channels.values()]) {
+    channel.finish(null, error)
+  }
+}
+
+const startHost = (): boolean => {
+  if (hostProcess) return true
+  if (hostDisabled || process.platform !== 'win32') return false
+  const hostPath = findHostPath()
+  if (!hostPath) return false
+
+  let child: ChildProcess
+  try {
+    child = spawn(hostPath, [], { stdio: ['pipe', 'pipe', 'pipe'], windowsHide: true })
+  } catch (error) {
+    console.warn('[native-host] Failed to start host:', error)
+    hostDisabled = true
+    return false
+  }
+  hostProcess = child
+
+  // Frames can span chunks and chunks can hold many frames.
+  let pending: Buffer = Buffer.alloc(0)
+  child.stdout?.on('data', (data: Buffer) => {
+    pending = pending.length ? Buffer.concat([pending, data]) : data
+    let offset = 0
+    while (pending.length - offset >= FRAME_HEADER_SIZE) {
+      const length = pending.readUInt32LE(offset)
+      if (pending.length - offset - FRAME_HEADER_SIZE < length) break
+      const id = pending[offset + 4]
+      const payload = pending.subarray(offset + FRAME_HEADER_SIZE, offset + FRAME_HEADER_SIZE + length)
+      offset += FRAME_HEADER_SIZE + length
+      if (id === CONTROL_CHANNEL) {
+        handleControl(payload.toString('utf8'))
+      } else {
+        // Copy: the PassThrough may hold on to it after pending is reused.
+        channels.get(id)?.stdout.write(Buffer.from(payload))
+      }
+    }
+    pending = offset === pending.length ? Buffer.alloc(0) : pending.subarray(offset)
+  })
+
+  child.stderr?.setEncoding('utf8')
+  child.stderr?.on('data', (data: string) => {
+    console.error('[native-host] Host error:', data.trim())
+  })
+
+  child.on('exit', (code) => {
+    console.log('[native-host] Host exited with code:', code)
+    if (hostProcess === child) hostProcess = null
+    failAllChannels()
+  })
+
+  child.on('error', (error) => {
+    console.error('[native-host] Host spawn error:', error)
+    hostDisabled = true
+    if (hostProcess === child) hostProcess = null
+    failAllChannels(error)
+  })
+  return true
+}
+
+const allocateChannelId = (): number | null => {
+  for (let i = 0; i < MAX_CHANNEL; i++) {
+    const id = nextChannelId
+    nextChannelId = nextChannelId >= MAX_CHANNEL ? 1 : nextChannelId + 1
+    if (!channels.has(id)) return id
+  }
+  return null
+}
+
+/**
+ * Run a native tool inside the resident host. Returns null when the host is
+ * unavailable (not Windows, not built, failed to start), in which case the
+ * caller spawns the standalone exe.
+ */
+export const openNativeTool = (tool: NativeToolName, args: string[]): NativeToolProcess | null => {
+  if (!startHost()) return null
+  const id = allocateChannelId()
+  if (id === null) return null
+
+  const channel = new NativeChannel(id)
+  channels.set(id, channel)
+  // Frames are handled in order, so input written right away follows OPEN.
+  sendControl(['OPEN', String(id), tool, ...args].join(' '))
+  return channel
+}
+
+export const isNativeHostAvailable = (): boolean =>
+  process.platform === 'win32' && !hostDisabled && (hostProcess !== null || findHostPath() !== null)
+
+/** Close every channel and the host (it exits once its stdin closes). */
+export const stopNativeHost = () => {
+  const child = hostProcess
+  hostProcess = null
+  failAllChannels()
+  if (!child) return
+  try {
+    child.stdin?.end()
+  } catch {
+    // Already gone
+  }
+}
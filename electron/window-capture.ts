@@ -1,41 +1,561 @@
-import { execFile } from 'child_process'
+import { execFile, spawn } from 'child_process'
 import { randomBytes } from 'crypto'
-import { promises as fs } from 'fs'
+import { existsSync, promises as fs } from 'fs'
+import { createRequire } from 'module'
 import { tmpdir } from 'os'
 import path from 'path'
 import { fileURLToPath } from 'url'
+import { nativeImage, type NativeImage } from 'electron'
+import { openNativeTool, type NativeToolProcess } from './native-host.js'
 
 const __filename = fileURLToPath(import.meta.url)
 const __dirname = path.dirname(__filename)
 
+type Rect = { x: number; y: number; width: number; height: number }
+
 export type WindowInfo = {
   title: string
   process: string
   pid: number
-  bounds: { x: number; y: number; width: number; height: number }
+  /** Physical pixels on Windows, points (DIPs) on macOS. */
+  bounds: Rect
+  /** Windows: `bounds` at the scale of the window's monitor. */
+  dipBounds?: Rect
+  /** Windows: the monitor the window is mostly on; `bounds` is physical. */
+  monitor?: { id: string; dpi: number; scale: number; bounds: Rect }
+  /** `visibleRegion` captures: uncovered parts of the window, physical screen pixels. */
+  visible?: Rect[]
+  /** `tree` queries: the window's descendants, parents before children. */
+  children?: ChildWindow[]
+  /** The child list hit the helper's entry cap. */
+  childrenTruncated?: boolean
+  /** `uia` queries: UI Automation text, null when UIA is unavailable. */
+  uia?: UiaText | null
 }
 
+export type UiaElement = {
+  name: string
+  /** Localized control type, e.g. "edit", "document". */
+  controlType: string
+  pid: number
+  /** Value, or document text, cut to the helper's limit. */
+  text?: string
+}
+
+export type UiaText = {
+  focused: UiaElement | null
+  /** The focused element's selected text. */
+  selection: string | null
+  atPoint: UiaElement | null
+  /** The time budget ran out and some of the above was not read. */
+  timedOut: boolean
+}
+
+/** A descendant HWND of a `tree` query; bounds are physical screen pixels. */
+export type ChildWindow = {
+  hwnd: number
+  /** Index of the parent in `children`, -1 for direct children of the window. */
+  parent: number
+  depth: number
+  className: string
+  bounds: Rect
+  visible: boolean
+}
+
+/** The window's bounds in Electron screen coordinates (DIPs). */
+export const windowDipBounds = (info: WindowInfo): Rect => info.dipBounds ?? info.bounds
+
 type WindowCapture = {
   windowInfo: WindowInfo
   screenshot: {
     dataUrl: string
     width: number
     height: number
+    /** Present for `format: 'raw'` captures, built straight from BGRA pixels. */
+    image?: NativeImage
   }
 }
 
 type QueryWindowInfoOptions = {
   excludePids?: number[]
+  /**
+   * Space of the query point(s): `dip` takes Electron screen coordinates and
+   * has the helper convert them per monitor, `physical` (default) takes
+   * screen pixels. macOS points are DIPs either way.
+   */
+  space?: 'dip' | 'physical'
+  /** Windows: also list child windows down to this depth (`windowInfo.children`). */
+  tree?: number
+  /** Windows: also read focused/selected/pointed-at text via UI Automation (`windowInfo.uia`). */
+  uia?: boolean
+  /** Time budget for the UIA reads. */
+  uiaBudgetMs?: number
+}
+
+const usesDipSpace = (options?: QueryWindowInfoOptions) =>
+  process.platform === 'win32' && options?.space === 'dip'
+
+const spaceArgs = (options?: QueryWindowInfoOptions) => (usesDipSpace(options) ? ['--dip'] : [])
+
+const spaceField = (options?: QueryWindowInfoOptions) => (usesDipSpace(options) ? { space: 'dip' } : {})
+
+const treeArgs = (options?: QueryWindowInfoOptions) => (options?.tree ? [`--tree=${options.tree}`] : [])
+
+const treeField = (options?: QueryWindowInfoOptions) => (options?.tree ? { tree: options.tree } : {})
+
+const uiaArgs = (options?: QueryWindowInfoOptions) =>
+  options?.uia ? ['--uia', ...(options.uiaBudgetMs ? [`--uia-budget=${options.uiaBudgetMs}`] : [])] : []
+
+const uiaField = (options?: QueryWindowInfoOptions) =>
+  options?.uia ? { uia: true, ...(options.uiaBudgetMs ? { uiaBudgetMs: options.uiaBudgetMs } : {}) } : {}
+
+/** Options only the helper implements; the addon returns basic window fields. */
+const needsHelper = (options?: QueryWindowInfoOptions) => Boolean(options?.tree || options?.uia)
+
+export type WindowCaptureFormat = 'png' | 'jpeg' | 'webp' | 'raw'
+
+type CaptureWindowOptions = QueryWindowInfoOptions & {
+  format?: WindowCaptureFormat
+  /** JPEG/WebP quality, 0-100. */
+  quality?: number
+  /** PNG encoder: built-in `store`/`fast` (default) or the smaller, slower GDI+ `best`. */
+  png?: 'store' | 'fast' | 'best'
+  /**
+   * `dxgi` copies the composed desktop (works for GPU-composited apps, but
+   * includes anything covering the window); falls back to `printwindow`.
+   */
+  backend?: 'printwindow' | 'dxgi'
+  /** Downscale natively (aspect preserved, never upscaled) before encoding. */
+  maxWidth?: number
+  maxHeight?: number
+  scale?: number
+  /**
+   * Called with the window as soon as it is resolved, before the image is
+   * encoded, so callers can show bounds first. Not called on a miss.
+   */
+  onWindowInfo?: (info: WindowInfo) => void
+  /**
+   * Reuse the previous capture of the same window when nothing changed, and
+   * patch in only the changed area otherwise (resident server only). For
+   * png, raw and jpeg; ignored for webp, which Electron cannot re-encode
+   * after patching.
+   */
+  diff?: boolean
+  /** Report the parts of the window no other window covers (`windowInfo.visible`). */
+  visibleRegion?: boolean
+  /** Black out the covered parts of the capture, so it only shows what the user sees. */
+  maskOccluded?: boolean
+}
+
+/** Helper-side microseconds per stage (`--timings`); stages that did not run are absent. */
+export type NativeStageTimings = {
+  gdiplusUs?: number
+  resolveUs?: number
+  processUs?: number
+  captureUs?: number
+  maskUs?: number
+  downscaleUs?: number
+  diffUs?: number
+  encodeUs?: number
+  saveUs?: number
+  totalUs: number
+}
+
+export type CaptureTimingReport = {
+  kind: 'window' | 'rect'
+  transport: 'server' | 'cli'
+  /** Request to parsed reply in this process; minus `native.totalUs` it is spawn and pipe time. */
+  wallUs: number
+  native: NativeStageTimings
+}
+
+let captureTimingsListener: ((report: CaptureTimingReport) => void) | null = null
+
+/**
+ * Receive the helper's stage timings for every server or CLI capture (for
+ * telemetry); while a listener is set, captures ask the helper for them.
+ * In-process addon captures have no helper stages and are not reported.
+ */
+export const setCaptureTimingsListener = (listener: ((report: CaptureTimingReport) => void) | null) => {
+  captureTimingsListener = listener
+}
+
+const reportCaptureTimings = (
+  kind: CaptureTimingReport['kind'],
+  transport: CaptureTimingReport['transport'],
+  startedAt: number,
+  response: ServerResponse | null | undefined,
+) => {
+  if (!captureTimingsListener || !response?.timings) return
+  try {
+    captureTimingsListener({
+      kind,
+      transport,
+      wallUs: Math.round((performance.now() - startedAt) * 1000),
+      native: response.timings,
+    })
+  } catch (error) {
+    console.warn('[window-capture] Capture timings listener failed:', error)
+  }
+}
+
+type ImageHeader = {
+  format: WindowCaptureFormat
+  backend?: 'printwindow' | 'dxgi' | 'screencapturekit' | 'cgwindowlist'
+  width: number
+  height: number
+  bytes: number
+  /** Diff replies: this image is the changed area of frame `base`, placed at x/y. */
+  base?: number
+  x?: number
+  y?: number
+  frameWidth?: number
+  frameHeight?: number
 }
 
-const getWindowInfoBin = () => {
+export const getWindowInfoBin = () => {
   const ext = process.platform === 'win32' ? '.exe' : ''
   return path.join(__dirname, `../native/window_info${ext}`)
 }
 
-const queryWindowInfo = (x: number, y: number, options?: QueryWindowInfoOptions): Promise<WindowInfo | null> => {
+type AddonCapture = WindowInfo & {
+  image: (Omit<ImageHeader, 'bytes'> & { data: Buffer }) | null
+}
+
+/** In-process build of window_info (native/binding.gyp, window_info_addon.cpp). */
+type WindowInfoAddon = {
+  getWindowAtPoint(x: number, y: number, excludePids?: number[], space?: 'dip' | 'physical'): WindowInfo | null
+  captureWindow(x: number, y: number, options?: Record<string, unknown>): Promise<AddonCapture | null>
+}
+
+// undefined = not tried yet, null = unavailable (the server/exe paths take over).
+let windowInfoAddon: WindowInfoAddon | null | undefined
+
+const loadWindowInfoAddon = (): WindowInfoAddon | null => {
+  if (windowInfoAddon !== undefined) return windowInfoAddon
+  windowInfoAddon = null
+  if (process.platform !== 'win32') return null
+  const addonPath = path.join(__dirname, '../native/build/Release/window_info_addon.node')
+  if (!existsSync(addonPath)) return null
+  try {
+    windowInfoAddon = createRequire(import.meta.url)(addonPath) as WindowInfoAddon
+    console.log('[window-capture] Using in-process window_info addon')
+  } catch (error) {
+    console.warn('[window-capture] Failed to load window_info addon, using helper exe:', error)
+  }
+  return windowInfoAddon
+}
+
+/** Addon lookup; undefined when the addon is unavailable or failed. */
+const queryWindowInfoInProcess = (x: number, y: number, options?: QueryWindowInfoOptions) => {
+  const addon = loadWindowInfoAddon()
+  if (!addon || needsHelper(options)) return undefined
+  try {
+    return usesDipSpace(options)
+      ? addon.getWindowAtPoint(x, y, options?.excludePids ?? [], 'dip')
+      : addon.getWindowAtPoint(Math.round(x), Math.round(y), options?.excludePids ?? [])
+  } catch (error) {
+    console.warn('[window-capture] Addon query failed:', error)
+    return undefined
+  }
+}
+
+const SERVER_REQUEST_TIMEOUT_MS = 3000
+const SERVER_SCREENSHOT_TIMEOUT_MS = 5000
+const SERVER_READY_TIMEOUT_MS = 3000
+
+const CLI_MAX_BUFFER_BYTES = 512 * 1024 * 1024
+
+type ServerResponse = Record<string, unknown> & {
+  id?: number
+  error?: string
+  /** Window fields of a progressive request; the image follows separately. */
+  partial?: boolean
+  /** Diff replies: the window handle, and whether frame `base` is still current. */
+  hwnd?: number
+  unchanged?: boolean
+  base?: number
+  image?: ImageHeader | null
+  /** Binary image bytes that followed the JSON line. */
+  frame?: Buffer
+  timings?: NativeStageTimings
+}
+
+type PendingServerRequest = {
+  resolve: (response: ServerResponse | null) => void
+  timeout: NodeJS.Timeout
+  onPartial?: (response: ServerResponse) => void
+  /** Fields from the partial response, merged into the final one. */
+  partial?: ServerResponse
+}
+
+// Persistent `window_info --serve` process. Spawning per query pays for process
+// creation and GDI+ startup on every click; the server pays for it once. It
+// runs as a channel of the native host when that is built.
+let serverProcess: NativeToolProcess | null = null
+let serverReady: Promise<boolean> | null = null
+let serverDisabled = false
+// Set once the host refuses or fails the server channel; later starts spawn
+// the standalone exe.
+let hostedServerFailed = false
+let nextServerRequestId = 1
+const pendingServerRequests = new Map<number, PendingServerRequest>()
+
+type CachedFrame = {
+  /** Server request id of the frame; sent back in "diffBase". */
+  id: number
+  capture: WindowCapture
+  /** Decoded pixels that diff patches are drawn onto. */
+  image: NativeImage
+}
+
+// Last diff-mode capture per window handle, oldest first.
+const FRAME_CACHE_SIZE = 8
+const frameCache = new Map<number, CachedFrame>()
+
+// Both helpers speak the same server protocol (docs/WINDOW_INFO_PROTOCOL.md);
+// diffs, rect captures and prefetch are Windows-only.
+const isServerSupported = () => process.platform === 'win32' || process.platform === 'darwin'
+
+const failPendingServerRequests = () => {
+  for (const pending of pendingServerRequests.values()) {
+    clearTimeout(pending.timeout)
+    pending.resolve(null)
+  }
+  pendingServerRequests.clear()
+}
+
+/**
+ * Splits helper stdout into JSON lines and collects the binary image frame
+ * that follows any line announcing "image":{"bytes":N}. Frames are copied
+ * into one preallocated buffer, so chunk boundaries can fall anywhere.
+ */
+class FrameReader {
+  private partialLine: Buffer = Buffer.alloc(0)
+  private frame: { response: ServerResponse; data: Buffer; filled: number } | null = null
+
+  constructor(
+    private readonly onResponse: (response: ServerResponse) => void,
+    private readonly onText: (line: string) => void = () => {},
+  ) {}
+
+  push(chunk: Buffer) {
+    let offset = 0
+    while (offset < chunk.length) {
+      if (this.frame) {
+        const frame = this.frame
+        const take = Math.min(chunk.length - offset, frame.data.length - frame.filled)
+        chunk.copy(frame.data, frame.filled, offset, offset + take)
+        frame.filled += take
+        offset += take
+        if (frame.filled === frame.data.length) {
+          this.frame = null
+          frame.response.frame = frame.data
+          this.onResponse(frame.response)
+        }
+        continue
+      }
+
+      const newline = chunk.indexOf(0x0a, offset)
+      if (newline === -1) {
+        this.partialLine = Buffer.concat([this.partialLine, chunk.subarray(offset)])
+        return
+      }
+      const lineBytes = this.partialLine.length
+        ? Buffer.concat([this.partialLine, chunk.subarray(offset, newline)])
+        : chunk.subarray(offset, newline)
+      this.partialLine = Buffer.alloc(0)
+      offset = newline + 1
+      this.handleLine(lineBytes.toString('utf8').trim())
+    }
+  }
+
+  private handleLine(line: string) {
+    if (!line) return
+    if (!line.startsWith('{')) {
+      this.onText(line)
+      return
+    }
+    let response: ServerResponse
+    try {
+      response = JSON.parse(line) as ServerResponse
+    } catch {
+      console.warn('[window-capture] Unparseable helper output:', line.slice(0, 200))
+      return
+    }
+    const bytes = response.image?.bytes ?? 0
+    if (bytes > 0) {
+      this.frame = { response, data: Buffer.allocUnsafe(bytes), filled: 0 }
+      return
+    }
+    this.onResponse(response)
+  }
+}
+
+// Image responses can arrive out of request order (the server encodes on a
+// worker pool), so everything is matched by id.
+const deliverServerResponse = (response: ServerResponse) => {
+  if (typeof response.id !== 'number') return
+  const pending = pendingServerRequests.get(response.id)
+  if (!pending) return
+  if (response.partial) {
+    pending.partial = response
+    pending.onPartial?.(response)
+    return
+  }
+  pendingServerRequests.delete(response.id)
+  clearTimeout(pending.timeout)
+  pending.resolve(pending.partial ? { ...pending.partial, ...response, partial: false } : response)
+}
+
+const spawnServer = (): NativeToolProcess =>
+  spawn(getWindowInfoBin(), ['--serve'], {
+    stdio: ['pipe', 'pipe', 'pipe'],
+    windowsHide: true,
+  })
+
+const startServer = (): Promise<boolean> => {
+  if (serverReady) return serverReady
+
+  serverReady = new Promise<boolean>((resolve) => {
+    let settled = false
+    const settle = (ready: boolean) => {
+      if (settled) return
+      settled = true
+      clearTimeout(readyTimeout)
+      resolve(ready)
+    }
+    const readyTimeout = setTimeout(() => {
+      console.warn('[window-capture] Server did not become ready, using per-call helper')
+      serverDisabled = true
+      stopWindowInfoServer()
+      settle(false)
+    }, SERVER_READY_TIMEOUT_MS)
+
+    // A hosted channel the host refuses ("channel or tool busy") or fails is
+    // retried as the standalone exe before the server is given up on.
+    const attach = (child: NativeToolProcess, hosted: boolean) => {
+      serverProcess = child
+      let replaced = false
+      const reader = new FrameReader(deliverServerResponse, (line) => {
+        if (line === 'READY') settle(true)
+      })
+      child.stderr?.setEncoding('utf8')
+
+      child.stdout?.on('data', (data: Buffer) => {
+        reader.push(data)
+      })
+
+      child.stderr?.on('data', (data: string) => {
+        console.warn('[window-capture] Server error:', data.trim())
+      })
+
+      child.on('exit', (code) => {
+        if (replaced) return
+        // A helper that exits before READY has no server mode (an older build).
+        if (!settled) serverDisabled = true
+        if (serverProcess === child) {
+          console.log('[window-capture] Server exited with code:', code)
+          serverProcess = null
+          serverReady = null
+          failPendingServerRequests()
+        }
+        settle(false)
+      })
+
+      child.on('error', (error) => {
+        if (hosted && serverProcess === child) {
+          console.warn('[window-capture] Native host channel failed, using standalone server:', error.message)
+          hostedServerFailed = true
+          if (settled) {
+            // Already serving: the next request starts the standalone server.
+            serverProcess = null
+            serverReady = null
+            failPendingServerRequests()
+            return
+          }
+          try {
+            const standalone = spawnServer()
+            replaced = true
+            attach(standalone, false)
+            return
+          } catch (spawnError) {
+            console.warn('[window-capture] Failed to start server:', spawnError)
+          }
+        }
+        console.warn('[window-capture] Server spawn error:', error)
+        serverDisabled = true
+        if (serverProcess === child) {
+          serverProcess = null
+          serverReady = null
+          failPendingServerRequests()
+        }
+        settle(false)
+      })
+    }
+
+    try {
+      const hosted = hostedServerFailed ? null : openNativeTool('window_info', ['--serve'])
+      attach(hosted ?? spawnServer(), hosted !== null)
+    } catch (error) {
+      console.warn('[window-capture] Failed to start server:', error)
+      serverDisabled = true
+      serverReady = null
+      settle(false)
+    }
+  })
+
+  return serverReady
+}
+
+/**
+ * Send one request to the resident helper.
+ * Resolves undefined when the server is unavailable (callers fall back to
+ * spawning the helper) and null when the request itself failed.
+ */
+const requestServer = async (
+  payload: Record<string, unknown>,
+  timeoutMs: number,
+  onPartial?: (response: ServerResponse) => void,
+): Promise<ServerResponse | null | undefined> => {
+  if (!isServerSupported() || serverDisabled) return undefined
+  const ready = await startServer()
+  const child = serverProcess
+  if (!ready || !child?.stdin?.writable) return undefined
+
+  const id = nextServerRequestId++
+  return new Promise<ServerResponse | null>((resolve) => {
+    const timeout = setTimeout(() => {
+      pendingServerRequests.delete(id)
+      console.warn('[window-capture] Server request timed out')
+      resolve(null)
+    }, timeoutMs)
+    pendingServerRequests.set(id, { resolve, timeout, onPartial })
+    child.stdin?.write(`${JSON.stringify({ ...payload, id })}\n`)
+  })
+}
+
+/**
+ * Stop the resident window_info server (it also exits on its own when stdin closes).
+ */
+export const stopWindowInfoServer = () => {
+  const child = serverProcess
+  serverProcess = null
+  serverReady = null
+  failPendingServerRequests()
+  frameCache.clear()
+  if (!child) return
+  try {
+    child.stdin?.end()
+    child.kill()
+  } catch {
+    // Already gone
+  }
+}
+
+const queryWindowInfoOnce = (x: number, y: number, options?: QueryWindowInfoOptions): Promise<WindowInfo | null> => {
   return new Promise((resolve) => {
-    const args = [String(x), String(y)]
+    const args = [String(x), String(y), ...spaceArgs(options), ...treeArgs(options), ...uiaArgs(options)]
     if (options?.excludePids?.length) {
       args.push(`--exclude-pids=${options.excludePids.join(',')}`)
     }
@@ -52,7 +572,7 @@ const queryWindowInfo = (x: number, y: number, options?: QueryWindowInfoOptions)
           resolve(null)
           return
         }
-        resolve(info as WindowInfo)
+        resolve(toWindowInfo(info))
       } catch {
         resolve(null)
       }
@@ -60,6 +580,60 @@ const queryWindowInfo = (x: number, y: number, options?: QueryWindowInfoOptions)
   })
 }
 
+/**
+ * WindowInfo from the window fields of any helper JSON: server and CLI
+ * responses, mouse_block WINDOW lines and --watch events all share them.
+ */
+export const toWindowInfo = (response: Record<string, unknown>): WindowInfo => ({
+  title: response.title as string,
+  process: response.process as string,
+  pid: response.pid as number,
+  bounds: response.bounds as WindowInfo['bounds'],
+  ...(response.dipBounds ? { dipBounds: response.dipBounds as Rect } : {}),
+  ...(response.monitor ? { monitor: response.monitor as WindowInfo['monitor'] } : {}),
+  ...(Array.isArray(response.visible)
+    ? {
+        visible: (response.visible as Array<[number, number, number, number]>).map(([x, y, width, height]) => ({
+          x,
+          y,
+          width,
+          height,
+        })),
+      }
+    : {}),
+  ...(Array.isArray(response.tree)
+    ? {
+        children: (response.tree as Array<Omit<ChildWindow, 'className'> & { class: string }>).map(
+          ({ class: className, ...child }) => ({ ...child, className }),
+        ),
+      }
+    : {}),
+  ...(response.treeTruncated ? { childrenTruncated: true } : {}),
+  ...(response.uia !== undefined ? { uia: response.uia as UiaText | null } : {}),
+})
+
+const queryWindowInfo = async (x: number, y: number, options?: QueryWindowInfoOptions): Promise<WindowInfo | null> => {
+  const inProcess = queryWindowInfoInProcess(x, y, options)
+  if (inProcess !== undefined) return inProcess
+
+  const response = await requestServer(
+    {
+      x,
+      y,
+      excludePids: options?.excludePids ?? [],
+      ...spaceField(options),
+      ...treeField(options),
+      ...uiaField(options),
+    },
+    SERVER_REQUEST_TIMEOUT_MS,
+  )
+  if (response === undefined) {
+    return queryWindowInfoOnce(x, y, options)
+  }
+  if (!response || response.error) return null
+  return toWindowInfo(response)
+}
+
 export const getWindowInfoAtPoint = (
   x: number,
   y: number,
@@ -68,16 +642,313 @@ export const getWindowInfoAtPoint = (
   return queryWindowInfo(x, y, options)
 }
 
+const toWindowInfoList = (response: Record<string, unknown> | null, count: number): Array<WindowInfo | null> => {
+  const results = Array.isArray(response?.results) ? (response?.results as ServerResponse[]) : []
+  return Array.from({ length: count }, (_, index) => {
+    const result = results[index]
+    return result && !result.error ? toWindowInfo(result) : null
+  })
+}
+
+const queryWindowInfoBatchOnce = (
+  points: Array<{ x: number; y: number }>,
+  options?: QueryWindowInfoOptions,
+): Promise<Array<WindowInfo | null>> => {
+  return new Promise((resolve) => {
+    const args = [
+      `--points=${points.map((point) => `${Math.round(point.x)},${Math.round(point.y)}`).join(';')}`,
+      ...spaceArgs(options),
+    ]
+    if (options?.excludePids?.length) {
+      args.push(`--exclude-pids=${options.excludePids.join(',')}`)
+    }
+
+    execFile(getWindowInfoBin(), args, { timeout: 3000 }, (error, stdout) => {
+      if (error) {
+        console.warn('window_info failed', error)
+        resolve(points.map(() => null))
+        return
+      }
+      try {
+        resolve(toWindowInfoList(JSON.parse(stdout.trim()), points.length))
+      } catch {
+        resolve(points.map(() => null))
+      }
+    })
+  })
+}
+
 /**
- * Capture a window screenshot using the native binary's --screenshot flag.
- * Returns window info + base64 PNG data URL, or null on failure.
- * Uses PrintWindow (Windows) / CGWindowListCreateImage (macOS) to capture
- * a single window directly — no desktopCapturer enumeration needed (~15ms vs 100-500ms).
+ * Resolves many points with one helper request (a single z-order walk),
+ * e.g. for hover highlights. Results are aligned with `points`.
  */
-export const captureWindowScreenshot = async (
+export const getWindowInfoAtPoints = async (
+  points: Array<{ x: number; y: number }>,
+  options?: QueryWindowInfoOptions,
+): Promise<Array<WindowInfo | null>> => {
+  if (points.length === 0) return []
+  if (loadWindowInfoAddon()) {
+    const inProcess = points.map((point) => queryWindowInfoInProcess(point.x, point.y, options))
+    if (inProcess.every((info) => info !== undefined)) return inProcess as Array<WindowInfo | null>
+  }
+  const response = await requestServer(
+    {
+      points: usesDipSpace(options)
+        ? points.map((point) => [point.x, point.y])
+        : points.map((point) => [Math.round(point.x), Math.round(point.y)]),
+      excludePids: options?.excludePids ?? [],
+      ...spaceField(options),
+    },
+    SERVER_REQUEST_TIMEOUT_MS,
+  )
+  if (response === undefined) {
+    return queryWindowInfoBatchOnce(points, options)
+  }
+  return toWindowInfoList(response, points.length)
+}
+
+const toScreenshot = (header: ImageHeader, bytes: Buffer): WindowCapture['screenshot'] => {
+  if (header.format === 'raw') {
+    const image = nativeImage.createFromBitmap(bytes, { width: header.width, height: header.height })
+    return { dataUrl: image.toDataURL(), width: header.width, height: header.height, image }
+  }
+  return {
+    dataUrl: `data:image/${header.format};base64,${bytes.toString('base64')}`,
+    width: header.width,
+    height: header.height,
+  }
+}
+
+const captureArgs = (options?: CaptureWindowOptions) => {
+  const args = [`--format=${options?.format ?? 'png'}`]
+  if (options?.quality !== undefined) args.push(`--quality=${options.quality}`)
+  if (options?.png) args.push(`--png=${options.png}`)
+  if (options?.backend) args.push(`--backend=${options.backend}`)
+  if (options?.maxWidth || options?.maxHeight) {
+    args.push(`--max-size=${options.maxWidth ?? 0}x${options.maxHeight ?? 0}`)
+  }
+  if (options?.scale !== undefined) args.push(`--scale=${options.scale}`)
+  if (options?.visibleRegion) args.push('--visible-region')
+  if (options?.maskOccluded) args.push('--mask-occluded')
+  if (captureTimingsListener) args.push('--timings')
+  return [...args, ...spaceArgs(options), ...treeArgs(options), ...uiaArgs(options)]
+}
+
+const captureFields = (options?: CaptureWindowOptions) => ({
+  format: options?.format ?? 'png',
+  ...(options?.quality !== undefined ? { quality: options.quality } : {}),
+  ...(options?.png ? { png: options.png } : {}),
+  ...(options?.backend ? { backend: options.backend } : {}),
+  ...(options?.maxWidth ? { maxWidth: options.maxWidth } : {}),
+  ...(options?.maxHeight ? { maxHeight: options.maxHeight } : {}),
+  ...(options?.scale !== undefined ? { scale: options.scale } : {}),
+  ...spaceField(options),
+  ...treeField(options),
+  ...uiaField(options),
+  ...(options?.visibleRegion ? { visibleRegion: true } : {}),
+  ...(options?.maskOccluded ? { maskOccluded: true } : {}),
+  ...(captureTimingsListener ? { timings: true } : {}),
+})
+
+const toWindowCapture = (response: ServerResponse | null): WindowCapture | null => {
+  if (!response || response.error || !response.image || !response.frame) return null
+  return {
+    windowInfo: toWindowInfo(response),
+    screenshot: toScreenshot(response.image, response.frame),
+  }
+}
+
+const rememberFrame = (hwnd: number, frame: CachedFrame) => {
+  frameCache.delete(hwnd)
+  frameCache.set(hwnd, frame)
+  while (frameCache.size > FRAME_CACHE_SIZE) {
+    const oldest = frameCache.keys().next().value
+    if (oldest === undefined) break
+    frameCache.delete(oldest)
+  }
+}
+
+const screenshotFromImage = (
+  image: NativeImage,
+  format: WindowCaptureFormat,
+  quality?: number,
+): WindowCapture['screenshot'] => {
+  const { width, height } = image.getSize()
+  // Diff mode never runs for webp (captureWindowScreenshot), so this is jpeg.
+  if (format === 'jpeg') {
+    const jpeg = image.toJPEG(quality ?? 85)
+    return { dataUrl: `data:image/jpeg;base64,${jpeg.toString('base64')}`, width, height }
+  }
+  return { dataUrl: image.toDataURL(), width, height, ...(format === 'raw' ? { image } : {}) }
+}
+
+const decodeFrame = (header: ImageHeader, bytes: Buffer): NativeImage =>
+  header.format === 'raw'
+    ? nativeImage.createFromBitmap(bytes, { width: header.width, height: header.height })
+    : nativeImage.createFromBuffer(bytes)
+
+/**
+ * Turns a diff-mode reply into a capture using the cached frame it refers
+ * to. Returns 'stale' when that frame is no longer cached here (concurrent
+ * requests replaced it), in which case the caller asks for a full frame.
+ */
+const applyDiffResponse = (
+  response: ServerResponse,
+  options?: CaptureWindowOptions,
+): WindowCapture | null | 'stale' => {
+  if (response.error || typeof response.hwnd !== 'number' || typeof response.id !== 'number') {
+    return toWindowCapture(response)
+  }
+  const { hwnd, id } = response
+  const windowInfo = toWindowInfo(response)
+  const cached = frameCache.get(hwnd)
+
+  if (response.unchanged) {
+    if (!cached || cached.id !== response.base) return 'stale'
+    const capture = { windowInfo, screenshot: cached.capture.screenshot }
+    rememberFrame(hwnd, { ...cached, id, capture })
+    return capture
+  }
+
+  const header = response.image
+  const bytes = response.frame
+  if (!header || !bytes) return null
+
+  if (header.base === undefined) {
+    const capture = { windowInfo, screenshot: toScreenshot(header, bytes) }
+    const image = capture.screenshot.image ?? decodeFrame(header, bytes)
+    if (!image.isEmpty()) rememberFrame(hwnd, { id, capture, image })
+    return capture
+  }
+
+  // Patch: copy the changed area's rows into a copy of the cached frame.
+  const frameWidth = header.frameWidth ?? 0
+  const frameHeight = header.frameHeight ?? 0
+  if (!cached || cached.id !== header.base) return 'stale'
+  const pixels = cached.image.toBitmap()
+  const patch = decodeFrame(header, bytes).toBitmap()
+  const x = header.x ?? 0
+  const y = header.y ?? 0
+  if (
+    pixels.length !== frameWidth * frameHeight * 4 ||
+    patch.length !== header.width * header.height * 4 ||
+    x + header.width > frameWidth ||
+    y + header.height > frameHeight
+  ) {
+    return 'stale'
+  }
+  const rowBytes = header.width * 4
+  for (let row = 0; row < header.height; row++) {
+    patch.copy(pixels, ((y + row) * frameWidth + x) * 4, row * rowBytes, (row + 1) * rowBytes)
+  }
+  const image = nativeImage.createFromBitmap(pixels, { width: frameWidth, height: frameHeight })
+  const capture = { windowInfo, screenshot: screenshotFromImage(image, header.format, options?.quality) }
+  rememberFrame(hwnd, { id, capture, image })
+  return capture
+}
+
+/** Diff-mode capture through the server; undefined when it is unavailable. */
+const captureWindowDiffed = async (
   x: number,
   y: number,
-  options?: QueryWindowInfoOptions,
+  options?: CaptureWindowOptions,
+): Promise<WindowCapture | null | undefined> => {
+  const onWindowInfo = options?.onWindowInfo
+  let diffBase = [...frameCache.values()].map((frame) => frame.id)
+  for (let attempt = 0; attempt < 2; attempt++) {
+    const startedAt = performance.now()
+    const response = await requestServer(
+      {
+        x,
+        y,
+        excludePids: options?.excludePids ?? [],
+        frame: true,
+        diff: true,
+        diffBase,
+        progressive: Boolean(onWindowInfo) && attempt === 0,
+        ...captureFields(options),
+      },
+      SERVER_SCREENSHOT_TIMEOUT_MS,
+      onWindowInfo && ((partial) => onWindowInfo(toWindowInfo(partial))),
+    )
+    if (response === undefined) return undefined
+    if (!response) return null
+    reportCaptureTimings('window', 'server', startedAt, response)
+    const result = applyDiffResponse(response, options)
+    if (result !== 'stale') return result
+    diffBase = []
+  }
+  return null
+}
+
+/** Capture through the addon; undefined when it is unavailable or failed. */
+const captureWindowInProcess = async (
+  x: number,
+  y: number,
+  options?: CaptureWindowOptions,
+): Promise<WindowCapture | null | undefined> => {
+  const addon = loadWindowInfoAddon()
+  // Visible regions, child trees and UIA text come from the helper, not the addon.
+  if (!addon || options?.visibleRegion || options?.maskOccluded || needsHelper(options)) return undefined
+  try {
+    const dip = usesDipSpace(options)
+    const captured = await addon.captureWindow(dip ? x : Math.round(x), dip ? y : Math.round(y), {
+      excludePids: options?.excludePids ?? [],
+      ...captureFields(options),
+    })
+    if (!captured) return null
+    const { image, ...windowInfo } = captured
+    options?.onWindowInfo?.(windowInfo)
+    if (!image) return null
+    return {
+      windowInfo,
+      screenshot: toScreenshot({ ...image, bytes: image.data.length }, image.data),
+    }
+  } catch (error) {
+    console.warn('[window-capture] Addon capture failed:', error)
+    return undefined
+  }
+}
+
+/** One-shot helper run that streams the image frame over stdout (Windows). */
+const captureWindowFrameOnce = async (
+  x: number,
+  y: number,
+  options?: CaptureWindowOptions,
+): Promise<WindowCapture | null> => {
+  const args = [String(x), String(y), '--screenshot=-', ...captureArgs(options)]
+  if (options?.excludePids?.length) {
+    args.push(`--exclude-pids=${options.excludePids.join(',')}`)
+  }
+
+  const startedAt = performance.now()
+  const stdout = await new Promise<Buffer>((resolve, reject) => {
+    execFile(
+      getWindowInfoBin(),
+      args,
+      { timeout: 5000, encoding: 'buffer', maxBuffer: CLI_MAX_BUFFER_BYTES },
+      (error, out) => {
+        if (error) return reject(error)
+        resolve(out)
+      },
+    )
+  })
+
+  let result: ServerResponse | null = null
+  new FrameReader((response) => {
+    result ??= response
+  }).push(stdout)
+  reportCaptureTimings('window', 'cli', startedAt, result)
+  const capture = toWindowCapture(result)
+  if (capture) options?.onWindowInfo?.(capture.windowInfo)
+  return capture
+}
+
+/** Legacy temp-file transport, for macOS helpers without server mode. */
+const captureWindowViaTempFile = async (
+  x: number,
+  y: number,
+  options?: CaptureWindowOptions,
 ): Promise<WindowCapture | null> => {
   const tempPath = path.join(tmpdir(), `stella_cap_${randomBytes(8).toString('hex')}.png`)
   const args = [String(x), String(y), `--screenshot=${tempPath}`]
@@ -95,6 +966,7 @@ export const captureWindowScreenshot = async (
 
     const info = JSON.parse(stdout.trim()) as WindowInfo & { error?: string }
     if (info.error) return null
+    options?.onWindowInfo?.(info)
 
     let pngBuffer: Buffer
     try {
@@ -104,20 +976,188 @@ export const captureWindowScreenshot = async (
       return null
     }
 
-    const dataUrl = `data:image/png;base64,${pngBuffer.toString('base64')}`
-
     return {
       windowInfo: info,
-      screenshot: {
-        dataUrl,
-        width: info.bounds.width,
-        height: info.bounds.height,
-      },
+      screenshot: toScreenshot(
+        { format: 'png', width: info.bounds.width, height: info.bounds.height, bytes: pngBuffer.length },
+        pngBuffer,
+      ),
     }
-  } catch {
-    return null
   } finally {
     // Clean up temp file
     fs.unlink(tempPath).catch(() => {})
   }
 }
+
+/**
+ * Capture a window screenshot with the native helper.
+ * Returns window info + a data URL (and a NativeImage for raw captures), or null on failure.
+ * Uses PrintWindow (Windows) / ScreenCaptureKit or CGWindowListCreateImage (macOS) to capture
+ * a single window directly — no desktopCapturer enumeration needed (~15ms vs 100-500ms).
+ * On Windows the image comes back as a binary frame on the helper's stdout,
+ * so nothing is written to the temp directory.
+ */
+export const captureWindowScreenshot = async (
+  x: number,
+  y: number,
+  options?: CaptureWindowOptions,
+): Promise<WindowCapture | null> => {
+  try {
+    if (process.platform === 'win32') {
+      // The frame cache lives in the server, so diff requests go there first.
+      if (options?.diff && options.format !== 'webp') {
+        const diffed = await captureWindowDiffed(x, y, options)
+        if (diffed !== undefined) return diffed
+      }
+
+      const inProcess = await captureWindowInProcess(x, y, options)
+      if (inProcess !== undefined) return inProcess
+    }
+
+    const onWindowInfo = options?.onWindowInfo
+    const startedAt = performance.now()
+    const response = await requestServer(
+      {
+        x,
+        y,
+        excludePids: options?.excludePids ?? [],
+        frame: true,
+        progressive: Boolean(onWindowInfo),
+        ...captureFields(options),
+      },
+      SERVER_SCREENSHOT_TIMEOUT_MS,
+      onWindowInfo && ((partial) => onWindowInfo(toWindowInfo(partial))),
+    )
+    if (response === undefined) {
+      return process.platform === 'win32'
+        ? await captureWindowFrameOnce(x, y, options)
+        : await captureWindowViaTempFile(x, y, options)
+    }
+    reportCaptureTimings('window', 'server', startedAt, response)
+    return toWindowCapture(response)
+  } catch {
+    return null
+  }
+}
+
+type PrefetchWindowOptions = Pick<CaptureWindowOptions, 'excludePids' | 'space'>
+
+/**
+ * Warm standby for a window capture the user is about to confirm: the
+ * resident server captures the window at (x, y) now (PrintWindow, nothing
+ * encoded yet) and holds the pixels for `takePrefetchedWindowScreenshot`.
+ * Call it when a gesture starts so the capture overlaps the time the user
+ * spends choosing. Resolves to whether a frame is held; Windows only.
+ */
+export const prefetchWindowScreenshot = async (
+  x: number,
+  y: number,
+  options?: PrefetchWindowOptions,
+): Promise<boolean> => {
+  if (process.platform !== 'win32') return false
+  const response = await requestServer(
+    { x, y, excludePids: options?.excludePids ?? [], prefetch: true, ...spaceField(options) },
+    SERVER_SCREENSHOT_TIMEOUT_MS,
+  )
+  return Boolean(response?.prefetched)
+}
+
+/**
+ * The prefetched capture, if it is of the window at (x, y), that window has
+ * not moved, and no window outside `excludePids` covers it differently than
+ * when it was taken; null otherwise, and the caller captures live. The held
+ * frame is used up either way.
+ */
+export const takePrefetchedWindowScreenshot = async (
+  x: number,
+  y: number,
+  options?: Omit<CaptureWindowOptions, 'backend' | 'diff' | 'onWindowInfo'> & { maxAgeMs?: number },
+): Promise<WindowCapture | null> => {
+  if (process.platform !== 'win32') return null
+  const startedAt = performance.now()
+  const response = await requestServer(
+    {
+      x,
+      y,
+      excludePids: options?.excludePids ?? [],
+      frame: true,
+      fromPrefetch: true,
+      ...(options?.maxAgeMs ? { prefetchMaxAgeMs: options.maxAgeMs } : {}),
+      ...captureFields(options),
+    },
+    SERVER_SCREENSHOT_TIMEOUT_MS,
+  )
+  if (!response || response.error) return null
+  reportCaptureTimings('window', 'server', startedAt, response)
+  return toWindowCapture(response)
+}
+
+/** Release the prefetched capture, e.g. when the gesture was cancelled. */
+export const dropPrefetchedWindowScreenshot = () => {
+  if (process.platform !== 'win32' || !serverProcess) return
+  void requestServer({ dropPrefetch: true }, SERVER_REQUEST_TIMEOUT_MS)
+}
+
+type CaptureScreenRectOptions = Omit<
+  CaptureWindowOptions,
+  'excludePids' | 'onWindowInfo' | 'diff' | 'visibleRegion' | 'maskOccluded' | 'tree' | 'uia' | 'uiaBudgetMs'
+>
+
+const toRectScreenshot = (response: ServerResponse | null): WindowCapture['screenshot'] | null => {
+  if (!response || response.error || !response.image || !response.frame) return null
+  return toScreenshot(response.image, response.frame)
+}
+
+/** One-shot --rect run streaming the frame over stdout. */
+const captureScreenRectOnce = async (
+  rect: Rect,
+  options?: CaptureScreenRectOptions,
+): Promise<WindowCapture['screenshot'] | null> => {
+  const args = [`--rect=${rect.x},${rect.y},${rect.width},${rect.height}`, '--screenshot=-', ...captureArgs(options)]
+  const startedAt = performance.now()
+  const stdout = await new Promise<Buffer>((resolve, reject) => {
+    execFile(
+      getWindowInfoBin(),
+      args,
+      { timeout: 5000, encoding: 'buffer', maxBuffer: CLI_MAX_BUFFER_BYTES },
+      (error, out) => {
+        if (error) return reject(error)
+        resolve(out)
+      },
+    )
+  })
+
+  let result: ServerResponse | null = null
+  new FrameReader((response) => {
+    result ??= response
+  }).push(stdout)
+  reportCaptureTimings('rect', 'cli', startedAt, result)
+  return toRectScreenshot(result)
+}
+
+/**
+ * Capture a rectangle of the desktop, whatever is on screen in it, with the
+ * native helper: one BitBlt (or the DXGI session with `backend: 'dxgi'`)
+ * instead of a desktopCapturer enumeration of every screen. Windows only;
+ * null elsewhere or on failure so callers can fall back.
+ */
+export const captureScreenRect = async (
+  rect: Rect,
+  options?: CaptureScreenRectOptions,
+): Promise<WindowCapture['screenshot'] | null> => {
+  if (process.platform !== 'win32' || rect.width <= 0 || rect.height <= 0) return null
+  try {
+    const startedAt = performance.now()
+    const response = await requestServer(
+      { rect: [rect.x, rect.y, rect.width, rect.height], frame: true, ...captureFields(options) },
+      SERVER_SCREENSHOT_TIMEOUT_MS,
+    )
+    if (response === undefined) {
+      return await captureScreenRectOnce(rect, options)
+    }
+    reportCaptureTimings('rect', 'server', startedAt, response)
+    return toRectScreenshot(response)
+  } catch {
+    return null
+  }
+}
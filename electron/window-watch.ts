@@ -0,0 +1,120 @@
+/**
+ * Foreground window watcher for Windows
+ * Keeps `window_info --watch` running so the current foreground window's
+ * metadata is already in memory when the chat opens, instead of being
+ * queried on demand. Communication via stdout JSON lines, like mouse-block.
+ */
+
+import { spawn } from 'child_process'
+import { existsSync } from 'fs'
+import { openNativeTool, type NativeToolProcess } from './native-host.js'
+import { getWindowInfoBin, toWindowInfo, type WindowInfo } from './window-capture.js'
+
+type WatchEvent = Record<string, unknown> & {
+  event?: 'foreground' | 'title' | 'bounds' | 'closed'
+}
+
+let watchProcess: NativeToolProcess | null = null
+let foregroundWindow: WindowInfo | null = null
+
+const handleWatchLine = (line: string) => {
+  if (!line.startsWith('{')) {
+    if (line === 'READY') console.log('[window-watch] Helper ready')
+    return
+  }
+  let update: WatchEvent
+  try {
+    update = JSON.parse(line) as WatchEvent
+  } catch {
+    return
+  }
+  if (update.event === 'closed') {
+    foregroundWindow = null
+    return
+  }
+  if (typeof update.pid !== 'number' || !update.bounds) return
+  foregroundWindow = toWindowInfo(update)
+}
+
+/**
+ * Start watching the foreground window. Windows from excludePids (our own
+ * UI) never replace the current one.
+ */
+export const startWindowWatch = (options?: { excludePids?: number[] }): boolean => {
+  if (process.platform !== 'win32') return false
+  if (watchProcess) return true
+
+  const args = ['--watch']
+  if (options?.excludePids?.length) {
+    args.push(`--exclude-pids=${options.excludePids.join(',')}`)
+  }
+
+  const hosted = openNativeTool('window_info', args)
+  const helperPath = getWindowInfoBin()
+  if (!hosted && !existsSync(helperPath)) {
+    console.warn('[window-watch] Helper executable not found')
+    return false
+  }
+
+  try {
+    const child: NativeToolProcess =
+      hosted ??
+      spawn(helperPath, args, {
+        stdio: ['pipe', 'pipe', 'pipe'],
+        windowsHide: true,
+      })
+    watchProcess = child
+
+    let partial = ''
+    child.stdout?.setEncoding('utf8')
+    child.stdout?.on('data', (data: string) => {
+      partial += data
+      const lines = partial.split('\n')
+      partial = lines.pop() ?? ''
+      for (const line of lines) {
+        handleWatchLine(line.trim())
+      }
+    })
+
+    child.stderr?.setEncoding('utf8')
+    child.stderr?.on('data', (data: string) => {
+      console.error('[window-watch] Helper error:', data.trim())
+    })
+
+    child.on('exit', (code) => {
+      console.log('[window-watch] Helper exited with code:', code)
+      if (watchProcess === child) {
+        watchProcess = null
+        foregroundWindow = null
+      }
+    })
+
+    child.on('error', (error) => {
+      console.error('[window-watch] Helper spawn error:', error)
+      if (watchProcess === child) {
+        watchProcess = null
+        foregroundWindow = null
+      }
+    })
+    return true
+  } catch (error) {
+    console.error('[window-watch] Failed to start helper:', error)
+    return false
+  }
+}
+
+export const stopWindowWatch = () => {
+  const child = watchProcess
+  watchProcess = null
+  foregroundWindow = null
+  if (!child) return
+  try {
+    child.stdin?.end()
+    child.kill()
+  } catch {
+    // Already gone
+  }
+}
+
+/** Latest foreground window reported by the watcher, if it is running. */
+export const getForegroundWindowInfo = (): WindowInfo | null => foregroundWindow
@@ -0,0 +1,16 @@
+# Builds the native helpers plus capture_bench.exe, then runs the benchmark.
+# Arguments are passed through, e.g.:
+#   .\bench\bench.ps1 --sizes=1920x1080,3840x2160 --modes=inprocess,server --json
+# Close or move other topmost windows off the top-left corner first; the
+# synthetic window opens at 0,0.
+
+$native = Split-Path -Parent $PSScriptRoot
+Push-Location $native
+try {
+    & .\build.ps1 -Bench
+    if ($LASTEXITCODE -ne 0) { exit $LASTEXITCODE }
+    & .\bench\capture_bench.exe --helper="$native\window_info.exe" @args
+    exit $LASTEXITCODE
+} finally {
+    Pop-Location
+}
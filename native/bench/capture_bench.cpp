@@ -0,0 +1,651 @@
+// capture_bench.exe - Latency benchmark for window_info lookups and captures.
+//
+// Opens a synthetic topmost window of each requested size (patterned so the
+// encoders have realistic work), then measures, per size x backend x format:
+//   inprocess  the window_info_tool.h stages called directly:
+//              resolve (live z-order walk), resolve-index (WindowIndex
+//              snapshot), capture, encode
+//   server     requests to one resident window_info.exe --serve: roundtrip
+//              (request written to last frame byte read) and transfer (JSON
+//              line to last frame byte)
+//   cli        one window_info.exe <x> <y> --screenshot=- run per sample:
+//              total, spawn included
+// and prints p50/p95/p99 in microseconds per stage.
+//
+// Usage: capture_bench.exe [--sizes=1280x720,1920x1080,3840x2160,7680x4320]
+//                          [--backends=printwindow,dxgi] [--formats=png,jpeg,raw]
+//                          [--modes=inprocess,server,cli] [--iterations=30]
+//                          [--helper=path\window_info.exe] [--json]
+// Build and run: bench.ps1 (next to build.ps1). DXGI copies the desktop, so
+// parts of windows larger than the screen come back black there; PrintWindow
+// renders them whole.
+
+#include "../src/window_info_tool.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+
+struct Size
+{
+    int width;
+    int height;
+};
+
+struct BenchOptions
+{
+    std::vector<Size> sizes = {{1280, 720}, {1920, 1080}, {3840, 2160}, {7680, 4320}};
+    std::vector<CaptureBackend> backends = {BackendPrintWindow, BackendDxgi};
+    std::vector<ImageFormat> formats = {FormatPng, FormatJpeg, FormatRaw};
+    bool inProcess = true;
+    bool server = true;
+    bool cli = true;
+    int iterations = 30;
+    std::wstring helper;
+    bool json = false;
+};
+
+const int kWarmup = 3;
+const int kProbe = 16; // query point inside the synthetic window, from its top-left
+
+// ---- Synthetic window ------------------------------------------------------
+
+// Painted from a DIB so PrintWindow, WM_PAINT and DXGI all see the same
+// pixels: a gradient with pseudo-random text-like blocks over it.
+struct SyntheticWindow
+{
+    HWND hwnd = NULL;
+    HDC dc = NULL;
+    HBITMAP bitmap = NULL;
+    HGDIOBJ previous = NULL;
+    int width = 0;
+    int height = 0;
+    HANDLE thread = NULL;
+    HANDLE ready = NULL;
+    DWORD threadId = 0;
+};
+
+LRESULT CALLBACK syntheticProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    SyntheticWindow* self = reinterpret_cast<SyntheticWindow*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+    switch (msg)
+    {
+    case WM_GETMINMAXINFO:
+    {
+        // Let the window grow past the screen (8K on a 4K monitor).
+        MINMAXINFO* info = reinterpret_cast<MINMAXINFO*>(lParam);
+        info->ptMaxTrackSize.x = info->ptMaxSize.x = 16384;
+        info->ptMaxTrackSize.y = info->ptMaxSize.y = 16384;
+        return 0;
+    }
+    case WM_PAINT:
+    {
+        PAINTSTRUCT ps;
+        HDC target = BeginPaint(hwnd, &ps);
+        if (self) BitBlt(target, 0, 0, self->width, self->height, self->dc, 0, 0, SRCCOPY);
+        EndPaint(hwnd, &ps);
+        return 0;
+    }
+    case WM_PRINTCLIENT:
+        if (self) BitBlt(reinterpret_cast<HDC>(wParam), 0, 0, self->width, self->height, self->dc, 0, 0, SRCCOPY);
+        return 0;
+    case WM_ERASEBKGND:
+        return 1;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+void fillPattern(BYTE* bits, int width, int height)
+{
+    uint32_t seed = 0x2545F491u;
+    const size_t stride = static_cast<size_t>(width) * 4;
+    for (int y = 0; y < height; ++y)
+    {
+        BYTE* row = bits + stride * y;
+        for (int x = 0; x < width; ++x)
+        {
+            row[x * 4 + 0] = static_cast<BYTE>(x * 255 / width);
+            row[x * 4 + 1] = static_cast<BYTE>(y * 255 / height);
+            row[x * 4 + 2] = 0x60;
+            row[x * 4 + 3] = 0xFF;
+        }
+    }
+    // Dark "glyph" blocks in lines, like a page of text.
+    for (int y = 8; y + 12 < height; y += 18)
+    {
+        for (int x = 8; x + 8 < width;)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            const int glyph = 4 + static_cast<int>(seed >> 28);
+            for (int gy = 0; gy < 12; ++gy)
+            {
+                BYTE* px = bits + stride * (y + gy) + static_cast<size_t>(x) * 4;
+                for (int gx = 0; gx < glyph && x + gx < width; ++gx)
+                {
+                    if (((seed >> (gx + gy)) & 3) == 0) continue;
+                    px[gx * 4 + 0] = px[gx * 4 + 1] = px[gx * 4 + 2] = 0x20;
+                }
+            }
+            x += glyph + 2 + ((seed >> 20) & 15 ? 0 : 10);
+        }
+    }
+}
+
+DWORD WINAPI syntheticThread(LPVOID param)
+{
+    SyntheticWindow* self = static_cast<SyntheticWindow*>(param);
+    WNDCLASSW wc = {};
+    wc.lpfnWndProc = syntheticProc;
+    wc.hInstance = GetModuleHandleW(NULL);
+    wc.lpszClassName = L"StellaCaptureBench";
+    RegisterClassW(&wc); // fails harmlessly for the second size onwards
+
+    self->hwnd = CreateWindowExW(WS_EX_TOPMOST | WS_EX_TOOLWINDOW, wc.lpszClassName, L"capture_bench", WS_POPUP, 0,
+                                 0, self->width, self->height, NULL, NULL, wc.hInstance, NULL);
+    if (self->hwnd)
+    {
+        SetWindowLongPtrW(self->hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(self));
+        SetWindowPos(self->hwnd, HWND_TOPMOST, 0, 0, self->width, self->height, SWP_SHOWWINDOW);
+        UpdateWindow(self->hwnd);
+    }
+    SetEvent(self->ready);
+    if (!self->hwnd) return 1;
+
+    MSG msg;
+    while (GetMessageW(&msg, NULL, 0, 0) > 0)
+    {
+        DispatchMessageW(&msg);
+    }
+    DestroyWindow(self->hwnd);
+    return 0;
+}
+
+bool openSyntheticWindow(Size size, SyntheticWindow& window)
+{
+    window.width = size.width;
+    window.height = size.height;
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = size.width;
+    bmi.bmiHeader.biHeight = -size.height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    void* bits = nullptr;
+    window.bitmap = CreateDIBSection(NULL, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+    if (!window.bitmap) return false;
+    fillPattern(static_cast<BYTE*>(bits), size.width, size.height);
+    window.dc = CreateCompatibleDC(NULL);
+    window.previous = SelectObject(window.dc, window.bitmap);
+
+    window.ready = CreateEventW(NULL, TRUE, FALSE, NULL);
+    window.thread = CreateThread(NULL, 0, syntheticThread, &window, 0, &window.threadId);
+    if (window.thread) WaitForSingleObject(window.ready, 5000);
+    CloseHandle(window.ready);
+    window.ready = NULL;
+    // Let DWM compose the first frame before DXGI samples it.
+    Sleep(200);
+    return window.hwnd != NULL;
+}
+
+void closeSyntheticWindow(SyntheticWindow& window)
+{
+    if (window.thread)
+    {
+        PostThreadMessageW(window.threadId, WM_QUIT, 0, 0);
+        WaitForSingleObject(window.thread, 5000);
+        CloseHandle(window.thread);
+    }
+    if (window.dc)
+    {
+        SelectObject(window.dc, window.previous);
+        DeleteDC(window.dc);
+    }
+    if (window.bitmap) DeleteObject(window.bitmap);
+    window = SyntheticWindow();
+}
+
+// ---- Statistics ------------------------------------------------------------
+
+struct Samples
+{
+    std::vector<uint64_t> micros;
+
+    void add(int64_t start, int64_t end) { micros.push_back(qpcToMicros(end - start)); }
+
+    // Nearest-rank percentile.
+    uint64_t percentile(double p) const
+    {
+        if (micros.empty()) return 0;
+        std::vector<uint64_t> sorted = micros;
+        std::sort(sorted.begin(), sorted.end());
+        size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.999999);
+        if (rank < 1) rank = 1;
+        return sorted[rank - 1];
+    }
+};
+
+struct Case
+{
+    Size size;
+    CaptureBackend backend;
+    ImageFormat format;
+};
+
+void report(const BenchOptions& options, const Case& c, const char* mode, const char* stage, const Samples& s)
+{
+    if (s.micros.empty()) return;
+    char size[32];
+    snprintf(size, sizeof(size), "%dx%d", c.size.width, c.size.height);
+    if (options.json)
+    {
+        printf("{\"size\":\"%s\",\"backend\":\"%s\",\"format\":\"%s\",\"mode\":\"%s\",\"stage\":\"%s\",\"n\":%u,"
+               "\"p50Us\":%llu,\"p95Us\":%llu,\"p99Us\":%llu}\n",
+               size, captureBackendName(c.backend), imageFormatName(c.format), mode, stage,
+               static_cast<unsigned>(s.micros.size()), static_cast<unsigned long long>(s.percentile(50)),
+               static_cast<unsigned long long>(s.percentile(95)), static_cast<unsigned long long>(s.percentile(99)));
+    }
+    else
+    {
+        printf("%-10s %-12s %-5s %-10s %-14s %5u %10llu %10llu %10llu\n", size, captureBackendName(c.backend),
+               imageFormatName(c.format), mode, stage, static_cast<unsigned>(s.micros.size()),
+               static_cast<unsigned long long>(s.percentile(50)), static_cast<unsigned long long>(s.percentile(95)),
+               static_cast<unsigned long long>(s.percentile(99)));
+    }
+    fflush(stdout);
+}
+
+// ---- In-process stages -----------------------------------------------------
+
+void benchInProcess(const BenchOptions& options, const Case& c, HWND target, WindowIndex& index)
+{
+    const POINT probe = {kProbe, kProbe};
+    const std::vector<DWORD> none;
+    EncodeOptions encode;
+    encode.format = c.format;
+    encode.threads = defaultEncodeThreads();
+    prepareEncoder(encode);
+
+    Samples resolve, resolveIndex, capture, encodeStage;
+    for (int i = 0; i < kWarmup + options.iterations; ++i)
+    {
+        const bool record = i >= kWarmup;
+        int64_t t0 = qpcNow();
+        HWND live = resolveWindowAtPoint(probe, none);
+        int64_t t1 = qpcNow();
+        HWND indexed = resolveWindowAtPoint(probe, none, &index);
+        int64_t t2 = qpcNow();
+        if (live != target || indexed != target)
+        {
+            fprintf(stderr, "synthetic window is not under the probe point (covered?)\n");
+            return;
+        }
+
+        CapturedImage image;
+        CaptureBackend used = c.backend;
+        const bool captured = captureWindowPixels(target, c.backend, image, used);
+        int64_t t3 = qpcNow();
+        if (!captured || used != c.backend)
+        {
+            fprintf(stderr, "%s capture failed\n", captureBackendName(c.backend));
+            return;
+        }
+        EncodedImage encoded;
+        encodeImage(image, encode, encoded);
+        int64_t t4 = qpcNow();
+
+        if (!record) continue;
+        resolve.add(t0, t1);
+        resolveIndex.add(t1, t2);
+        capture.add(t2, t3);
+        encodeStage.add(t3, t4);
+    }
+    report(options, c, "inprocess", "resolve", resolve);
+    report(options, c, "inprocess", "resolve-index", resolveIndex);
+    report(options, c, "inprocess", "capture", capture);
+    report(options, c, "inprocess", "encode", encodeStage);
+}
+
+// ---- Helper processes ------------------------------------------------------
+
+struct Helper
+{
+    HANDLE process = NULL;
+    HANDLE in = NULL;  // our end of its stdin
+    HANDLE out = NULL; // our end of its stdout
+    std::vector<char> buffer;
+    size_t begin = 0;
+
+    bool start(std::wstring commandLine)
+    {
+        SECURITY_ATTRIBUTES sa = {sizeof(sa), NULL, TRUE};
+        HANDLE childIn = NULL, childOut = NULL;
+        if (!CreatePipe(&childIn, &in, &sa, 0)) return false;
+        if (!CreatePipe(&out, &childOut, &sa, 1 << 20))
+        {
+            CloseHandle(childIn);
+            return false;
+        }
+        SetHandleInformation(in, HANDLE_FLAG_INHERIT, 0);
+        SetHandleInformation(out, HANDLE_FLAG_INHERIT, 0);
+
+        STARTUPINFOW si = {};
+        si.cb = sizeof(si);
+        si.dwFlags = STARTF_USESTDHANDLES;
+        si.hStdInput = childIn;
+        si.hStdOutput = childOut;
+        si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+        PROCESS_INFORMATION pi = {};
+        const BOOL ok = CreateProcessW(NULL, &commandLine[0], NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &si, &pi);
+        CloseHandle(childIn);
+        CloseHandle(childOut);
+        if (!ok) return false;
+        CloseHandle(pi.hThread);
+        process = pi.hProcess;
+        return true;
+    }
+
+    void closeInput()
+    {
+        if (in) CloseHandle(in);
+        in = NULL;
+    }
+
+    void stop()
+    {
+        closeInput();
+        if (process)
+        {
+            if (WaitForSingleObject(process, 3000) != WAIT_OBJECT_0) TerminateProcess(process, 1);
+            CloseHandle(process);
+        }
+        if (out) CloseHandle(out);
+        process = out = NULL;
+        buffer.clear();
+        begin = 0;
+    }
+
+    bool write(const std::string& line)
+    {
+        DWORD written = 0;
+        return WriteFile(in, line.data(), static_cast<DWORD>(line.size()), &written, NULL) && written == line.size();
+    }
+
+    bool fill()
+    {
+        if (begin > 0)
+        {
+            buffer.erase(buffer.begin(), buffer.begin() + begin);
+            begin = 0;
+        }
+        char chunk[1 << 16];
+        DWORD read = 0;
+        if (!ReadFile(out, chunk, sizeof(chunk), &read, NULL) || read == 0) return false;
+        buffer.insert(buffer.end(), chunk, chunk + read);
+        return true;
+    }
+
+    bool readLine(std::string& line)
+    {
+        for (;;)
+        {
+            for (size_t i = begin; i < buffer.size(); ++i)
+            {
+                if (buffer[i] != '\n') continue;
+                line.assign(buffer.data() + begin, i - begin);
+                begin = i + 1;
+                return true;
+            }
+            if (!fill()) return false;
+        }
+    }
+
+    bool skipBytes(size_t count)
+    {
+        while (buffer.size() - begin < count)
+        {
+            count -= buffer.size() - begin;
+            begin = buffer.size();
+            if (!fill()) return false;
+        }
+        begin += count;
+        return true;
+    }
+};
+
+// Reads one response line and the frame bytes it announces.
+bool readResponse(Helper& helper, int64_t& lineAt)
+{
+    std::string line;
+    if (!helper.readLine(line)) return false;
+    lineAt = qpcNow();
+    JsonValue response;
+    JsonReader reader(line.c_str());
+    if (!reader.parse(response) || response.find("error")) return false;
+    const JsonValue* image = response.find("image");
+    if (!image || !image->isObject()) return false;
+    return helper.skipBytes(static_cast<size_t>(image->numberOr("bytes", 0)));
+}
+
+std::wstring captureArgs(const Case& c)
+{
+    std::wstring args = L" --format=";
+    const char* format = imageFormatName(c.format);
+    args.append(format, format + strlen(format));
+    args += c.backend == BackendDxgi ? L" --backend=dxgi" : L" --backend=printwindow";
+    return args;
+}
+
+void benchServer(const BenchOptions& options, const Case& c)
+{
+    Helper helper;
+    std::string ready;
+    if (!helper.start(L"\"" + options.helper + L"\" --serve") || !helper.readLine(ready) || ready != "READY")
+    {
+        fprintf(stderr, "could not start the window_info server\n");
+        helper.stop();
+        return;
+    }
+
+    Samples roundtrip, transfer;
+    for (int i = 0; i < kWarmup + options.iterations; ++i)
+    {
+        char request[192];
+        snprintf(request, sizeof(request), "{\"id\":%d,\"x\":%d,\"y\":%d,\"frame\":true,\"format\":\"%s\",\"backend\":\"%s\"}\n",
+                 i + 1, kProbe, kProbe, imageFormatName(c.format), captureBackendName(c.backend));
+        int64_t start = qpcNow();
+        int64_t lineAt = 0;
+        if (!helper.write(request) || !readResponse(helper, lineAt))
+        {
+            fprintf(stderr, "server capture failed\n");
+            break;
+        }
+        int64_t end = qpcNow();
+        if (i < kWarmup) continue;
+        roundtrip.add(start, end);
+        transfer.add(lineAt, end);
+    }
+    helper.stop();
+    report(options, c, "server", "roundtrip", roundtrip);
+    report(options, c, "server", "transfer", transfer);
+}
+
+void benchCli(const BenchOptions& options, const Case& c)
+{
+    wchar_t point[32];
+    swprintf(point, 32, L" %d %d --screenshot=-", kProbe, kProbe);
+    const std::wstring commandLine = L"\"" + options.helper + L"\"" + point + captureArgs(c);
+
+    Samples total;
+    for (int i = 0; i < kWarmup + options.iterations; ++i)
+    {
+        Helper helper;
+        int64_t start = qpcNow();
+        int64_t lineAt = 0;
+        const bool ok = helper.start(commandLine) && (helper.closeInput(), readResponse(helper, lineAt));
+        if (ok) WaitForSingleObject(helper.process, 5000);
+        int64_t end = qpcNow();
+        helper.stop();
+        if (!ok)
+        {
+            fprintf(stderr, "window_info.exe capture failed\n");
+            break;
+        }
+        if (i >= kWarmup) total.add(start, end);
+    }
+    report(options, c, "cli", "total", total);
+}
+
+// ---- Options ---------------------------------------------------------------
+
+template <class T, class Parse>
+bool parseList(const char* value, std::vector<T>& out, Parse parse)
+{
+    out.clear();
+    std::string list = value;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        const std::string item = list.substr(start, comma - start);
+        T parsed;
+        if (!item.empty())
+        {
+            if (!parse(item.c_str(), parsed)) return false;
+            out.push_back(parsed);
+        }
+        start = comma + 1;
+    }
+    return !out.empty();
+}
+
+bool parseSize(const char* value, Size& size)
+{
+    char* end = nullptr;
+    size.width = static_cast<int>(strtol(value, &end, 10));
+    if (!end || (*end != 'x' && *end != 'X')) return false;
+    size.height = static_cast<int>(strtol(end + 1, nullptr, 10));
+    return size.width > 0 && size.height > 0;
+}
+
+bool parseOptions(int argc, char* argv[], BenchOptions& options)
+{
+    wchar_t self[MAX_PATH];
+    GetModuleFileNameW(NULL, self, MAX_PATH);
+    options.helper = self;
+    options.helper = options.helper.substr(0, options.helper.find_last_of(L"\\/") + 1) + L"..\\window_info.exe";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        bool ok = true;
+        if (strncmp(arg, "--sizes=", 8) == 0)
+        {
+            ok = parseList(arg + 8, options.sizes, parseSize);
+        }
+        else if (strncmp(arg, "--backends=", 11) == 0)
+        {
+            ok = parseList(arg + 11, options.backends, parseCaptureBackend);
+        }
+        else if (strncmp(arg, "--formats=", 10) == 0)
+        {
+            ok = parseList(arg + 10, options.formats, parseImageFormat);
+        }
+        else if (strncmp(arg, "--modes=", 8) == 0)
+        {
+            const std::string modes = std::string(",") + (arg + 8) + ",";
+            options.inProcess = modes.find(",inprocess,") != std::string::npos;
+            options.server = modes.find(",server,") != std::string::npos;
+            options.cli = modes.find(",cli,") != std::string::npos;
+        }
+        else if (strncmp(arg, "--iterations=", 13) == 0)
+        {
+            options.iterations = atoi(arg + 13);
+            ok = options.iterations > 0;
+        }
+        else if (strncmp(arg, "--helper=", 9) == 0)
+        {
+            const int length = MultiByteToWideChar(CP_UTF8, 0, arg + 9, -1, NULL, 0);
+            options.helper.assign(length > 0 ? length - 1 : 0, L'\0');
+            if (length > 1) MultiByteToWideChar(CP_UTF8, 0, arg + 9, -1, &options.helper[0], length);
+        }
+        else if (strcmp(arg, "--json") == 0)
+        {
+            options.json = true;
+        }
+        else
+        {
+            ok = false;
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "Invalid option: %s\n", arg);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    enablePerMonitorDpiAwareness();
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) return 1;
+    const bool helperFound = GetFileAttributesW(options.helper.c_str()) != INVALID_FILE_ATTRIBUTES;
+    if ((options.server || options.cli) && !helperFound)
+    {
+        fprintf(stderr, "window_info.exe not found; server and cli modes skipped (--helper=)\n");
+        options.server = options.cli = false;
+    }
+    if (!ensureGdiplus())
+    {
+        fprintf(stderr, "GDI+ startup failed\n");
+        return 1;
+    }
+
+    // Server-mode state, so in-process numbers match --serve.
+    DibPool dibPool;
+    g_dibPool = &dibPool;
+
+    if (!options.json)
+    {
+        printf("%-10s %-12s %-5s %-10s %-14s %5s %10s %10s %10s\n", "size", "backend", "fmt", "mode", "stage", "n",
+               "p50_us", "p95_us", "p99_us");
+    }
+    for (const Size& size : options.sizes)
+    {
+        SyntheticWindow window;
+        if (!openSyntheticWindow(size, window))
+        {
+            fprintf(stderr, "could not open a %dx%d window\n", size.width, size.height);
+            closeSyntheticWindow(window);
+            continue;
+        }
+        // Started once the window exists: the index skips WinEvents from its
+        // own process, so it would not notice the window appear.
+        WindowIndex index;
+        index.start();
+        for (CaptureBackend backend : options.backends)
+        {
+            for (ImageFormat format : options.formats)
+            {
+                const Case c = {size, backend, format};
+                if (options.inProcess) benchInProcess(options, c, window.hwnd, index);
+                if (options.server) benchServer(options, c);
+                if (options.cli) benchCli(options, c);
+            }
+        }
+        index.stop();
+        closeSyntheticWindow(window);
+        dibPool.clear();
+    }
+
+    g_dibPool = nullptr;
+    shutdownGdiplus();
+    return 0;
+}
@@ -0,0 +1,17 @@
+{
+  "targets": [
+    {
+      "target_name": "window_info_addon",
+      "sources": ["src/window_info_addon.cpp"],
+      "defines": ["NAPI_VERSION=4"],
+      "conditions": [
+        ["OS=='win'", {
+          "libraries": ["user32.lib", "gdi32.lib", "gdiplus.lib", "ole32.lib", "oleaut32.lib", "d3d11.lib", "dxgi.lib", "dwmapi.lib"],
+          "msvs_settings": {
+            "VCCLCompilerTool": { "ExceptionHandling": 1, "Optimization": 2 }
+          }
+        }]
+      ]
+    }
+  ]
+}
@@ -1,24 +1,33 @@
 # Build script for native helpers
 # Tries MSVC first, falls back to MinGW, then clang
+# -Bench also builds bench\capture_bench.exe (run it via bench\bench.ps1)
+
+param([switch]$Bench)
 
 $targets = @(
     @{ src = "src\mouse_block.cpp"; out = "mouse_block.exe" },
-    @{ src = "src\window_info.cpp"; out = "window_info.exe" }
+    @{ src = "src\window_info.cpp"; out = "window_info.exe" },
+    @{ src = "src\stella_native_host.cpp"; out = "stella_native_host.exe" }
 )
+if ($Bench) {
+    $targets += @{ src = "bench\capture_bench.cpp"; out = "bench\capture_bench.exe" }
+}
 
+# Every target links the full set that stella_native_host needs; the
+# standalone helpers share its headers, so they are built the same way.
 function Build-WithMSVC($vcvars, $srcFile, $outFile) {
-    $cmd = "`"$vcvars`" && cl /O2 /EHsc /nologo $srcFile /link user32.lib gdi32.lib gdiplus.lib ole32.lib /OUT:$outFile"
+    $cmd = "`"$vcvars`" && cl /O2 /EHsc /nologo $srcFile /link user32.lib gdi32.lib gdiplus.lib ole32.lib oleaut32.lib d3d11.lib dxgi.lib dwmapi.lib /OUT:$outFile"
     cmd /c $cmd
     return (Test-Path $outFile)
 }
 
 function Build-WithGpp($srcFile, $outFile) {
-    & g++ -O2 -static $srcFile -o $outFile -luser32 -lgdi32 -lgdiplus -lole32
+    & g++ -O2 -static $srcFile -o $outFile -luser32 -lgdi32 -lgdiplus -lole32 -loleaut32 -ld3d11 -ldxgi -ldwmapi
     return (Test-Path $outFile)
 }
 
 function Build-WithClang($srcFile, $outFile) {
-    & clang++ -O2 $srcFile -o $outFile -luser32 -lgdi32 -lgdiplus -lole32
+    & clang++ -O2 $srcFile -o $outFile -luser32 -lgdi32 -lgdiplus -lole32 -loleaut32 -ld3d11 -ldxgi -ldwmapi
     return (Test-Path $outFile)
 }
 
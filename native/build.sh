@@ -1,9 +1,12 @@
 #!/bin/bash
 # Build script for native helpers (macOS)
+# Needs Xcode 15+ (the macOS 14 SDK, for SCScreenshotManager); the helper
+# itself runs on macOS 12.3+ and falls back to CGWindowList before 14.
 set -e
 
 cd "$(dirname "$0")"
 
 echo "Building window_info (macOS)..."
-swiftc -O -o window_info src/window_info.swift -framework CoreGraphics -framework AppKit
+swiftc -O -target "$(uname -m)-apple-macos12.3" -o window_info src/window_info.swift \
+    -framework CoreGraphics -framework AppKit -framework ImageIO -framework ScreenCaptureKit
 echo "Build successful: window_info"
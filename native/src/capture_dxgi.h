@@ -0,0 +1,242 @@
+// capture_dxgi.h - DXGI Desktop Duplication capture backend.
+//
+// PrintWindow asks the target to repaint into our DC, which is slow for heavy
+// apps and often blank for GPU-composited ones (Chrome, Electron, games).
+// Desktop Duplication instead copies what DWM already composed, so it works
+// for those apps, at the cost of including anything covering the window.
+//
+// One DxgiCapture keeps its duplications and staging textures alive between
+// captures (the warm session used by window_info --serve). When nothing
+// changed since the last capture AcquireNextFrame times out immediately and
+// the previous staging copy is reused.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <d3d11.h>
+#include <dxgi1_2.h>
+#include <cstring>
+#include <vector>
+
+#include "image_encode.h"
+
+#pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "dxgi.lib")
+
+template <class T>
+static void safeRelease(T*& p)
+{
+    if (p)
+    {
+        p->Release();
+        p = nullptr;
+    }
+}
+
+class DxgiCapture
+{
+public:
+    DxgiCapture() = default;
+    DxgiCapture(const DxgiCapture&) = delete;
+    DxgiCapture& operator=(const DxgiCapture&) = delete;
+    ~DxgiCapture() { reset(); }
+
+    // Copies rect (virtual-desktop physical pixels) into image as top-down
+    // BGRA. Parts of rect not on any output are left black.
+    bool capture(const RECT& rect, CapturedImage& image)
+    {
+        // A second attempt covers DXGI_ERROR_ACCESS_LOST (mode change,
+        // desktop switch, UAC prompt), after which duplications are recreated.
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            if (outputs_.empty() && !init()) return false;
+            Status status = copyRect(rect, image);
+            if (status == Ok) return true;
+            if (status == Failed) return false;
+            reset();
+        }
+        return false;
+    }
+
+    void reset()
+    {
+        for (Output& out : outputs_)
+        {
+            safeRelease(out.staging);
+            safeRelease(out.duplication);
+            safeRelease(out.context);
+            safeRelease(out.device);
+        }
+        outputs_.clear();
+    }
+
+private:
+    enum Status { Ok, Failed, Lost };
+
+    struct Output
+    {
+        ID3D11Device* device;
+        ID3D11DeviceContext* context;
+        IDXGIOutputDuplication* duplication;
+        ID3D11Texture2D* staging; // last full frame, CPU-readable
+        RECT bounds;              // desktop coordinates
+        bool hasFrame;
+    };
+
+    std::vector<Output> outputs_;
+
+    bool init()
+    {
+        IDXGIFactory1* factory = nullptr;
+        if (FAILED(CreateDXGIFactory1(__uuidof(IDXGIFactory1), reinterpret_cast<void**>(&factory))))
+        {
+            return false;
+        }
+
+        IDXGIAdapter1* adapter = nullptr;
+        for (UINT a = 0; factory->EnumAdapters1(a, &adapter) != DXGI_ERROR_NOT_FOUND; ++a)
+        {
+            // Duplication needs a device on the adapter that owns the output.
+            ID3D11Device* device = nullptr;
+            ID3D11DeviceContext* context = nullptr;
+            HRESULT hr = D3D11CreateDevice(adapter, D3D_DRIVER_TYPE_UNKNOWN, NULL,
+                                           D3D11_CREATE_DEVICE_BGRA_SUPPORT, NULL, 0,
+                                           D3D11_SDK_VERSION, &device, NULL, &context);
+            if (SUCCEEDED(hr))
+            {
+                addOutputs(adapter, device, context);
+            }
+            safeRelease(context);
+            safeRelease(device);
+            adapter->Release();
+        }
+        factory->Release();
+        return !outputs_.empty();
+    }
+
+    void addOutputs(IDXGIAdapter1* adapter, ID3D11Device* device, ID3D11DeviceContext* context)
+    {
+        IDXGIOutput* output = nullptr;
+        for (UINT o = 0; adapter->EnumOutputs(o, &output) != DXGI_ERROR_NOT_FOUND; ++o)
+        {
+            DXGI_OUTPUT_DESC desc = {};
+            output->GetDesc(&desc);
+
+            // Rotated outputs would need a pixel transpose; leave them to PrintWindow.
+            bool usable = desc.AttachedToDesktop &&
+                          (desc.Rotation == DXGI_MODE_ROTATION_IDENTITY ||
+                           desc.Rotation == DXGI_MODE_ROTATION_UNSPECIFIED);
+            IDXGIOutput1* output1 = nullptr;
+            if (usable && SUCCEEDED(output->QueryInterface(__uuidof(IDXGIOutput1),
+                                                           reinterpret_cast<void**>(&output1))))
+            {
+                IDXGIOutputDuplication* duplication = nullptr;
+                if (SUCCEEDED(output1->DuplicateOutput(device, &duplication)))
+                {
+                    Output entry = {};
+                    entry.device = device;
+                    entry.device->AddRef();
+                    entry.context = context;
+                    entry.context->AddRef();
+                    entry.duplication = duplication;
+                    entry.bounds = desc.DesktopCoordinates;
+                    outputs_.push_back(entry);
+                }
+                output1->Release();
+            }
+            output->Release();
+        }
+    }
+
+    // Brings out.staging up to date with the latest composed frame.
+    Status refresh(Output& out)
+    {
+        DXGI_OUTDUPL_FRAME_INFO info = {};
+        IDXGIResource* resource = nullptr;
+        // The first acquire after DuplicateOutput always yields the current
+        // desktop; later ones time out when nothing has changed.
+        HRESULT hr = out.duplication->AcquireNextFrame(out.hasFrame ? 0 : 500, &info, &resource);
+        if (hr == DXGI_ERROR_WAIT_TIMEOUT) return out.hasFrame ? Ok : Failed;
+        if (hr == DXGI_ERROR_ACCESS_LOST) return Lost;
+        if (FAILED(hr)) return Failed;
+
+        ID3D11Texture2D* frame = nullptr;
+        hr = resource->QueryInterface(__uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&frame));
+        resource->Release();
+        if (SUCCEEDED(hr))
+        {
+            if (!out.staging)
+            {
+                D3D11_TEXTURE2D_DESC desc = {};
+                frame->GetDesc(&desc);
+                desc.Usage = D3D11_USAGE_STAGING;
+                desc.BindFlags = 0;
+                desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+                desc.MiscFlags = 0;
+                desc.MipLevels = 1;
+                desc.ArraySize = 1;
+                desc.SampleDesc.Count = 1;
+                desc.SampleDesc.Quality = 0;
+                out.device->CreateTexture2D(&desc, NULL, &out.staging);
+            }
+            if (out.staging)
+            {
+                out.context->CopyResource(out.staging, frame);
+                out.hasFrame = true;
+            }
+            frame->Release();
+        }
+        out.duplication->ReleaseFrame();
+        return out.hasFrame ? Ok : Failed;
+    }
+
+    Status copyRect(const RECT& rect, CapturedImage& image)
+    {
+        const int w = rect.right - rect.left;
+        const int h = rect.bottom - rect.top;
+        if (w <= 0 || h <= 0) return Failed;
+
+        image.width = w;
+        image.height = h;
+        image.origin.x = rect.left;
+        image.origin.y = rect.top;
+        image.pixels.assign(static_cast<size_t>(w) * h * 4, 0);
+
+        bool copied = false;
+        for (Output& out : outputs_)
+        {
+            RECT overlap = {};
+            if (!IntersectRect(&overlap, &rect, &out.bounds)) continue;
+
+            Status status = refresh(out);
+            if (status == Lost) return Lost;
+            if (status != Ok) continue;
+
+            D3D11_MAPPED_SUBRESOURCE mapped = {};
+            if (FAILED(out.context->Map(out.staging, 0, D3D11_MAP_READ, 0, &mapped))) continue;
+
+            const size_t rowBytes = static_cast<size_t>(overlap.right - overlap.left) * 4;
+            for (LONG y = overlap.top; y < overlap.bottom; ++y)
+            {
+                const BYTE* src = static_cast<const BYTE*>(mapped.pData) +
+                                  static_cast<size_t>(y - out.bounds.top) * mapped.RowPitch +
+                                  static_cast<size_t>(overlap.left - out.bounds.left) * 4;
+                BYTE* dst = image.pixels.data() +
+                            (static_cast<size_t>(y - rect.top) * w + (overlap.left - rect.left)) * 4;
+                memcpy(dst, src, rowBytes);
+            }
+            out.context->Unmap(out.staging, 0);
+            copied = true;
+        }
+        if (!copied) return Failed;
+
+        BYTE* px = image.pixels.data();
+        const size_t count = static_cast<size_t>(w) * h;
+        for (size_t i = 0; i < count; ++i)
+        {
+            px[i * 4 + 3] = 0xFF;
+        }
+        return Ok;
+    }
+};
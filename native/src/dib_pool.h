@@ -0,0 +1,133 @@
+// dib_pool.h - Reusable DIB sections for PrintWindow captures.
+//
+// PrintWindow draws into a memory DC. With a DIB section selected into it the
+// pixels can be read in place, so there is no GetDIBits copy and the encoders
+// read the capture straight from the section's memory (CapturedImage::view).
+// Server mode keeps a few idle sections, bucketed by size, so repeated
+// captures also skip the CreateCompatibleDC / CreateDIBSection churn. A
+// section rounded up to its bucket is read through its stride; only the
+// top-left w x h of it belongs to the capture.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <vector>
+
+struct DibSurface
+{
+    HDC dc = NULL;
+    HBITMAP bitmap = NULL;
+    HGDIOBJ previous = NULL;
+    BYTE* bits = nullptr; // top-down 32bpp BGRA
+    int width = 0;
+    int height = 0;
+
+    size_t stride() const { return static_cast<size_t>(width) * 4; }
+};
+
+class DibPool
+{
+public:
+    DibPool() { InitializeSRWLock(&lock_); }
+    DibPool(const DibPool&) = delete;
+    DibPool& operator=(const DibPool&) = delete;
+    ~DibPool() { clear(); }
+
+    // An idle section of at least w x h that is not more than twice the
+    // area needed, or a new one rounded up to the bucket size.
+    DibSurface* acquire(int w, int h)
+    {
+        AcquireSRWLockExclusive(&lock_);
+        DibSurface* best = nullptr;
+        size_t bestIndex = 0;
+        const long long needed = static_cast<long long>(w) * h;
+        for (size_t i = 0; i < idle_.size(); ++i)
+        {
+            DibSurface* surface = idle_[i];
+            const long long area = static_cast<long long>(surface->width) * surface->height;
+            if (surface->width < w || surface->height < h || area > needed * 2) continue;
+            if (!best || area < static_cast<long long>(best->width) * best->height)
+            {
+                best = surface;
+                bestIndex = i;
+            }
+        }
+        if (best) idle_.erase(idle_.begin() + bestIndex);
+        ReleaseSRWLockExclusive(&lock_);
+        return best ? best : create(roundUp(w), roundUp(h));
+    }
+
+    // Returns a section to the idle list; the oldest idle one is destroyed
+    // once more than MAX_IDLE are kept.
+    void release(DibSurface* surface)
+    {
+        DibSurface* evicted = nullptr;
+        AcquireSRWLockExclusive(&lock_);
+        idle_.push_back(surface);
+        if (idle_.size() > MAX_IDLE)
+        {
+            evicted = idle_.front();
+            idle_.erase(idle_.begin());
+        }
+        ReleaseSRWLockExclusive(&lock_);
+        if (evicted) destroy(evicted);
+    }
+
+    void clear()
+    {
+        AcquireSRWLockExclusive(&lock_);
+        std::vector<DibSurface*> idle;
+        idle.swap(idle_);
+        ReleaseSRWLockExclusive(&lock_);
+        for (DibSurface* surface : idle) destroy(surface);
+    }
+
+    // An unpooled section of exactly w x h, selected into its own memory DC.
+    static DibSurface* create(int w, int h)
+    {
+        BITMAPINFO bmi = {};
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = w;
+        bmi.bmiHeader.biHeight = -h; // negative = top-down rows
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+
+        void* bits = nullptr;
+        HBITMAP bitmap = CreateDIBSection(NULL, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+        if (!bitmap) return nullptr;
+        HDC dc = CreateCompatibleDC(NULL);
+        if (!dc)
+        {
+            DeleteObject(bitmap);
+            return nullptr;
+        }
+
+        DibSurface* surface = new DibSurface;
+        surface->dc = dc;
+        surface->bitmap = bitmap;
+        surface->previous = SelectObject(dc, bitmap);
+        surface->bits = static_cast<BYTE*>(bits);
+        surface->width = w;
+        surface->height = h;
+        return surface;
+    }
+
+    static void destroy(DibSurface* surface)
+    {
+        SelectObject(surface->dc, surface->previous);
+        DeleteDC(surface->dc);
+        DeleteObject(surface->bitmap);
+        delete surface;
+    }
+
+private:
+    static const size_t MAX_IDLE = 4;
+    static const int BUCKET = 128; // pixels; window sizes drift by a few px on resize
+
+    static int roundUp(int value) { return (value + BUCKET - 1) / BUCKET * BUCKET; }
+
+    SRWLOCK lock_;
+    std::vector<DibSurface*> idle_;
+};
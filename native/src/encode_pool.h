@@ -0,0 +1,114 @@
+// encode_pool.h - Small worker pool for the encode stage of server captures.
+//
+// window_info --serve captures on its request thread (PrintWindow and the
+// DXGI session are not shared across threads) and hands the pixels to this
+// pool for downscaling, encoding and writing the response. The next request
+// is read and captured while the previous frame is still being encoded.
+// Jobs start in submission order but, with several workers, can finish out
+// of order; responses carry their request id.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+class EncodePool
+{
+public:
+    EncodePool()
+    {
+        InitializeSRWLock(&lock_);
+        InitializeConditionVariable(&wake_);
+        InitializeConditionVariable(&idle_);
+    }
+    EncodePool(const EncodePool&) = delete;
+    EncodePool& operator=(const EncodePool&) = delete;
+    ~EncodePool() { stop(); }
+
+    // Starts up to count workers. With none, submit runs jobs inline.
+    void start(int count)
+    {
+        stopping_ = false;
+        for (int i = 0; i < count; ++i)
+        {
+            HANDLE thread = CreateThread(NULL, 0, workerThread, this, 0, NULL);
+            if (thread) threads_.push_back(thread);
+        }
+    }
+
+    void submit(std::function<void()> job)
+    {
+        if (threads_.empty())
+        {
+            job();
+            return;
+        }
+        AcquireSRWLockExclusive(&lock_);
+        jobs_.push_back(std::move(job));
+        ReleaseSRWLockExclusive(&lock_);
+        WakeConditionVariable(&wake_);
+    }
+
+    // Blocks until every submitted job has finished.
+    void drain()
+    {
+        AcquireSRWLockExclusive(&lock_);
+        while (!jobs_.empty() || busy_ > 0)
+        {
+            SleepConditionVariableSRW(&idle_, &lock_, INFINITE, 0);
+        }
+        ReleaseSRWLockExclusive(&lock_);
+    }
+
+    // Finishes the queued jobs, then joins the workers.
+    void stop()
+    {
+        if (threads_.empty()) return;
+        drain();
+        AcquireSRWLockExclusive(&lock_);
+        stopping_ = true;
+        ReleaseSRWLockExclusive(&lock_);
+        WakeAllConditionVariable(&wake_);
+        WaitForMultipleObjects(static_cast<DWORD>(threads_.size()), threads_.data(), TRUE, INFINITE);
+        for (HANDLE thread : threads_) CloseHandle(thread);
+        threads_.clear();
+    }
+
+private:
+    static DWORD WINAPI workerThread(LPVOID param)
+    {
+        EncodePool* self = static_cast<EncodePool*>(param);
+        AcquireSRWLockExclusive(&self->lock_);
+        for (;;)
+        {
+            while (self->jobs_.empty() && !self->stopping_)
+            {
+                SleepConditionVariableSRW(&self->wake_, &self->lock_, INFINITE, 0);
+            }
+            if (self->jobs_.empty()) break;
+
+            std::function<void()> job = std::move(self->jobs_.front());
+            self->jobs_.pop_front();
+            ++self->busy_;
+            ReleaseSRWLockExclusive(&self->lock_);
+            job();
+            AcquireSRWLockExclusive(&self->lock_);
+            --self->busy_;
+            if (self->jobs_.empty() && self->busy_ == 0) WakeAllConditionVariable(&self->idle_);
+        }
+        ReleaseSRWLockExclusive(&self->lock_);
+        return 0;
+    }
+
+    SRWLOCK lock_;
+    CONDITION_VARIABLE wake_;
+    CONDITION_VARIABLE idle_;
+    std::deque<std::function<void()>> jobs_;
+    std::vector<HANDLE> threads_;
+    int busy_ = 0;
+    bool stopping_ = false;
+};
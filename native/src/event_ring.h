@@ -0,0 +1,45 @@
+// event_ring.h - Bounded lock-free single-producer/single-consumer ring.
+//
+// Used to get work out of WH_MOUSE_LL callbacks: the hook thread pushes and
+// never waits, a writer thread pops and does the (possibly blocking) pipe
+// I/O. When the consumer falls behind, push fails and the caller counts the
+// drop instead of stalling input for the whole desktop.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+template <class T, size_t Capacity>
+class SpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer only. Returns false when full.
+    bool push(const T& item)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == Capacity) return false;
+        items_[head & (Capacity - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false when empty.
+    bool pop(T& item)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        item = items_[tail & (Capacity - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // Separate cache lines so producer and consumer do not false-share.
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) T items_[Capacity];
+};
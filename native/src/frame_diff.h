@@ -0,0 +1,288 @@
+// frame_diff.h - Dirty-tile detection for repeated captures of one window.
+//
+// Server mode keeps, per window, 64-bit hashes of 64x64 tiles of the last
+// frame it delivered (not the pixels). A new capture is hashed the same way
+// and compared tile by tile: no changed tile means the caller can answer
+// "unchanged" without encoding, a few changed tiles mean only their bounding
+// box needs encoding. Hashing is an XXH3-style multiply-accumulate, SSE2
+// where available, and runs at close to memory bandwidth.
+// Header-only and free of Win32; windows are keyed by their HWND value.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define STELLA_DIFF_SSE2 1
+#endif
+
+static const int FRAME_TILE_SIZE = 64;
+
+// Pixel rectangle, right/bottom exclusive.
+struct TileRect
+{
+    int left = 0;
+    int top = 0;
+    int right = 0;
+    int bottom = 0;
+
+    int width() const { return right - left; }
+    int height() const { return bottom - top; }
+};
+
+namespace framediff
+{
+
+inline uint64_t mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static const uint64_t kKey0 = 0xBE4BA423396CFEB8ull;
+static const uint64_t kKey1 = 0x1CAD21F72C81017Cull;
+// Added to the keys after every 16-byte block. The sum of products would
+// otherwise not depend on block order, and content moving inside a tile
+// would hash the same.
+static const uint64_t kKeyStep0 = 0x9E3779B97F4A7C15ull;
+static const uint64_t kKeyStep1 = 0xC2B2AE3D27D4EB4Full;
+
+// Hash of w x h pixels (top-down BGRA) starting at pixels.
+inline uint64_t hashTile(const uint8_t* pixels, size_t stride, int w, int h)
+{
+    const size_t rowBytes = static_cast<size_t>(w) * 4;
+    uint8_t tail[16];
+#ifdef STELLA_DIFF_SSE2
+    __m128i key = _mm_set_epi64x(static_cast<long long>(kKey1), static_cast<long long>(kKey0));
+    const __m128i keyStep = _mm_set_epi64x(static_cast<long long>(kKeyStep1), static_cast<long long>(kKeyStep0));
+    __m128i acc = _mm_set_epi64x(static_cast<long long>(kKey0), static_cast<long long>(kKey1));
+    for (int y = 0; y < h; ++y)
+    {
+        const uint8_t* row = pixels + stride * y;
+        for (size_t i = 0; i < rowBytes; i += 16)
+        {
+            __m128i data;
+            if (rowBytes - i >= 16)
+            {
+                data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+            }
+            else
+            {
+                memset(tail, 0, sizeof(tail));
+                memcpy(tail, row + i, rowBytes - i);
+                data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail));
+            }
+            const __m128i dataKey = _mm_xor_si128(data, key);
+            const __m128i keyHigh = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+            const __m128i product = _mm_mul_epu32(dataKey, keyHigh);
+            const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            acc = _mm_add_epi64(acc, _mm_add_epi64(product, swapped));
+            key = _mm_add_epi64(key, keyStep);
+        }
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+#else
+    // Same arithmetic as the SSE2 path, one 64-bit lane at a time.
+    uint64_t lanes[2] = {kKey1, kKey0};
+    uint64_t key0 = kKey0;
+    uint64_t key1 = kKey1;
+    for (int y = 0; y < h; ++y)
+    {
+        const uint8_t* row = pixels + stride * y;
+        for (size_t i = 0; i < rowBytes; i += 16)
+        {
+            const uint8_t* block = row + i;
+            if (rowBytes - i < 16)
+            {
+                memset(tail, 0, sizeof(tail));
+                memcpy(tail, row + i, rowBytes - i);
+                block = tail;
+            }
+            uint64_t d0, d1;
+            memcpy(&d0, block, 8);
+            memcpy(&d1, block + 8, 8);
+            const uint64_t k0 = d0 ^ key0;
+            const uint64_t k1 = d1 ^ key1;
+            lanes[0] += (k0 & 0xFFFFFFFFu) * (k0 >> 32) + d1;
+            lanes[1] += (k1 & 0xFFFFFFFFu) * (k1 >> 32) + d0;
+            key0 += kKeyStep0;
+            key1 += kKeyStep1;
+        }
+    }
+#endif
+    return mix64(lanes[0] ^ mix64(lanes[1] + rowBytes * h));
+}
+
+} // namespace framediff
+
+// Result of comparing a frame with the one cached for its window.
+struct FrameDiff
+{
+    bool hasBase = false;   // a comparable previous frame was found
+    long long baseId = 0;   // request id of that frame
+    bool unchanged = false; // every tile matched
+    TileRect bounds;        // bounding box of the changed tiles
+    std::vector<TileRect> runs; // changed tiles, merged along each tile row
+};
+
+// Tile hashes of the last frame per window. Not thread-safe; the server
+// touches it from its request thread only.
+class FrameCache
+{
+public:
+    explicit FrameCache(size_t capacity = 16) : capacity_(capacity) {}
+
+    // Hashes the frame, compares it with the cached one for key when that
+    // frame's id is in bases (frames the client still holds) and was made
+    // with the same signature (encoder settings), then caches the new frame
+    // under id.
+    void update(uintptr_t key, long long id, uint64_t signature, const uint8_t* pixels, size_t stride, int width,
+                int height, const std::vector<long long>& bases, FrameDiff& diff)
+    {
+        diff = FrameDiff();
+        const int cols = (width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+        const int rows = (height + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+        std::vector<uint64_t> hashes(static_cast<size_t>(cols) * rows);
+        for (int ty = 0; ty < rows; ++ty)
+        {
+            for (int tx = 0; tx < cols; ++tx)
+            {
+                const int x = tx * FRAME_TILE_SIZE;
+                const int y = ty * FRAME_TILE_SIZE;
+                const int w = width - x < FRAME_TILE_SIZE ? width - x : FRAME_TILE_SIZE;
+                const int h = height - y < FRAME_TILE_SIZE ? height - y : FRAME_TILE_SIZE;
+                hashes[static_cast<size_t>(ty) * cols + tx] =
+                    framediff::hashTile(pixels + stride * y + static_cast<size_t>(x) * 4, stride, w, h);
+            }
+        }
+
+        Entry* entry = find(key);
+        if (entry && entry->signature == signature && entry->width == width && entry->height == height &&
+            holds(bases, entry->id))
+        {
+            diff.hasBase = true;
+            diff.baseId = entry->id;
+            compare(entry->hashes, hashes, width, height, cols, rows, diff);
+        }
+
+        if (!entry) entry = allocate(key);
+        entry->id = id;
+        entry->signature = signature;
+        entry->width = width;
+        entry->height = height;
+        entry->hashes.swap(hashes);
+        entry->lastUse = ++clock_;
+    }
+
+    void clear() { entries_.clear(); }
+
+private:
+    struct Entry
+    {
+        uintptr_t key;
+        long long id;
+        uint64_t signature;
+        int width;
+        int height;
+        std::vector<uint64_t> hashes;
+        unsigned long long lastUse;
+    };
+
+    static bool holds(const std::vector<long long>& bases, long long id)
+    {
+        for (long long base : bases)
+        {
+            if (base == id) return true;
+        }
+        return false;
+    }
+
+    static void compare(const std::vector<uint64_t>& before, const std::vector<uint64_t>& after, int width,
+                        int height, int cols, int rows, FrameDiff& diff)
+    {
+        bool any = false;
+        for (int ty = 0; ty < rows; ++ty)
+        {
+            int runStart = -1;
+            for (int tx = 0; tx <= cols; ++tx)
+            {
+                const size_t i = static_cast<size_t>(ty) * cols + tx;
+                const bool dirty = tx < cols && before[i] != after[i];
+                if (dirty && runStart < 0) runStart = tx;
+                if (dirty || runStart < 0) continue;
+
+                TileRect run;
+                run.left = runStart * FRAME_TILE_SIZE;
+                run.top = ty * FRAME_TILE_SIZE;
+                run.right = tx * FRAME_TILE_SIZE < width ? tx * FRAME_TILE_SIZE : width;
+                run.bottom = run.top + FRAME_TILE_SIZE < height ? run.top + FRAME_TILE_SIZE : height;
+                if (!any)
+                {
+                    diff.bounds = run;
+                    any = true;
+                }
+                else
+                {
+                    if (run.left < diff.bounds.left) diff.bounds.left = run.left;
+                    if (run.right > diff.bounds.right) diff.bounds.right = run.right;
+                    diff.bounds.bottom = run.bottom;
+                }
+                diff.runs.push_back(run);
+                runStart = -1;
+            }
+        }
+        diff.unchanged = !any;
+    }
+
+    Entry* find(uintptr_t key)
+    {
+        for (Entry& entry : entries_)
+        {
+            if (entry.key == key) return &entry;
+        }
+        return nullptr;
+    }
+
+    // Reuses the least recently updated entry once the cache is full.
+    Entry* allocate(uintptr_t key)
+    {
+        if (entries_.size() < capacity_)
+        {
+            entries_.push_back(Entry());
+            entries_.back().key = key;
+            return &entries_.back();
+        }
+        Entry* oldest = &entries_[0];
+        for (Entry& entry : entries_)
+        {
+            if (entry.lastUse < oldest->lastUse) oldest = &entry;
+        }
+        oldest->key = key;
+        return oldest;
+    }
+
+    size_t capacity_;
+    unsigned long long clock_ = 0;
+    std::vector<Entry> entries_;
+};
+
+// Copies rect out of a top-down BGRA frame into a tightly packed buffer.
+inline void cropBgra(const uint8_t* pixels, size_t stride, const TileRect& rect, std::vector<uint8_t>& out)
+{
+    const size_t rowBytes = static_cast<size_t>(rect.width()) * 4;
+    out.resize(rowBytes * rect.height());
+    for (int y = 0; y < rect.height(); ++y)
+    {
+        memcpy(out.data() + rowBytes * y,
+               pixels + stride * (rect.top + y) + static_cast<size_t>(rect.left) * 4, rowBytes);
+    }
+}
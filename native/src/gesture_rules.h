@@ -0,0 +1,215 @@
+// gesture_rules.h - Rule table deciding which mouse buttons mouse_block.exe
+// reports and blocks, keyed by button and held modifiers.
+//
+// Rules arrive as JSON (RULES command on stdin):
+//   [{"id":"radial","button":"right","modifiers":["ctrl"],"block":true,"emitMove":false}]
+// "modifiers" lists keys that must be held; extra modifiers still match
+// unless a more specific rule claims that combination. The table is
+// flattened to slot[button][modifierMask] so the hook does one indexed load
+// per button press instead of walking rules.
+
+#pragma once
+
+#include <cstring>
+#include <string>
+
+#include "json_reader.h"
+
+enum MouseButton
+{
+    ButtonLeft,
+    ButtonRight,
+    ButtonMiddle,
+    ButtonX1,
+    ButtonX2,
+    ButtonCount,
+};
+
+enum ModifierBits : unsigned char
+{
+    ModCtrl = 1,
+    ModShift = 2,
+    ModAlt = 4,
+    ModWin = 8,
+    ModMaskCount = 16,
+};
+
+struct GestureRule
+{
+    char id[16];   // reported on DOWN/UP lines; no whitespace
+    bool block;    // swallow the button down/up so the target never sees it
+    bool emitMove; // stream MOVE while the button is held
+    unsigned char index; // position in the RULES array; binary records carry this instead of id
+};
+
+struct RuleTable
+{
+    static const int kMaxRules = 32;
+
+    // 0 = no rule, otherwise 1 + index into rules.
+    unsigned char slot[ButtonCount][ModMaskCount];
+    GestureRule rules[kMaxRules];
+    int count;
+};
+
+static const char* mouseButtonName(int button)
+{
+    switch (button)
+    {
+    case ButtonLeft:   return "left";
+    case ButtonRight:  return "right";
+    case ButtonMiddle: return "middle";
+    case ButtonX1:     return "x1";
+    case ButtonX2:     return "x2";
+    default:           return "unknown";
+    }
+}
+
+static bool parseMouseButton(const char* value, int& button)
+{
+    for (int b = 0; b < ButtonCount; ++b)
+    {
+        if (strcmp(value, mouseButtonName(b)) == 0)
+        {
+            button = b;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseModifier(const char* value, unsigned char& bit)
+{
+    if (strcmp(value, "ctrl") == 0)  { bit = ModCtrl;  return true; }
+    if (strcmp(value, "shift") == 0) { bit = ModShift; return true; }
+    if (strcmp(value, "alt") == 0)   { bit = ModAlt;   return true; }
+    if (strcmp(value, "win") == 0 || strcmp(value, "meta") == 0) { bit = ModWin; return true; }
+    return false;
+}
+
+// "ctrl+shift", or "-" when nothing is held.
+static std::string modifierNames(unsigned char mods)
+{
+    std::string out;
+    const char* names[] = {"ctrl", "shift", "alt", "win"};
+    for (int i = 0; i < 4; ++i)
+    {
+        if (!(mods & (1 << i))) continue;
+        if (!out.empty()) out += '+';
+        out += names[i];
+    }
+    return out.empty() ? "-" : out;
+}
+
+static int popcount4(unsigned mask)
+{
+    return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+}
+
+static void clearRuleTable(RuleTable& table)
+{
+    memset(&table, 0, sizeof(table));
+}
+
+static bool addRule(RuleTable& table, const GestureRule& rule, int button, unsigned char required)
+{
+    if (table.count >= RuleTable::kMaxRules) return false;
+    table.rules[table.count] = rule;
+    const unsigned char slot = static_cast<unsigned char>(table.count + 1);
+    ++table.count;
+
+    // Claim every held-modifier combination that includes the required
+    // bits. Callers add less specific rules first so specific ones win.
+    for (unsigned mask = 0; mask < ModMaskCount; ++mask)
+    {
+        if ((mask & required) == required) table.slot[button][mask] = slot;
+    }
+    return true;
+}
+
+// Original behaviour: Ctrl+Right-click opens the radial menu and is blocked.
+static void setDefaultRules(RuleTable& table)
+{
+    clearRuleTable(table);
+    GestureRule radial = {};
+    strcpy(radial.id, "radial");
+    radial.block = true;
+    addRule(table, radial, ButtonRight, ModCtrl);
+}
+
+static bool parseRules(const char* json, RuleTable& table, std::string& error)
+{
+    JsonValue root;
+    JsonReader reader(json);
+    if (!reader.parse(root) || !root.isArray())
+    {
+        error = "expected an array";
+        return false;
+    }
+    if (root.items.size() > static_cast<size_t>(RuleTable::kMaxRules))
+    {
+        error = "too many rules";
+        return false;
+    }
+
+    struct Pending
+    {
+        GestureRule rule;
+        int button;
+        unsigned char required;
+    };
+    Pending pending[RuleTable::kMaxRules];
+    int pendingCount = 0;
+
+    for (const JsonValue& item : root.items)
+    {
+        Pending entry = {};
+        const char* id = item.stringOr("id", "");
+        const size_t idLen = strlen(id);
+        if (!idLen || idLen >= sizeof(entry.rule.id) || strpbrk(id, " \t\r\n"))
+        {
+            error = "invalid id";
+            return false;
+        }
+        memcpy(entry.rule.id, id, idLen + 1);
+
+        const char* button = item.stringOr("button", "");
+        if (!parseMouseButton(button, entry.button))
+        {
+            error = "invalid button";
+            return false;
+        }
+
+        const JsonValue* mods = item.find("modifiers");
+        if (mods && mods->isArray())
+        {
+            for (const JsonValue& mod : mods->items)
+            {
+                unsigned char bit = 0;
+                if (!mod.isString() || !parseModifier(mod.str.c_str(), bit))
+                {
+                    error = "invalid modifier";
+                    return false;
+                }
+                entry.required |= bit;
+            }
+        }
+
+        entry.rule.block = item.boolOr("block", false);
+        entry.rule.emitMove = item.boolOr("emitMove", false);
+        entry.rule.index = static_cast<unsigned char>(pendingCount);
+        pending[pendingCount++] = entry;
+    }
+
+    // Fewer required modifiers first, so more specific rules win overlaps.
+    clearRuleTable(table);
+    for (int bits = 0; bits <= 4; ++bits)
+    {
+        for (int i = 0; i < pendingCount; ++i)
+        {
+            if (popcount4(pending[i].required) != bits) continue;
+            addRule(table, pending[i].rule, pending[i].button, pending[i].required);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,326 @@
+// image_encode.h - Screenshot encoders shared by the Windows native helpers.
+// Header-only so each helper stays a single translation unit (see build.ps1).
+//
+//   png  - built-in encoder from png_fast.h (store/fast) or GDI+ (best)
+//   jpeg - GDI+ with an explicit quality
+//   webp - libwebp when built with -DSTELLA_WITH_LIBWEBP, otherwise JPEG
+//   raw  - the capture buffer itself, top-down BGRA
+//
+// GDI+ is started lazily, so the default fast PNG and raw paths never pay for
+// GdiplusStartup. Define STELLA_PNG_DEFAULT_BEST to make GDI+ the PNG default.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <objidl.h>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <gdiplus.h>
+
+#ifdef STELLA_WITH_LIBWEBP
+#include <webp/encode.h>
+#pragma comment(lib, "libwebp.lib")
+#endif
+
+#include "png_fast.h"
+
+#pragma comment(lib, "gdiplus.lib")
+
+// Top-down 32bpp BGRA pixels. Either owned in pixels (stride = width * 4)
+// or borrowed from a DIB section (dib_pool.h) through view, which lease keeps
+// alive; read through data() and stride() to handle both.
+struct CapturedImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<BYTE> pixels;
+    BYTE* view = nullptr;
+    size_t viewStride = 0;
+    std::shared_ptr<void> lease;
+    POINT origin = {}; // screen position of the top-left pixel as captured (before any downscale)
+
+    const BYTE* data() const { return view ? view : pixels.data(); }
+    BYTE* mutableData() { return view ? view : pixels.data(); }
+    size_t stride() const { return view ? viewStride : static_cast<size_t>(width) * 4; }
+
+    // Copies borrowed pixels into pixels and gives the DIB section back.
+    void own()
+    {
+        if (!view) return;
+        const size_t rowBytes = static_cast<size_t>(width) * 4;
+        pixels.resize(rowBytes * height);
+        for (int y = 0; y < height; ++y)
+        {
+            memcpy(pixels.data() + rowBytes * y, view + viewStride * y, rowBytes);
+        }
+        releaseView();
+    }
+
+    // Drops the borrowed pixels, e.g. once pixels holds a downscaled copy.
+    void releaseView()
+    {
+        view = nullptr;
+        viewStride = 0;
+        lease.reset();
+    }
+};
+
+enum ImageFormat
+{
+    FormatPng,
+    FormatJpeg,
+    FormatWebp,
+    FormatRaw, // top-down BGRA, stride = width * 4
+};
+
+enum PngMode
+{
+    PngModeStore, // no compression
+    PngModeFast,  // built-in fixed-Huffman deflate
+    PngModeBest,  // GDI+ encoder: smaller, single-threaded and much slower
+};
+
+struct EncodeOptions
+{
+    ImageFormat format = FormatPng;
+    int quality = 85; // jpeg/webp, 0-100
+#ifdef STELLA_PNG_DEFAULT_BEST
+    PngMode png = PngModeBest;
+#else
+    PngMode png = PngModeFast;
+#endif
+    int threads = 1; // fast/store PNG: stripes encoded concurrently for large images
+};
+
+struct EncodedImage
+{
+    ImageFormat format = FormatPng; // may differ from the request (webp fallback)
+    int width = 0;
+    int height = 0;
+    std::vector<BYTE> bytes;
+};
+
+static const char* imageFormatName(ImageFormat format)
+{
+    switch (format)
+    {
+    case FormatJpeg: return "jpeg";
+    case FormatWebp: return "webp";
+    case FormatRaw:  return "raw";
+    default:         return "png";
+    }
+}
+
+static bool parseImageFormat(const char* value, ImageFormat& format)
+{
+    if (strcmp(value, "png") == 0)  { format = FormatPng;  return true; }
+    if (strcmp(value, "jpeg") == 0 || strcmp(value, "jpg") == 0) { format = FormatJpeg; return true; }
+    if (strcmp(value, "webp") == 0) { format = FormatWebp; return true; }
+    if (strcmp(value, "raw") == 0)  { format = FormatRaw;  return true; }
+    return false;
+}
+
+static bool parsePngMode(const char* value, PngMode& mode)
+{
+    if (strcmp(value, "store") == 0) { mode = PngModeStore; return true; }
+    if (strcmp(value, "fast") == 0)  { mode = PngModeFast;  return true; }
+    if (strcmp(value, "best") == 0)  { mode = PngModeBest;  return true; }
+    return false;
+}
+
+// Stripe threads for one PNG encode when up to concurrentEncodes run at once:
+// together they take every core but one, which is left for capture and the
+// caller's own work.
+static int defaultEncodeThreads(int concurrentEncodes = 1)
+{
+    SYSTEM_INFO info = {};
+    GetSystemInfo(&info);
+    const int cores = static_cast<int>(info.dwNumberOfProcessors);
+    const int perEncode = (cores - 1) / (concurrentEncodes > 1 ? concurrentEncodes : 1);
+    if (perEncode <= 1) return 1;
+    return perEncode < 8 ? perEncode : 8;
+}
+
+static int clampQuality(double value)
+{
+    if (value < 0) return 0;
+    if (value > 100) return 100;
+    return static_cast<int>(value);
+}
+
+static ULONG_PTR g_gdiplusToken = 0;
+
+static bool ensureGdiplus()
+{
+    if (g_gdiplusToken) return true;
+    Gdiplus::GdiplusStartupInput gdiplusStartupInput;
+    return Gdiplus::GdiplusStartup(&g_gdiplusToken, &gdiplusStartupInput, NULL) == Gdiplus::Ok;
+}
+
+static void shutdownGdiplus()
+{
+    if (!g_gdiplusToken) return;
+    Gdiplus::GdiplusShutdown(g_gdiplusToken);
+    g_gdiplusToken = 0;
+}
+
+static int GetEncoderClsid(const wchar_t* mimeType, CLSID* clsid)
+{
+    UINT num = 0, size = 0;
+    Gdiplus::GetImageEncodersSize(&num, &size);
+    if (size == 0) return -1;
+
+    std::vector<BYTE> buf(size);
+    Gdiplus::ImageCodecInfo* codecs = reinterpret_cast<Gdiplus::ImageCodecInfo*>(buf.data());
+    Gdiplus::GetImageEncoders(num, size, codecs);
+
+    for (UINT i = 0; i < num; ++i)
+    {
+        if (wcscmp(codecs[i].MimeType, mimeType) == 0)
+        {
+            *clsid = codecs[i].Clsid;
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+struct CachedClsid
+{
+    const wchar_t* mimeType;
+    bool ready;
+    CLSID clsid;
+};
+
+// The encoder list never changes within a process, so walk it once per type.
+static const CLSID* cachedEncoderClsid(CachedClsid& entry)
+{
+    if (!entry.ready)
+    {
+        if (GetEncoderClsid(entry.mimeType, &entry.clsid) < 0) return nullptr;
+        entry.ready = true;
+    }
+    return &entry.clsid;
+}
+
+static CachedClsid g_pngClsid = {L"image/png", false, {}};
+static CachedClsid g_jpegClsid = {L"image/jpeg", false, {}};
+
+// Formats encoded through GDI+; the others never start it.
+static bool usesGdiplus(const EncodeOptions& options)
+{
+#ifdef STELLA_WITH_LIBWEBP
+    if (options.format == FormatWebp) return false;
+#endif
+    return options.format == FormatJpeg || options.format == FormatWebp ||
+           (options.format == FormatPng && options.png == PngModeBest);
+}
+
+// Starts GDI+ and looks up the encoder CLSID the options will need, so
+// encodes submitted to worker threads only read the shared state.
+static bool prepareEncoder(const EncodeOptions& options)
+{
+    if (!usesGdiplus(options)) return true;
+    if (!ensureGdiplus()) return false;
+    return cachedEncoderClsid(options.format == FormatPng ? g_pngClsid : g_jpegClsid) != nullptr;
+}
+
+static bool encodeWithGdiplus(const CapturedImage& image, CachedClsid& encoder,
+                              const Gdiplus::EncoderParameters* params, std::vector<BYTE>& out)
+{
+    if (!ensureGdiplus()) return false;
+    const CLSID* clsid = cachedEncoderClsid(encoder);
+    if (!clsid) return false;
+
+    // Wraps the capture buffer without copying it.
+    Gdiplus::Bitmap bitmap(image.width, image.height, static_cast<INT>(image.stride()), PixelFormat32bppRGB,
+                           const_cast<BYTE*>(image.data()));
+
+    IStream* stream = nullptr;
+    if (FAILED(CreateStreamOnHGlobal(NULL, TRUE, &stream))) return false;
+
+    bool encoded = false;
+    if (bitmap.Save(stream, clsid, params) == Gdiplus::Ok)
+    {
+        STATSTG stat = {};
+        HGLOBAL hGlobal = NULL;
+        if (SUCCEEDED(stream->Stat(&stat, STATFLAG_NONAME)) &&
+            SUCCEEDED(GetHGlobalFromStream(stream, &hGlobal)))
+        {
+            const void* data = GlobalLock(hGlobal);
+            if (data)
+            {
+                const size_t size = static_cast<size_t>(stat.cbSize.QuadPart);
+                out.assign(static_cast<const BYTE*>(data), static_cast<const BYTE*>(data) + size);
+                GlobalUnlock(hGlobal);
+                encoded = true;
+            }
+        }
+    }
+    stream->Release();
+    return encoded;
+}
+
+static bool encodeJpegGdiplus(const CapturedImage& image, int quality, std::vector<BYTE>& out)
+{
+    ULONG value = static_cast<ULONG>(quality);
+    Gdiplus::EncoderParameters params;
+    params.Count = 1;
+    params.Parameter[0].Guid = Gdiplus::EncoderQuality;
+    params.Parameter[0].Type = Gdiplus::EncoderParameterValueTypeLong;
+    params.Parameter[0].NumberOfValues = 1;
+    params.Parameter[0].Value = &value;
+    return encodeWithGdiplus(image, g_jpegClsid, &params, out);
+}
+
+#ifdef STELLA_WITH_LIBWEBP
+static bool encodeWebp(const CapturedImage& image, int quality, std::vector<BYTE>& out)
+{
+    uint8_t* data = nullptr;
+    size_t size = WebPEncodeBGRA(image.data(), image.width, image.height, static_cast<int>(image.stride()),
+                                 static_cast<float>(quality), &data);
+    if (!size) return false;
+    out.assign(data, data + size);
+    WebPFree(data);
+    return true;
+}
+#endif
+
+// Encodes (or, for raw, takes ownership of) the capture buffer.
+static bool encodeImage(CapturedImage& image, const EncodeOptions& options, EncodedImage& out)
+{
+    out.format = options.format;
+    out.width = image.width;
+    out.height = image.height;
+
+    switch (options.format)
+    {
+    case FormatRaw:
+        image.own();
+        out.bytes.swap(image.pixels);
+        return true;
+
+    case FormatWebp:
+#ifdef STELLA_WITH_LIBWEBP
+        return encodeWebp(image, options.quality, out.bytes);
+#else
+        // No WebP encoder ships with Windows; JPEG is the closest lossy format.
+        out.format = FormatJpeg;
+        return encodeJpegGdiplus(image, options.quality, out.bytes);
+#endif
+
+    case FormatJpeg:
+        return encodeJpegGdiplus(image, options.quality, out.bytes);
+
+    default:
+        if (options.png == PngModeBest)
+        {
+            return encodeWithGdiplus(image, g_pngClsid, NULL, out.bytes);
+        }
+        return encodePngFast(image.data(), image.width, image.height, image.stride(),
+                             options.png == PngModeStore ? PngStore : PngFast, out.bytes, options.threads);
+    }
+}
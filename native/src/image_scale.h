@@ -0,0 +1,188 @@
+// image_scale.h - Downscaling for top-down BGRA captures, done natively so a
+// 4K window shown as a small thumbnail is not encoded and shipped at 4K.
+//
+// Large reductions go through repeated 2x2 box halving (SSE2 where
+// available), which is both fast and a proper area filter; whatever ratio
+// remains (< 2x) is finished with a fixed-point bilinear pass.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define STELLA_SCALE_SSE2 1
+#endif
+
+struct ResizeOptions
+{
+    int maxWidth = 0;  // 0 = unbounded
+    int maxHeight = 0;
+    double scale = 1.0; // applied before the max-size clamp
+};
+
+namespace imagescale
+{
+
+// dst is (w/2) x (h/2), tightly packed.
+inline void halveBgra(const uint8_t* src, int width, int height, size_t stride, uint8_t* dst)
+{
+    const int outW = width / 2;
+    const int outH = height / 2;
+    for (int y = 0; y < outH; ++y)
+    {
+        const uint8_t* row0 = src + stride * (y * 2);
+        const uint8_t* row1 = row0 + stride;
+        uint8_t* out = dst + static_cast<size_t>(outW) * 4 * y;
+        int x = 0;
+#ifdef STELLA_SCALE_SSE2
+        // 8 source pixels -> 4 output pixels per iteration.
+        for (; x + 4 <= outW; x += 4)
+        {
+            const uint8_t* s0 = row0 + x * 8;
+            const uint8_t* s1 = row1 + x * 8;
+            __m128i a = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s0)),
+                                     _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1)));
+            __m128i b = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + 16)),
+                                     _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + 16)));
+            __m128 af = _mm_castsi128_ps(a);
+            __m128 bf = _mm_castsi128_ps(b);
+            __m128i even = _mm_castps_si128(_mm_shuffle_ps(af, bf, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i odd = _mm_castps_si128(_mm_shuffle_ps(af, bf, _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_avg_epu8(even, odd));
+        }
+#endif
+        for (; x < outW; ++x)
+        {
+            const uint8_t* s0 = row0 + x * 8;
+            const uint8_t* s1 = row1 + x * 8;
+            for (int c = 0; c < 4; ++c)
+            {
+                out[x * 4 + c] = static_cast<uint8_t>((s0[c] + s0[c + 4] + s1[c] + s1[c + 4] + 2) >> 2);
+            }
+        }
+    }
+}
+
+// Fixed-point (16.16) bilinear resample of src into a tightly packed dst.
+inline void resizeBilinear(const uint8_t* src, int srcW, int srcH, size_t stride,
+                           uint8_t* dst, int dstW, int dstH)
+{
+    const uint32_t stepX = static_cast<uint32_t>((static_cast<uint64_t>(srcW) << 16) / dstW);
+    const uint32_t stepY = static_cast<uint32_t>((static_cast<uint64_t>(srcH) << 16) / dstH);
+
+    std::vector<int> x0(dstW);
+    std::vector<uint32_t> fx(dstW);
+    for (int x = 0; x < dstW; ++x)
+    {
+        // Sample at pixel centers.
+        int64_t sx = static_cast<int64_t>(x) * stepX + stepX / 2 - 0x8000;
+        if (sx < 0) sx = 0;
+        int ix = static_cast<int>(sx >> 16);
+        if (ix >= srcW - 1)
+        {
+            ix = srcW - 1;
+            sx = static_cast<int64_t>(ix) << 16;
+        }
+        x0[x] = ix;
+        fx[x] = static_cast<uint32_t>(sx & 0xFFFF) >> 8; // 8-bit weight
+    }
+
+    for (int y = 0; y < dstH; ++y)
+    {
+        int64_t sy = static_cast<int64_t>(y) * stepY + stepY / 2 - 0x8000;
+        if (sy < 0) sy = 0;
+        int iy = static_cast<int>(sy >> 16);
+        if (iy >= srcH - 1)
+        {
+            iy = srcH - 1;
+            sy = static_cast<int64_t>(iy) << 16;
+        }
+        const uint32_t wy = static_cast<uint32_t>(sy & 0xFFFF) >> 8;
+        const uint8_t* r0 = src + stride * iy;
+        const uint8_t* r1 = iy + 1 < srcH ? r0 + stride : r0;
+        uint8_t* out = dst + static_cast<size_t>(dstW) * 4 * y;
+
+        for (int x = 0; x < dstW; ++x)
+        {
+            const int ix = x0[x];
+            const int nx = ix + 1 < srcW ? 4 : 0;
+            const uint8_t* p00 = r0 + ix * 4;
+            const uint8_t* p10 = r1 + ix * 4;
+            const uint32_t wx = fx[x];
+            for (int c = 0; c < 4; ++c)
+            {
+                uint32_t top = p00[c] * (256 - wx) + p00[c + nx] * wx;
+                uint32_t bottom = p10[c] * (256 - wx) + p10[c + nx] * wx;
+                out[x * 4 + c] = static_cast<uint8_t>((top * (256 - wy) + bottom * wy + 32768) >> 16);
+            }
+        }
+    }
+}
+
+} // namespace imagescale
+
+// Computes the output size for options, preserving aspect ratio. Never upscales.
+inline void scaledSize(int width, int height, const ResizeOptions& options, int& outW, int& outH)
+{
+    double factor = options.scale > 0 && options.scale < 1.0 ? options.scale : 1.0;
+    if (options.maxWidth > 0 && width * factor > options.maxWidth)
+    {
+        factor = static_cast<double>(options.maxWidth) / width;
+    }
+    if (options.maxHeight > 0 && height * factor > options.maxHeight)
+    {
+        factor = static_cast<double>(options.maxHeight) / height;
+    }
+    outW = static_cast<int>(width * factor + 0.5);
+    outH = static_cast<int>(height * factor + 0.5);
+    if (outW < 1) outW = 1;
+    if (outH < 1) outH = 1;
+    if (outW > width) outW = width;
+    if (outH > height) outH = height;
+}
+
+// Downscales src (stride bytes per row) into out, tightly packed. src may
+// be out's own buffer. Returns false, leaving out untouched, when no resize
+// was needed.
+inline bool downscaleBgra(const uint8_t* src, size_t stride, int& width, int& height, const ResizeOptions& options,
+                          std::vector<uint8_t>& out)
+{
+    int targetW = 0, targetH = 0;
+    scaledSize(width, height, options, targetW, targetH);
+    if (targetW == width && targetH == height) return false;
+
+    std::vector<uint8_t> current, scratch;
+    const uint8_t* from = src;
+    size_t fromStride = stride;
+    while (width / 2 >= targetW && height / 2 >= targetH && width >= 2 && height >= 2)
+    {
+        scratch.resize(static_cast<size_t>(width / 2) * (height / 2) * 4);
+        imagescale::halveBgra(from, width, height, fromStride, scratch.data());
+        current.swap(scratch);
+        width /= 2;
+        height /= 2;
+        from = current.data();
+        fromStride = static_cast<size_t>(width) * 4;
+    }
+
+    if (width != targetW || height != targetH)
+    {
+        scratch.resize(static_cast<size_t>(targetW) * targetH * 4);
+        imagescale::resizeBilinear(from, width, height, fromStride, scratch.data(), targetW, targetH);
+        current.swap(scratch);
+        width = targetW;
+        height = targetH;
+    }
+    out.swap(current);
+    return true;
+}
+
+// Downscales a tightly packed BGRA buffer in place (pixels is replaced).
+// Returns false when no resize was needed.
+inline bool downscaleBgra(std::vector<uint8_t>& pixels, int& width, int& height, const ResizeOptions& options)
+{
+    return downscaleBgra(pixels.data(), static_cast<size_t>(width) * 4, width, height, options, pixels);
+}
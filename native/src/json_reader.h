@@ -0,0 +1,295 @@
+// json_reader.h - Minimal JSON reader for the line-delimited request protocol
+// spoken by the native helpers in server mode. Header-only so each helper
+// stays a single translation unit (see build.ps1).
+//
+// Only what the request protocol needs: objects, arrays, strings (with \u
+// escapes decoded to UTF-8), numbers, booleans and null. Parse errors return
+// false instead of throwing so a bad line can be answered with an error reply.
+
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct JsonValue
+{
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Null;
+    bool boolean = false;
+    double number = 0;
+    std::string str;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* find(const char* key) const
+    {
+        if (type != Object) return nullptr;
+        for (const auto& member : members)
+        {
+            if (member.first == key) return &member.second;
+        }
+        return nullptr;
+    }
+
+    bool isNumber() const { return type == Number; }
+    bool isString() const { return type == String; }
+    bool isArray() const { return type == Array; }
+    bool isObject() const { return type == Object; }
+
+    double numberOr(const char* key, double fallback) const
+    {
+        const JsonValue* v = find(key);
+        return (v && v->type == Number) ? v->number : fallback;
+    }
+
+    bool boolOr(const char* key, bool fallback) const
+    {
+        const JsonValue* v = find(key);
+        return (v && v->type == Bool) ? v->boolean : fallback;
+    }
+
+    const char* stringOr(const char* key, const char* fallback) const
+    {
+        const JsonValue* v = find(key);
+        return (v && v->type == String) ? v->str.c_str() : fallback;
+    }
+};
+
+class JsonReader
+{
+public:
+    explicit JsonReader(const char* text) : p_(text) {}
+
+    bool parse(JsonValue& out)
+    {
+        skipWs();
+        if (!parseValue(out, 0)) return false;
+        skipWs();
+        return *p_ == '\0';
+    }
+
+private:
+    static const int kMaxDepth = 32;
+    const char* p_;
+
+    void skipWs()
+    {
+        while (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\n') ++p_;
+    }
+
+    bool literal(const char* word)
+    {
+        size_t len = strlen(word);
+        if (strncmp(p_, word, len) != 0) return false;
+        p_ += len;
+        return true;
+    }
+
+    bool parseValue(JsonValue& out, int depth)
+    {
+        if (depth > kMaxDepth) return false;
+        switch (*p_)
+        {
+        case '{': return parseObject(out, depth);
+        case '[': return parseArray(out, depth);
+        case '"': out.type = JsonValue::String; return parseString(out.str);
+        case 't':
+            out.type = JsonValue::Bool;
+            out.boolean = true;
+            return literal("true");
+        case 'f':
+            out.type = JsonValue::Bool;
+            out.boolean = false;
+            return literal("false");
+        case 'n':
+            out.type = JsonValue::Null;
+            return literal("null");
+        default:
+            return parseNumber(out);
+        }
+    }
+
+    bool parseNumber(JsonValue& out)
+    {
+        char* end = nullptr;
+        double value = strtod(p_, &end);
+        if (end == p_) return false;
+        out.type = JsonValue::Number;
+        out.number = value;
+        p_ = end;
+        return true;
+    }
+
+    static void appendUtf8(std::string& s, unsigned long cp)
+    {
+        if (cp < 0x80)
+        {
+            s += static_cast<char>(cp);
+        }
+        else if (cp < 0x800)
+        {
+            s += static_cast<char>(0xC0 | (cp >> 6));
+            s += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            s += static_cast<char>(0xE0 | (cp >> 12));
+            s += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            s += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            s += static_cast<char>(0xF0 | (cp >> 18));
+            s += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            s += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            s += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool parseHex4(unsigned long& cp)
+    {
+        cp = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            char c = *p_++;
+            cp <<= 4;
+            if (c >= '0' && c <= '9') cp |= c - '0';
+            else if (c >= 'a' && c <= 'f') cp |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') cp |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    bool parseString(std::string& out)
+    {
+        ++p_; // opening quote
+        out.clear();
+        while (*p_ && *p_ != '"')
+        {
+            if (*p_ != '\\')
+            {
+                out += *p_++;
+                continue;
+            }
+            ++p_;
+            switch (*p_++)
+            {
+            case '"':  out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/'; break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u':
+            {
+                unsigned long cp = 0;
+                if (!parseHex4(cp)) return false;
+                // Unpaired surrogates have no UTF-8 form and become U+FFFD. An
+                // escape after a high surrogate that is not a low one is
+                // parsed again on its own.
+                if (cp >= 0xD800 && cp <= 0xDBFF && p_[0] == '\\' && p_[1] == 'u')
+                {
+                    const char* next = p_;
+                    p_ += 2;
+                    unsigned long low = 0;
+                    if (!parseHex4(low)) return false;
+                    if (low >= 0xDC00 && low <= 0xDFFF)
+                    {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    else
+                    {
+                        cp = 0xFFFD;
+                        p_ = next;
+                    }
+                }
+                else if (cp >= 0xD800 && cp <= 0xDFFF)
+                {
+                    cp = 0xFFFD;
+                }
+                appendUtf8(out, cp);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        if (*p_ != '"') return false;
+        ++p_;
+        return true;
+    }
+
+    bool parseArray(JsonValue& out, int depth)
+    {
+        ++p_;
+        out.type = JsonValue::Array;
+        skipWs();
+        if (*p_ == ']')
+        {
+            ++p_;
+            return true;
+        }
+        for (;;)
+        {
+            out.items.emplace_back();
+            skipWs();
+            if (!parseValue(out.items.back(), depth + 1)) return false;
+            skipWs();
+            if (*p_ == ',')
+            {
+                ++p_;
+                continue;
+            }
+            if (*p_ == ']')
+            {
+                ++p_;
+                return true;
+            }
+            return false;
+        }
+    }
+
+    bool parseObject(JsonValue& out, int depth)
+    {
+        ++p_;
+        out.type = JsonValue::Object;
+        skipWs();
+        if (*p_ == '}')
+        {
+            ++p_;
+            return true;
+        }
+        for (;;)
+        {
+            skipWs();
+            if (*p_ != '"') return false;
+            std::string key;
+            if (!parseString(key)) return false;
+            skipWs();
+            if (*p_ != ':') return false;
+            ++p_;
+            skipWs();
+            out.members.emplace_back(std::move(key), JsonValue());
+            if (!parseValue(out.members.back().second, depth + 1)) return false;
+            skipWs();
+            if (*p_ == ',')
+            {
+                ++p_;
+                continue;
+            }
+            if (*p_ == '}')
+            {
+                ++p_;
+                return true;
+            }
+            return false;
+        }
+    }
+};
@@ -0,0 +1,175 @@
+// json_writer.h - Minimal JSON writer for the helpers' response lines.
+// Header-only, the counterpart of json_reader.h.
+//
+// Appends straight into one std::string the caller reserves (and may reuse
+// across responses), so formatting a response costs no per-field strings.
+// Wide strings from the W APIs are converted to UTF-8 while escaping, in one
+// pass; unpaired surrogates become U+FFFD. Escaping follows RFC 8259: quote,
+// backslash and every control character below 0x20 (\b \f \n \r \t, the rest
+// as \u00XX), so JSON.parse on the other side never fails on a window title.
+// Commas are the caller's: fields come as key() + value, or as raw fragments.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::string& out, size_t reserve = 512) : out_(out)
+    {
+        if (out_.capacity() < out_.size() + reserve) out_.reserve(out_.size() + reserve);
+    }
+
+    JsonWriter& raw(const char* text)
+    {
+        out_ += text;
+        return *this;
+    }
+
+    JsonWriter& raw(const std::string& text)
+    {
+        out_ += text;
+        return *this;
+    }
+
+    JsonWriter& raw(char c)
+    {
+        out_ += c;
+        return *this;
+    }
+
+    // "name": — name is a literal and is not escaped.
+    JsonWriter& key(const char* name)
+    {
+        out_ += '"';
+        out_ += name;
+        out_ += "\":";
+        return *this;
+    }
+
+    // Quoted UTF-8 string.
+    JsonWriter& string(const char* utf8)
+    {
+        return string(utf8, strlen(utf8));
+    }
+
+    JsonWriter& string(const std::string& utf8)
+    {
+        return string(utf8.data(), utf8.size());
+    }
+
+    JsonWriter& string(const char* utf8, size_t length)
+    {
+        out_ += '"';
+        for (size_t i = 0; i < length; ++i)
+        {
+            const unsigned char c = static_cast<unsigned char>(utf8[i]);
+            if (c < 0x20 || c == '"' || c == '\\') escape(c);
+            else out_ += static_cast<char>(c);
+        }
+        out_ += '"';
+        return *this;
+    }
+
+    // Quoted UTF-16 string (length in code units), converted to UTF-8.
+    JsonWriter& string(const wchar_t* text, size_t length)
+    {
+        out_ += '"';
+        appendUtf8(out_, text, length, true);
+        out_ += '"';
+        return *this;
+    }
+
+    JsonWriter& number(long long value)
+    {
+        char digits[24];
+        snprintf(digits, sizeof(digits), "%lld", value);
+        out_ += digits;
+        return *this;
+    }
+
+    // Up to 4 significant digits, enough for scale factors.
+    JsonWriter& number(double value)
+    {
+        char digits[32];
+        snprintf(digits, sizeof(digits), "%.4g", value);
+        out_ += digits;
+        return *this;
+    }
+
+    JsonWriter& boolean(bool value)
+    {
+        out_ += value ? "true" : "false";
+        return *this;
+    }
+
+    // UTF-16 to UTF-8, optionally JSON-escaped; used directly for strings the
+    // helpers keep (process names) so they are converted once.
+    static void appendUtf8(std::string& out, const wchar_t* text, size_t length, bool escaped = false)
+    {
+        for (size_t i = 0; i < length; ++i)
+        {
+            uint32_t cp = static_cast<uint16_t>(text[i]);
+            if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < length)
+            {
+                const uint32_t low = static_cast<uint16_t>(text[i + 1]);
+                if (low >= 0xDC00 && low <= 0xDFFF)
+                {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+            if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;
+
+            if (cp < 0x80)
+            {
+                if (escaped && (cp < 0x20 || cp == '"' || cp == '\\')) escapeInto(out, static_cast<unsigned char>(cp));
+                else out += static_cast<char>(cp);
+            }
+            else if (cp < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (cp >> 18));
+                out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+    }
+
+private:
+    void escape(unsigned char c) { escapeInto(out_, c); }
+
+    static void escapeInto(std::string& out, unsigned char c)
+    {
+        switch (c)
+        {
+        case '"':  out += "\\\""; return;
+        case '\\': out += "\\\\"; return;
+        case '\b': out += "\\b"; return;
+        case '\f': out += "\\f"; return;
+        case '\n': out += "\\n"; return;
+        case '\r': out += "\\r"; return;
+        case '\t': out += "\\t"; return;
+        }
+        static const char hex[] = "0123456789abcdef";
+        char unicode[7] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF], '\0'};
+        out += unicode;
+    }
+
+    std::string& out_;
+};
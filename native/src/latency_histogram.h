@@ -0,0 +1,109 @@
+// latency_histogram.h - Lock-free log2 latency histogram on QPC ticks.
+//
+// One writer thread records, any thread may snapshot. Bucket i counts samples
+// in [2^(i-1), 2^i) microseconds (bucket 0 = under 1 us), which is coarse but
+// enough to tell a 20 us hook from one that approaches LowLevelHooksTimeout.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+static inline int64_t qpcNow()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+static inline int64_t qpcFrequency()
+{
+    static const int64_t frequency = [] {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return f.QuadPart;
+    }();
+    return frequency;
+}
+
+static inline uint64_t qpcToMicros(int64_t ticks)
+{
+    return ticks <= 0 ? 0 : static_cast<uint64_t>(ticks) * 1000000ull / static_cast<uint64_t>(qpcFrequency());
+}
+
+class LatencyHistogram
+{
+public:
+    static const int kBuckets = 24; // last bucket: >= 2^22 us (~4 s)
+
+    void record(uint64_t micros)
+    {
+        int bucket = 0;
+        while (bucket < kBuckets - 1 && micros >= (1ull << bucket)) ++bucket;
+        buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+        totalMicros_.fetch_add(micros, std::memory_order_relaxed);
+        uint64_t max = maxMicros_.load(std::memory_order_relaxed);
+        while (micros > max && !maxMicros_.compare_exchange_weak(max, micros, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void recordTicks(int64_t start, int64_t end) { record(qpcToMicros(end - start)); }
+
+    // Not atomic as a whole; call while nothing is recording.
+    void reset()
+    {
+        for (auto& bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+        totalMicros_.store(0, std::memory_order_relaxed);
+        maxMicros_.store(0, std::memory_order_relaxed);
+    }
+
+    // {"count":N,"meanUs":..,"maxUs":..,"p50Us":..,"p99Us":..,"buckets":[...]}
+    // Percentiles are bucket upper bounds.
+    std::string toJson() const
+    {
+        uint64_t counts[kBuckets];
+        uint64_t total = 0;
+        for (int i = 0; i < kBuckets; ++i)
+        {
+            counts[i] = buckets_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        const uint64_t sum = totalMicros_.load(std::memory_order_relaxed);
+
+        std::string out = "{\"count\":" + std::to_string(total);
+        out += ",\"meanUs\":" + std::to_string(total ? sum / total : 0);
+        out += ",\"maxUs\":" + std::to_string(maxMicros_.load(std::memory_order_relaxed));
+        out += ",\"p50Us\":" + std::to_string(percentile(counts, total, 50));
+        out += ",\"p99Us\":" + std::to_string(percentile(counts, total, 99));
+        out += ",\"buckets\":[";
+        for (int i = 0; i < kBuckets; ++i)
+        {
+            if (i) out += ',';
+            out += std::to_string(counts[i]);
+        }
+        out += "]}";
+        return out;
+    }
+
+private:
+    std::atomic<uint64_t> buckets_[kBuckets] = {};
+    std::atomic<uint64_t> totalMicros_{0};
+    std::atomic<uint64_t> maxMicros_{0};
+
+    static uint64_t percentile(const uint64_t* counts, uint64_t total, int pct)
+    {
+        if (!total) return 0;
+        const uint64_t target = (total * pct + 99) / 100;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; ++i)
+        {
+            seen += counts[i];
+            if (seen >= target) return 1ull << i;
+        }
+        return 1ull << (kBuckets - 1);
+    }
+};
@@ -0,0 +1,157 @@
+// monitor_dpi.h - DPI awareness and per-monitor scale for the Windows helpers.
+//
+// The helpers run per-monitor DPI aware (v2 where the OS has it), so window
+// rects, hook points, PrintWindow and DXGI captures are all physical pixels on
+// every monitor. An unaware helper would see rects virtualized to 96 DPI on
+// scaled monitors while DWM and Desktop Duplication report physical ones.
+// Electron works in DIPs: here dip = physical / scale of the monitor the rect
+// or point is on, the mapping main.ts used to apply by hand. It is exact on
+// the primary monitor and matches Electron elsewhere as long as monitors of
+// different scales do not have to be shifted to stay adjacent.
+// Newer APIs are resolved at run time; the fallbacks are system DPI awareness
+// and the system DPI.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <string>
+
+namespace monitordpi
+{
+
+typedef BOOL(WINAPI* SetProcessDpiAwarenessContextFn)(HANDLE);
+typedef HRESULT(WINAPI* SetProcessDpiAwarenessFn)(int);
+typedef HRESULT(WINAPI* GetDpiForMonitorFn)(HMONITOR, int, UINT*, UINT*);
+
+// DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE(_V2), PROCESS_PER_MONITOR_DPI_AWARE
+// and MDT_EFFECTIVE_DPI; older SDKs do not declare them.
+static const HANDLE kPerMonitorAwareV2 = reinterpret_cast<HANDLE>(static_cast<INT_PTR>(-4));
+static const HANDLE kPerMonitorAware = reinterpret_cast<HANDLE>(static_cast<INT_PTR>(-3));
+static const int kProcessPerMonitorAware = 2;
+static const int kEffectiveDpi = 0;
+
+inline GetDpiForMonitorFn loadGetDpiForMonitor()
+{
+    HMODULE shcore = LoadLibraryA("shcore.dll");
+    return shcore ? reinterpret_cast<GetDpiForMonitorFn>(GetProcAddress(shcore, "GetDpiForMonitor")) : nullptr;
+}
+
+} // namespace monitordpi
+
+// Call from main before any window is queried. A manifest setting or an
+// earlier call wins; later calls fail harmlessly.
+static void enablePerMonitorDpiAwareness()
+{
+    using namespace monitordpi;
+    HMODULE user32 = GetModuleHandleA("user32.dll");
+    SetProcessDpiAwarenessContextFn setContext = reinterpret_cast<SetProcessDpiAwarenessContextFn>(
+        user32 ? GetProcAddress(user32, "SetProcessDpiAwarenessContext") : nullptr);
+    if (setContext && (setContext(kPerMonitorAwareV2) || setContext(kPerMonitorAware))) return;
+
+    HMODULE shcore = LoadLibraryA("shcore.dll");
+    SetProcessDpiAwarenessFn setAwareness = reinterpret_cast<SetProcessDpiAwarenessFn>(
+        shcore ? GetProcAddress(shcore, "SetProcessDpiAwareness") : nullptr);
+    if (setAwareness && SUCCEEDED(setAwareness(kProcessPerMonitorAware))) return;
+
+    SetProcessDPIAware();
+}
+
+// Effective DPI of a monitor (96 = 100%).
+static UINT monitorDpi(HMONITOR monitor)
+{
+    static const monitordpi::GetDpiForMonitorFn getDpi = monitordpi::loadGetDpiForMonitor();
+    UINT dpiX = 0, dpiY = 0;
+    if (getDpi && monitor && SUCCEEDED(getDpi(monitor, monitordpi::kEffectiveDpi, &dpiX, &dpiY)) && dpiX)
+    {
+        return dpiX;
+    }
+    HDC screen = GetDC(NULL);
+    const int dpi = screen ? GetDeviceCaps(screen, LOGPIXELSX) : 0;
+    if (screen) ReleaseDC(NULL, screen);
+    return dpi > 0 ? static_cast<UINT>(dpi) : USER_DEFAULT_SCREEN_DPI;
+}
+
+struct MonitorFields
+{
+    std::string id; // GDI device name, e.g. \\.\DISPLAY1
+    RECT bounds = {}; // physical
+    UINT dpi = USER_DEFAULT_SCREEN_DPI;
+    double scale = 1.0;
+};
+
+static MonitorFields readMonitorFields(HMONITOR monitor)
+{
+    MonitorFields fields;
+    MONITORINFOEXA info = {};
+    info.cbSize = sizeof(info);
+    if (monitor && GetMonitorInfoA(monitor, &info))
+    {
+        fields.id = info.szDevice;
+        fields.bounds = info.rcMonitor;
+    }
+    fields.dpi = monitorDpi(monitor);
+    fields.scale = static_cast<double>(fields.dpi) / USER_DEFAULT_SCREEN_DPI;
+    return fields;
+}
+
+static LONG roundCoordinate(double value)
+{
+    return static_cast<LONG>(value < 0 ? value - 0.5 : value + 0.5);
+}
+
+static LONG scaleCoordinate(LONG value, double factor)
+{
+    return roundCoordinate(value * factor);
+}
+
+// Physical rect to DIPs at a monitor's scale, rounding each field the way
+// main.ts did (Math.round of x, y, width and height separately).
+static RECT physicalToDip(const RECT& rect, double scale)
+{
+    RECT dip;
+    dip.left = scaleCoordinate(rect.left, 1.0 / scale);
+    dip.top = scaleCoordinate(rect.top, 1.0 / scale);
+    dip.right = dip.left + scaleCoordinate(rect.right - rect.left, 1.0 / scale);
+    dip.bottom = dip.top + scaleCoordinate(rect.bottom - rect.top, 1.0 / scale);
+    return dip;
+}
+
+struct DipMonitorSearch
+{
+    double x;
+    double y;
+    double scale;
+    bool found;
+};
+
+static BOOL CALLBACK findDipMonitor(HMONITOR monitor, HDC, LPRECT rect, LPARAM param)
+{
+    DipMonitorSearch* search = reinterpret_cast<DipMonitorSearch*>(param);
+    const double scale = static_cast<double>(monitorDpi(monitor)) / USER_DEFAULT_SCREEN_DPI;
+    const RECT dip = physicalToDip(*rect, scale);
+    if (search->x < dip.left || search->x >= dip.right || search->y < dip.top || search->y >= dip.bottom)
+    {
+        return TRUE;
+    }
+    search->scale = scale;
+    search->found = true;
+    return FALSE;
+}
+
+// DIP point (fractional, as Electron reports it) to physical, using the scale
+// of the monitor whose DIP rect holds it; points off every monitor use the
+// monitor nearest to them.
+static POINT dipToPhysical(double x, double y)
+{
+    DipMonitorSearch search = {x, y, 1.0, false};
+    EnumDisplayMonitors(NULL, NULL, findDipMonitor, reinterpret_cast<LPARAM>(&search));
+    if (!search.found)
+    {
+        POINT nearest = {roundCoordinate(x), roundCoordinate(y)};
+        search.scale = static_cast<double>(monitorDpi(MonitorFromPoint(nearest, MONITOR_DEFAULTTONEAREST))) /
+                       USER_DEFAULT_SCREEN_DPI;
+    }
+    POINT physical = {roundCoordinate(x * search.scale), roundCoordinate(y * search.scale)};
+    return physical;
+}
@@ -0,0 +1,792 @@
+// mouse_block_tool.h - Low-level mouse hook that blocks Ctrl+Right-click.
+// Runs as mouse_block.exe (mouse_block.cpp) or as a stella_native_host
+// channel; runMouseBlock is the entry point either way.
+// Usage: mouse_block.exe [--emit-window] [--exclude-pids=1,2,3] [--move-interval=ms]
+// Output: READY, then "DOWN x y <rule> <button> <mods>" / "UP ..." for each
+// button press matched by the rule table (gesture_rules.h), e.g.
+// "DOWN 100 200 radial right ctrl". The default table is Ctrl+Right-click,
+// blocked; "RULES [...]" on stdin replaces it. Modifiers come from a
+// WH_KEYBOARD_LL hook rather than GetAsyncKeyState per click.
+// While a button matched by an emitMove rule is held, "MOVE x y" lines
+// stream the cursor, coalesced to one per --move-interval (default: the
+// display refresh period).
+// --emit-window resolves the window under each DOWN point on a worker thread
+// (never in the hook) and prints it right after the DOWN line, saving a
+// window_info.exe round trip:
+//   WINDOW {"x":100,"y":200,"title":"...","process":"...","pid":123,"bounds":{...}}
+//   WINDOW {"x":100,"y":200,"error":"no window at point"}
+// The hook only queues events; a writer thread prints them, plus
+// "DROPPED <total>" whenever the queue overflowed since the last report.
+// Writing "STATS" to stdin answers "STATS {json}" with QPC histograms of
+// time spent in the hook and hook-to-pipe latency, drop counts and how
+// often the watchdog had to reinstall a hook Windows silently removed.
+// Binary framing: READY is "READY 2 binary" (protocol version, optional
+// formats). A client that writes "FORMAT binary" gets a "FORMAT binary" text
+// line back; everything after it is 24-byte little-endian records:
+//   u8 type (1 DOWN, 2 UP, 3 MOVE, 4 TEXT), u8 button, u8 mods, u8 rule,
+//   i32 x, i32 y, u32 length, u64 microseconds since the helper started.
+// rule is the rule's index in the last RULES array (0 for the default
+// table). TEXT records are followed by length bytes of a UTF-8 line without
+// its newline and carry everything else (WINDOW, STATS, RULES, DROPPED, EXIT).
+// Closing stdin stops the hook and ends with EXIT. If the writer thread or a
+// hook cannot be started, "ERROR <writer|hook> <win32 error>" is printed in
+// place of READY and the run ends.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "event_ring.h"
+#include "gesture_rules.h"
+#include "latency_histogram.h"
+#include "tool_context.h"
+#include "window_query.h"
+
+static HHOOK g_hook = nullptr;
+static HHOOK g_keyboardHook = nullptr;
+static volatile bool g_running = true;
+static DWORD g_hookThreadId = 0;
+
+// Streams of the current run; only one mouse_block runs per process.
+static ToolContext g_mouseIo;
+
+// Active rule table. Replaced wholesale by the RULES command; retired tables
+// are kept alive because the hook may still be reading one, and freed when
+// the run ends.
+static RuleTable g_defaultRules;
+static std::atomic<const RuleTable*> g_rules{&g_defaultRules};
+static std::vector<RuleTable*> g_retiredRules; // command thread, then the run's end
+
+// Modifier state from WH_KEYBOARD_LL, so button presses need no
+// GetAsyncKeyState call. Left/right keys are tracked separately.
+static unsigned char g_modifierKeys = 0; // bit per VK_L*/VK_R* key
+static unsigned char g_modifiers = 0;    // ModifierBits
+
+// One blocking session per button: from a matched DOWN to its UP.
+struct ButtonSession
+{
+    bool active;
+    unsigned char mods;
+    GestureRule rule;
+};
+static ButtonSession g_sessions[ButtonCount] = {};
+
+// MOVE streaming for sessions whose rule has emitMove. The hook only
+// overwrites the latest position; the writer samples it at most once per
+// interval (default: one display refresh), so fast mice cannot flood the pipe.
+static int g_moveSessions = 0;                 // hook thread only
+static std::atomic<bool> g_moveActive{false};  // g_moveSessions > 0, for the writer
+static std::atomic<uint64_t> g_latestMove{0};  // x << 32 | y
+static std::atomic<uint32_t> g_moveSeq{0};
+static std::atomic<bool> g_moveWaiting{false}; // writer sleeps until the next move
+static DWORD g_moveIntervalMs = 16;
+
+// The hook never touches stdout: a pipe write blocks when Electron is slow
+// to read, and a hook that overruns LowLevelHooksTimeout is silently
+// removed by Windows. Events go through this ring to the writer thread.
+enum HookEventType : unsigned char
+{
+    HookEventDown,
+    HookEventUp,
+};
+
+struct HookEvent
+{
+    HookEventType type;
+    unsigned char button; // MouseButton
+    unsigned char mods;   // ModifierBits held at DOWN
+    LONG x;
+    LONG y;
+    int64_t queuedAt; // QPC ticks
+    char rule[16];    // GestureRule::id
+    unsigned char ruleIndex; // GestureRule::index
+};
+
+static SpscRing<HookEvent, 256> g_events;
+static std::atomic<unsigned long> g_droppedEvents{0};
+static HANDLE g_eventsReady = nullptr; // auto-reset, signalled by the hook
+static volatile bool g_writerRunning = true;
+
+// Diagnostics reported by the STATS command.
+static LatencyHistogram g_callbackLatency; // time inside LowLevelMouseProc
+static LatencyHistogram g_deliveryLatency; // queued in the hook -> flushed to the pipe
+static std::atomic<unsigned long> g_hookCalls{0};
+static std::atomic<unsigned long> g_rehooks{0};
+static const UINT WATCHDOG_INTERVAL_MS = 2000;
+
+// --emit-window worker; the writer posts each DOWN point to it.
+static const UINT WM_RESOLVE_WINDOW = WM_APP + 1;
+static DWORD g_windowThreadId = 0;
+static std::vector<DWORD> g_excludedPids;
+
+// stdout is shared by the writer, window and command threads. The lock keeps
+// lines and records whole and makes the switch to binary framing atomic with
+// respect to every other write.
+enum WireType : uint8_t
+{
+    WireDown = 1,
+    WireUp = 2,
+    WireMove = 3,
+    WireText = 4,
+};
+
+#pragma pack(push, 1)
+struct WireRecord
+{
+    uint8_t type;   // WireType
+    uint8_t button; // MouseButton
+    uint8_t mods;   // ModifierBits
+    uint8_t rule;   // GestureRule::index
+    int32_t x;
+    int32_t y;
+    uint32_t length; // WireText payload bytes
+    uint64_t timeUs; // since g_startQpc
+};
+#pragma pack(pop)
+static_assert(sizeof(WireRecord) == 24, "WireRecord layout is part of the protocol");
+
+static const int PROTOCOL_VERSION = 2;
+static CRITICAL_SECTION g_outputLock;
+static bool g_binaryOutput = false; // guarded by g_outputLock
+static int64_t g_startQpc = 0;
+
+static uint64_t MicrosSinceStart(int64_t ticks)
+{
+    return qpcToMicros(ticks - g_startQpc);
+}
+
+static void WriteRecordLocked(const WireRecord& record)
+{
+    fwrite(&record, sizeof(record), 1, g_mouseIo.out);
+}
+
+// Writes one text line (no trailing newline) in the current framing.
+static void EmitLine(const std::string& line, bool flush = false)
+{
+    EnterCriticalSection(&g_outputLock);
+    if (g_binaryOutput)
+    {
+        WireRecord record = {};
+        record.type = WireText;
+        record.length = static_cast<uint32_t>(line.size());
+        record.timeUs = MicrosSinceStart(qpcNow());
+        WriteRecordLocked(record);
+        fwrite(line.data(), 1, line.size(), g_mouseIo.out);
+    }
+    else
+    {
+        fwrite(line.data(), 1, line.size(), g_mouseIo.out);
+        fputc('\n', g_mouseIo.out);
+    }
+    if (flush) fflush(g_mouseIo.out);
+    LeaveCriticalSection(&g_outputLock);
+}
+
+static void EmitButtonEvent(const HookEvent& event)
+{
+    EnterCriticalSection(&g_outputLock);
+    if (g_binaryOutput)
+    {
+        WireRecord record = {};
+        record.type = event.type == HookEventDown ? WireDown : WireUp;
+        record.button = event.button;
+        record.mods = event.mods;
+        record.rule = event.ruleIndex;
+        record.x = event.x;
+        record.y = event.y;
+        record.timeUs = MicrosSinceStart(event.queuedAt);
+        WriteRecordLocked(record);
+    }
+    else
+    {
+        fprintf(g_mouseIo.out, "%s %ld %ld %s %s %s\n", event.type == HookEventDown ? "DOWN" : "UP",
+                event.x, event.y, event.rule, mouseButtonName(event.button), modifierNames(event.mods).c_str());
+    }
+    LeaveCriticalSection(&g_outputLock);
+}
+
+static void EmitMove(LONG x, LONG y, int64_t sampledAt)
+{
+    EnterCriticalSection(&g_outputLock);
+    if (g_binaryOutput)
+    {
+        WireRecord record = {};
+        record.type = WireMove;
+        record.x = x;
+        record.y = y;
+        record.timeUs = MicrosSinceStart(sampledAt);
+        WriteRecordLocked(record);
+    }
+    else
+    {
+        fprintf(g_mouseIo.out, "MOVE %ld %ld\n", x, y);
+    }
+    LeaveCriticalSection(&g_outputLock);
+}
+
+static void FlushOutput()
+{
+    EnterCriticalSection(&g_outputLock);
+    fflush(g_mouseIo.out);
+    LeaveCriticalSection(&g_outputLock);
+}
+
+// The acknowledgement is the last text line; the lock guarantees no other
+// thread writes between it and the first record.
+static void SwitchToBinaryOutput()
+{
+    EnterCriticalSection(&g_outputLock);
+    if (!g_binaryOutput)
+    {
+        fputs("FORMAT binary\n", g_mouseIo.out);
+        g_binaryOutput = true;
+    }
+    fflush(g_mouseIo.out);
+    LeaveCriticalSection(&g_outputLock);
+}
+
+static void QueueHookEvent(HookEventType type, int button, const ButtonSession& session, POINT pt)
+{
+    HookEvent event;
+    event.type = type;
+    event.button = static_cast<unsigned char>(button);
+    event.mods = session.mods;
+    event.x = pt.x;
+    event.y = pt.y;
+    event.queuedAt = qpcNow();
+    memcpy(event.rule, session.rule.id, sizeof(event.rule));
+    event.ruleIndex = session.rule.index;
+    if (!g_events.push(event))
+    {
+        g_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+    }
+    SetEvent(g_eventsReady);
+}
+
+// Maps a mouse message to a MouseButton; -1 for moves, wheel, etc.
+static int ButtonFromMessage(WPARAM message, const MSLLHOOKSTRUCT* data, bool& down)
+{
+    switch (message)
+    {
+    case WM_LBUTTONDOWN: down = true;  return ButtonLeft;
+    case WM_LBUTTONUP:   down = false; return ButtonLeft;
+    case WM_RBUTTONDOWN: down = true;  return ButtonRight;
+    case WM_RBUTTONUP:   down = false; return ButtonRight;
+    case WM_MBUTTONDOWN: down = true;  return ButtonMiddle;
+    case WM_MBUTTONUP:   down = false; return ButtonMiddle;
+    case WM_XBUTTONDOWN:
+    case WM_XBUTTONUP:
+        down = message == WM_XBUTTONDOWN;
+        return HIWORD(data->mouseData) == XBUTTON1 ? ButtonX1 : ButtonX2;
+    default:
+        return -1;
+    }
+}
+
+static LRESULT HandleMouseEvent(int nCode, WPARAM wParam, LPARAM lParam)
+{
+    if (nCode == HC_ACTION)
+    {
+        MSLLHOOKSTRUCT* data = (MSLLHOOKSTRUCT*)lParam;
+        if (wParam == WM_MOUSEMOVE)
+        {
+            if (g_moveSessions)
+            {
+                g_latestMove.store((static_cast<uint64_t>(static_cast<uint32_t>(data->pt.x)) << 32) |
+                                       static_cast<uint32_t>(data->pt.y),
+                                   std::memory_order_relaxed);
+                g_moveSeq.fetch_add(1);
+                // The writer only sleeps untimed while the cursor is still.
+                if (g_moveWaiting.load() && g_moveWaiting.exchange(false)) SetEvent(g_eventsReady);
+            }
+            return CallNextHookEx(g_hook, nCode, wParam, lParam);
+        }
+
+        bool down = false;
+        const int button = ButtonFromMessage(wParam, data, down);
+        if (button >= 0)
+        {
+            ButtonSession& session = g_sessions[button];
+            if (down)
+            {
+                // Rules are matched against modifiers held at mousedown only
+                const RuleTable* rules = g_rules.load(std::memory_order_acquire);
+                const unsigned char slot = rules->slot[button][g_modifiers];
+                if (slot)
+                {
+                    // A session still active here lost its UP to a hook
+                    // timeout or rehook; this one replaces it, and its MOVE
+                    // stream must not be counted twice.
+                    const bool wasMoving = session.active && session.rule.emitMove;
+                    session.active = true; // Start blocking session
+                    session.mods = g_modifiers;
+                    session.rule = rules->rules[slot - 1];
+                    if (session.rule.emitMove != wasMoving)
+                    {
+                        g_moveSessions += session.rule.emitMove ? 1 : -1;
+                        g_moveActive.store(g_moveSessions > 0, std::memory_order_release);
+                    }
+                    QueueHookEvent(HookEventDown, button, session, data->pt);
+                    if (session.rule.block) return 1; // Block the event
+                }
+            }
+            else if (session.active)
+            {
+                // The session owns the matching up event even if the user
+                // released the modifiers (or the rules changed) before it
+                session.active = false; // End blocking session
+                if (session.rule.emitMove && g_moveSessions > 0)
+                {
+                    // Cleared before UP is queued, so no MOVE can follow it
+                    --g_moveSessions;
+                    g_moveActive.store(g_moveSessions > 0, std::memory_order_release);
+                }
+                QueueHookEvent(HookEventUp, button, session, data->pt);
+                if (session.rule.block) return 1; // Block the event
+            }
+        }
+    }
+    
+    return CallNextHookEx(g_hook, nCode, wParam, lParam);
+}
+
+static unsigned char ModifierKeyBit(DWORD vkCode)
+{
+    switch (vkCode)
+    {
+    case VK_LCONTROL: return 0x01;
+    case VK_RCONTROL: return 0x02;
+    case VK_LSHIFT:   return 0x04;
+    case VK_RSHIFT:   return 0x08;
+    case VK_LMENU:    return 0x10;
+    case VK_RMENU:    return 0x20;
+    case VK_LWIN:     return 0x40;
+    case VK_RWIN:     return 0x80;
+    default:          return 0;
+    }
+}
+
+static void UpdateModifiers()
+{
+    const unsigned char keys = g_modifierKeys;
+    g_modifiers = static_cast<unsigned char>(((keys & 0x03) ? ModCtrl : 0) | ((keys & 0x0C) ? ModShift : 0) |
+                                             ((keys & 0x30) ? ModAlt : 0) | ((keys & 0xC0) ? ModWin : 0));
+}
+
+// Re-reads modifier state; covers key-ups the hook never saw (secure
+// desktop, UAC, a hook Windows dropped).
+static void SyncModifiers()
+{
+    const int keys[] = {VK_LCONTROL, VK_RCONTROL, VK_LSHIFT, VK_RSHIFT, VK_LMENU, VK_RMENU, VK_LWIN, VK_RWIN};
+    unsigned char state = 0;
+    for (int vk : keys)
+    {
+        if (GetAsyncKeyState(vk) & 0x8000) state |= ModifierKeyBit(vk);
+    }
+    g_modifierKeys = state;
+    UpdateModifiers();
+}
+
+static LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam)
+{
+    if (nCode == HC_ACTION)
+    {
+        const KBDLLHOOKSTRUCT* data = (const KBDLLHOOKSTRUCT*)lParam;
+        const unsigned char bit = ModifierKeyBit(data->vkCode);
+        if (bit)
+        {
+            if (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) g_modifierKeys |= bit;
+            else g_modifierKeys &= static_cast<unsigned char>(~bit);
+            UpdateModifiers();
+        }
+    }
+    return CallNextHookEx(g_keyboardHook, nCode, wParam, lParam);
+}
+
+static LRESULT CALLBACK LowLevelMouseProc(int nCode, WPARAM wParam, LPARAM lParam)
+{
+    const int64_t start = qpcNow();
+    LRESULT result = HandleMouseEvent(nCode, wParam, lParam);
+    g_callbackLatency.recordTicks(start, qpcNow());
+    g_hookCalls.fetch_add(1, std::memory_order_relaxed);
+    return result;
+}
+
+// Windows removes a low-level hook that overruns LowLevelHooksTimeout without
+// telling us. If the cursor moved but the hook saw nothing since the last
+// tick, assume that happened and install it again.
+static void CALLBACK WatchdogProc(HWND, UINT, UINT_PTR, DWORD)
+{
+    static unsigned long lastCalls = 0;
+    static POINT lastPos = {};
+    POINT pos = {};
+    GetCursorPos(&pos);
+    const unsigned long calls = g_hookCalls.load(std::memory_order_relaxed);
+    const bool moved = pos.x != lastPos.x || pos.y != lastPos.y;
+    if (moved && calls == lastCalls && lastCalls != 0)
+    {
+        UnhookWindowsHookEx(g_hook);
+        g_hook = SetWindowsHookExW(WH_MOUSE_LL, LowLevelMouseProc, NULL, 0);
+        UnhookWindowsHookEx(g_keyboardHook);
+        g_keyboardHook = SetWindowsHookExW(WH_KEYBOARD_LL, LowLevelKeyboardProc, NULL, 0);
+        g_rehooks.fetch_add(1, std::memory_order_relaxed);
+    }
+    lastCalls = calls;
+    lastPos = pos;
+    SyncModifiers();
+}
+
+static std::string FormatStats()
+{
+    std::string out = "{\"callback\":" + g_callbackLatency.toJson();
+    out += ",\"delivery\":" + g_deliveryLatency.toJson();
+    out += ",\"hookCalls\":" + std::to_string(g_hookCalls.load(std::memory_order_relaxed));
+    out += ",\"dropped\":" + std::to_string(g_droppedEvents.load(std::memory_order_relaxed));
+    out += ",\"rehooks\":" + std::to_string(g_rehooks.load(std::memory_order_relaxed));
+    out += ",\"hooked\":";
+    out += g_hook ? "true" : "false";
+    out += "}";
+    return out;
+}
+
+static bool ReadCommandLine(std::string& line)
+{
+    line.clear();
+    char chunk[1024];
+    while (fgets(chunk, sizeof(chunk), g_mouseIo.in))
+    {
+        line += chunk;
+        if (!line.empty() && line.back() == '\n')
+        {
+            line.pop_back();
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            return true;
+        }
+    }
+    return !line.empty();
+}
+
+// Answers commands from Electron:
+//   STATS          -> "STATS {json}"
+//   RULES [json]   -> "RULES ok <count>" or "RULES error <reason>"
+//   FORMAT binary  -> "FORMAT binary", then binary records
+static DWORD WINAPI CommandThreadProc(LPVOID)
+{
+    std::string line;
+    while (ReadCommandLine(line))
+    {
+        if (line.compare(0, 5, "STATS") == 0)
+        {
+            EmitLine("STATS " + FormatStats(), true);
+        }
+        else if (line.compare(0, 6, "RULES ") == 0)
+        {
+            RuleTable* table = new RuleTable;
+            std::string error;
+            if (parseRules(line.c_str() + 6, *table, error))
+            {
+                const RuleTable* previous = g_rules.exchange(table, std::memory_order_acq_rel);
+                if (previous != &g_defaultRules) g_retiredRules.push_back(const_cast<RuleTable*>(previous));
+                EmitLine("RULES ok " + std::to_string(table->count), true);
+            }
+            else
+            {
+                delete table;
+                EmitLine("RULES error " + error, true);
+            }
+        }
+        else if (line == "FORMAT binary")
+        {
+            SwitchToBinaryOutput();
+        }
+    }
+    // Parent closed stdin (or the host closed the channel): shut down.
+    g_running = false;
+    PostThreadMessageW(g_hookThreadId, WM_QUIT, 0, 0);
+    return 0;
+}
+
+static BOOL WINAPI CtrlHandler(DWORD ctrlType)
+{
+    if (ctrlType == CTRL_C_EVENT || ctrlType == CTRL_CLOSE_EVENT ||
+        ctrlType == CTRL_BREAK_EVENT || ctrlType == CTRL_SHUTDOWN_EVENT)
+    {
+        g_running = false;
+        PostQuitMessage(0);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+// Drains the ring to stdout. Lines are batched and flushed once per wakeup.
+static DWORD WINAPI WriterThreadProc(LPVOID)
+{
+    unsigned long reportedDrops = 0;
+    uint32_t lastMoveSeq = 0;
+    int64_t lastMoveAt = 0;
+    const int64_t moveIntervalTicks = qpcFrequency() * g_moveIntervalMs / 1000;
+    for (;;)
+    {
+        DWORD timeout = INFINITE;
+        if (g_moveActive.load(std::memory_order_acquire))
+        {
+            // Cursor still since the last MOVE: sleep until the hook sees the
+            // next one. The flag is published before seq is checked again, so
+            // a move in between either shows up here or wakes the wait.
+            g_moveWaiting.store(true);
+            if (g_moveSeq.load() != lastMoveSeq)
+            {
+                g_moveWaiting.store(false);
+                // Wake for the next MOVE sample even if no button event arrives.
+                const int64_t remaining = lastMoveAt + moveIntervalTicks - qpcNow();
+                timeout = remaining <= 0 ? 0 : static_cast<DWORD>(qpcToMicros(remaining) / 1000) + 1;
+            }
+        }
+        WaitForSingleObject(g_eventsReady, timeout);
+        g_moveWaiting.store(false);
+        bool stopping = !g_writerRunning;
+
+        int64_t queuedAt[256];
+        size_t batch = 0;
+        HookEvent event;
+        while (g_events.pop(event))
+        {
+            if (batch < 256) queuedAt[batch++] = event.queuedAt;
+            EmitButtonEvent(event);
+            if (event.type == HookEventDown && g_windowThreadId)
+            {
+                // Posted after DOWN is written so WINDOW always follows it.
+                PostThreadMessageW(g_windowThreadId, WM_RESOLVE_WINDOW,
+                                   static_cast<WPARAM>(event.x), static_cast<LPARAM>(event.y));
+            }
+        }
+
+        if (g_moveActive.load(std::memory_order_acquire))
+        {
+            const int64_t now = qpcNow();
+            const uint32_t seq = g_moveSeq.load(std::memory_order_acquire);
+            if (seq != lastMoveSeq && now - lastMoveAt >= moveIntervalTicks)
+            {
+                const uint64_t packed = g_latestMove.load(std::memory_order_relaxed);
+                EmitMove(static_cast<int32_t>(packed >> 32), static_cast<int32_t>(packed & 0xFFFFFFFFu), now);
+                lastMoveSeq = seq;
+                lastMoveAt = now;
+            }
+        }
+
+        unsigned long drops = g_droppedEvents.load(std::memory_order_relaxed);
+        if (drops != reportedDrops)
+        {
+            EmitLine("DROPPED " + std::to_string(drops));
+            reportedDrops = drops;
+        }
+        FlushOutput();
+
+        const int64_t flushed = qpcNow();
+        for (size_t i = 0; i < batch; ++i)
+        {
+            g_deliveryLatency.recordTicks(queuedAt[i], flushed);
+        }
+
+        if (stopping) return 0;
+    }
+}
+
+static DWORD WINAPI WindowThreadProc(LPVOID readyEvent)
+{
+    // Create the message queue before the hook can post to it.
+    MSG msg;
+    PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+    SetEvent(static_cast<HANDLE>(readyEvent));
+
+    while (GetMessageW(&msg, nullptr, 0, 0) > 0)
+    {
+        if (msg.message != WM_RESOLVE_WINDOW) continue;
+
+        POINT pt;
+        pt.x = static_cast<LONG>(msg.wParam);
+        pt.y = static_cast<LONG>(msg.lParam);
+        HWND hwnd = resolveWindowAtPoint(pt, g_excludedPids, g_mouseIo.index);
+        std::string line = "WINDOW {\"x\":" + std::to_string(pt.x) + ",\"y\":" + std::to_string(pt.y) + ",";
+        line += hwnd ? formatWindowFields(hwnd) : "\"error\":\"no window at point\"";
+        line += "}";
+        EmitLine(line, true);
+    }
+    return 0;
+}
+
+static int runMouseBlock(int argc, char* argv[], const ToolContext& context)
+{
+    // Hosted, this may be a later run in the same process; start clean.
+    g_mouseIo = context;
+    g_running = true;
+    g_writerRunning = true;
+    g_binaryOutput = false;
+    g_hookThreadId = GetCurrentThreadId();
+    g_excludedPids.clear();
+    g_rules.store(&g_defaultRules, std::memory_order_release);
+    memset(g_sessions, 0, sizeof(g_sessions));
+    g_moveSessions = 0;
+    g_moveActive.store(false, std::memory_order_release);
+    g_moveWaiting.store(false);
+    g_droppedEvents.store(0, std::memory_order_relaxed);
+    g_hookCalls.store(0, std::memory_order_relaxed);
+    g_rehooks.store(0, std::memory_order_relaxed);
+    g_callbackLatency.reset();
+    g_deliveryLatency.reset();
+
+    // All output goes through g_outputLock; each thread flushes after a batch.
+    // Binary mode so records are not mangled by CRLF translation.
+    setvbuf(g_mouseIo.out, nullptr, _IOFBF, 4096);
+    _setmode(_fileno(g_mouseIo.out), _O_BINARY);
+    static bool outputLockReady = false;
+    if (!outputLockReady)
+    {
+        InitializeCriticalSection(&g_outputLock);
+        outputLockReady = true;
+    }
+    g_startQpc = qpcNow();
+    
+    if (!context.hosted) SetConsoleCtrlHandler(CtrlHandler, TRUE);
+
+    // Default MOVE interval: one refresh of the primary display.
+    DEVMODEW mode = {};
+    mode.dmSize = sizeof(mode);
+    if (EnumDisplaySettingsW(nullptr, ENUM_CURRENT_SETTINGS, &mode) && mode.dmDisplayFrequency > 1)
+    {
+        g_moveIntervalMs = 1000 / mode.dmDisplayFrequency;
+        if (g_moveIntervalMs < 1) g_moveIntervalMs = 1;
+    }
+
+    bool emitWindow = false;
+    const char* moveIntervalPrefix = "--move-interval=";
+    const size_t moveIntervalPrefixLen = strlen(moveIntervalPrefix);
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--emit-window") == 0) emitWindow = true;
+        if (strncmp(argv[i], moveIntervalPrefix, moveIntervalPrefixLen) == 0)
+        {
+            long ms = atol(argv[i] + moveIntervalPrefixLen);
+            if (ms > 0) g_moveIntervalMs = static_cast<DWORD>(ms);
+        }
+        parseExcludePidsArg(argv[i], g_excludedPids);
+    }
+
+    HANDLE windowThread = nullptr;
+    if (emitWindow)
+    {
+        HANDLE ready = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        DWORD threadId = 0;
+        windowThread = CreateThread(nullptr, 0, WindowThreadProc, ready, 0, &threadId);
+        if (windowThread)
+        {
+            WaitForSingleObject(ready, INFINITE);
+            g_windowThreadId = threadId;
+        }
+        CloseHandle(ready);
+    }
+    
+    g_eventsReady = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    HANDLE writerThread = g_eventsReady ? CreateThread(nullptr, 0, WriterThreadProc, nullptr, 0, nullptr) : nullptr;
+    const DWORD writerError = writerThread ? 0 : GetLastError();
+
+    // Hosted, a later run starts in this same process, so every exit path
+    // leaves no thread or event behind. The writer drains what is left first.
+    auto stopWorkerThreads = [&]() {
+        if (writerThread)
+        {
+            g_writerRunning = false;
+            SetEvent(g_eventsReady);
+            WaitForSingleObject(writerThread, 1000);
+            CloseHandle(writerThread);
+        }
+        if (g_eventsReady) CloseHandle(g_eventsReady);
+        g_eventsReady = nullptr;
+
+        if (windowThread)
+        {
+            PostThreadMessageW(g_windowThreadId, WM_QUIT, 0, 0);
+            WaitForSingleObject(windowThread, 1000);
+            CloseHandle(windowThread);
+            g_windowThreadId = 0;
+        }
+    };
+
+    if (!writerThread)
+    {
+        stopWorkerThreads();
+        EmitLine("ERROR writer " + std::to_string(writerError), true);
+        return 1;
+    }
+
+    setDefaultRules(g_defaultRules);
+    SyncModifiers();
+
+    // Use NULL for hMod since we're an exe, not a DLL
+    DWORD hookError = 0;
+    g_hook = SetWindowsHookExW(WH_MOUSE_LL, LowLevelMouseProc, NULL, 0);
+    if (!g_hook) hookError = GetLastError();
+    g_keyboardHook = SetWindowsHookExW(WH_KEYBOARD_LL, LowLevelKeyboardProc, NULL, 0);
+    if (!g_keyboardHook && !hookError) hookError = GetLastError();
+    if (!g_hook || !g_keyboardHook)
+    {
+        if (g_hook) UnhookWindowsHookEx(g_hook);
+        if (g_keyboardHook) UnhookWindowsHookEx(g_keyboardHook);
+        g_hook = nullptr;
+        g_keyboardHook = nullptr;
+        stopWorkerThreads();
+        EmitLine("ERROR hook " + std::to_string(hookError), true);
+        return 1;
+    }
+    
+    const UINT_PTR watchdogTimer = SetTimer(nullptr, 0, WATCHDOG_INTERVAL_MS, WatchdogProc);
+    HANDLE commandThread = CreateThread(nullptr, 0, CommandThreadProc, nullptr, 0, nullptr);
+
+    // Signal ready; the version and formats let clients opt into binary
+    EmitLine("READY " + std::to_string(PROTOCOL_VERSION) + " binary", true);
+    
+    // Message loop - required for low-level hooks
+    MSG msg;
+    while (g_running && GetMessageW(&msg, nullptr, 0, 0) > 0)
+    {
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+    }
+    
+    if (watchdogTimer) KillTimer(nullptr, watchdogTimer);
+    UnhookWindowsHookEx(g_hook);
+    g_hook = nullptr;
+    UnhookWindowsHookEx(g_keyboardHook);
+    g_keyboardHook = nullptr;
+
+    // The hooks are gone, so nothing reads a rule table any more. Hosted, the
+    // command thread ended the run and finishes right after; standalone it is
+    // still blocked on stdin and the process is about to exit anyway.
+    if (commandThread)
+    {
+        if (WaitForSingleObject(commandThread, context.hosted ? 1000 : 0) == WAIT_OBJECT_0)
+        {
+            const RuleTable* active = g_rules.exchange(&g_defaultRules, std::memory_order_acq_rel);
+            if (active != &g_defaultRules) delete active;
+            for (RuleTable* table : g_retiredRules) delete table;
+            g_retiredRules.clear();
+        }
+        CloseHandle(commandThread);
+    }
+
+    // Let the writer drain what is left before EXIT.
+    stopWorkerThreads();
+    EmitLine("EXIT", true);
+    
+    return 0;
+}
@@ -0,0 +1,456 @@
+// png_fast.h - Small, fast PNG encoder for screenshots that go to a model
+// rather than to archival storage. Header-only and free of Win32/GDI+ so the
+// capture hot path does not need GdiplusStartup.
+//
+// Output is 8-bit RGB (captures are opaque) with the Up filter. Two levels:
+//   PngStore - stored deflate blocks, no compression, memcpy speed
+//   PngFast  - greedy single-probe LZ77 with fixed Huffman codes; UI content
+//              (flat fills, repeated rows) still compresses well
+// GDI+ remains available in window_info.cpp when ratio matters more than time.
+//
+// Large images can be split into horizontal stripes that are filtered and
+// deflated on separate threads. Each stripe is an independent run of blocks
+// ending on a byte boundary (a sync flush), so the IDAT is their
+// concatenation and the Adler-32s are combined instead of recomputed.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+enum PngLevel
+{
+    PngStore = 0,
+    PngFast = 1,
+};
+
+namespace pngfast
+{
+
+struct CrcTable
+{
+    uint32_t entries[256];
+
+    CrcTable()
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+    }
+};
+
+inline const uint32_t* crcTable()
+{
+    static const CrcTable table;
+    return table.entries;
+}
+
+inline uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len)
+{
+    const uint32_t* table = crcTable();
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i)
+    {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline uint32_t adler32(uint32_t adler, const uint8_t* data, size_t len)
+{
+    // 5552 is the largest block for which the sums cannot overflow 32 bits.
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (len > 0)
+    {
+        size_t block = len < 5552 ? len : 5552;
+        len -= block;
+        while (block--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+// Adler-32 of A followed by B, from adler32(A), adler32(B) and B's length.
+inline uint32_t adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t lenB)
+{
+    const uint32_t kBase = 65521;
+    const uint32_t rem = static_cast<uint32_t>(lenB % kBase);
+    uint32_t sum1 = adlerA & 0xFFFF;
+    uint32_t sum2 = static_cast<uint32_t>((static_cast<uint64_t>(rem) * sum1) % kBase);
+    sum1 += (adlerB & 0xFFFF) + kBase - 1;
+    sum2 += (adlerA >> 16) + (adlerB >> 16) + kBase - rem;
+    if (sum1 >= kBase) sum1 -= kBase;
+    if (sum1 >= kBase) sum1 -= kBase;
+    if (sum2 >= kBase * 2) sum2 -= kBase * 2;
+    if (sum2 >= kBase) sum2 -= kBase;
+    return (sum2 << 16) | sum1;
+}
+
+// LSB-first bit packer as deflate requires.
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void put(uint32_t value, int count)
+    {
+        bits_ |= static_cast<uint64_t>(value) << count_;
+        count_ += count;
+        while (count_ >= 8)
+        {
+            out_.push_back(static_cast<uint8_t>(bits_));
+            bits_ >>= 8;
+            count_ -= 8;
+        }
+    }
+
+    void alignToByte()
+    {
+        if (count_ > 0) put(0, 8 - count_);
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t bits_ = 0;
+    int count_ = 0;
+};
+
+inline uint32_t reverseBits(uint32_t code, int len)
+{
+    uint32_t out = 0;
+    for (int i = 0; i < len; ++i)
+    {
+        out = (out << 1) | (code & 1);
+        code >>= 1;
+    }
+    return out;
+}
+
+struct FixedCodes
+{
+    uint16_t litCode[288];
+    uint8_t litLen[288];
+    uint16_t distCode[30];
+
+    FixedCodes()
+    {
+        // RFC 1951 3.2.6; codes are stored bit-reversed for the LSB-first writer.
+        for (int v = 0; v < 288; ++v)
+        {
+            uint32_t code;
+            int len;
+            if (v < 144)      { code = 0x30 + v;          len = 8; }
+            else if (v < 256) { code = 0x190 + (v - 144); len = 9; }
+            else if (v < 280) { code = v - 256;           len = 7; }
+            else              { code = 0xC0 + (v - 280);  len = 8; }
+            litCode[v] = static_cast<uint16_t>(reverseBits(code, len));
+            litLen[v] = static_cast<uint8_t>(len);
+        }
+        for (int d = 0; d < 30; ++d)
+        {
+            distCode[d] = static_cast<uint16_t>(reverseBits(d, 5));
+        }
+    }
+};
+
+inline const FixedCodes& fixedCodes()
+{
+    static const FixedCodes codes;
+    return codes;
+}
+
+static const uint16_t kLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t kLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t kDistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t kDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+inline void putLiteral(BitWriter& bw, const FixedCodes& fc, int value)
+{
+    bw.put(fc.litCode[value], fc.litLen[value]);
+}
+
+inline void putMatch(BitWriter& bw, const FixedCodes& fc, int length, int distance)
+{
+    int li = 28;
+    while (kLengthBase[li] > length) --li;
+    putLiteral(bw, fc, 257 + li);
+    if (kLengthExtra[li]) bw.put(length - kLengthBase[li], kLengthExtra[li]);
+
+    int di = 29;
+    while (kDistBase[di] > distance) --di;
+    bw.put(fc.distCode[di], 5);
+    if (kDistExtra[di]) bw.put(distance - kDistBase[di], kDistExtra[di]);
+}
+
+// Raw deflate (no zlib wrapper) of data as stored blocks.
+inline void deflateStore(const uint8_t* data, size_t len, bool final, BitWriter& bw, std::vector<uint8_t>& out)
+{
+    do
+    {
+        size_t block = len < 65535 ? len : 65535;
+        len -= block;
+        bw.put((final && len == 0) ? 1 : 0, 1);
+        bw.put(0, 2); // BTYPE=00 stored
+        bw.alignToByte();
+        out.push_back(static_cast<uint8_t>(block));
+        out.push_back(static_cast<uint8_t>(block >> 8));
+        out.push_back(static_cast<uint8_t>(~block));
+        out.push_back(static_cast<uint8_t>(~block >> 8));
+        out.insert(out.end(), data, data + block);
+        data += block;
+    } while (len > 0);
+}
+
+// Raw deflate of data as one fixed-Huffman block with greedy LZ77 matching.
+inline void deflateFast(const uint8_t* data, size_t len, bool final, BitWriter& bw)
+{
+    const FixedCodes& fc = fixedCodes();
+    const int kHashBits = 15;
+    const size_t kWindow = 32768;
+    const size_t kMaxMatch = 258;
+    const size_t kMinMatch = 4;
+
+    std::vector<uint32_t> head(static_cast<size_t>(1) << kHashBits, UINT32_MAX);
+
+    bw.put(final ? 1 : 0, 1);
+    bw.put(1, 2); // BTYPE=01 fixed Huffman
+
+    size_t i = 0;
+    while (i < len)
+    {
+        if (i + kMinMatch <= len)
+        {
+            uint32_t word;
+            memcpy(&word, data + i, 4);
+            uint32_t h = (word * 2654435761u) >> (32 - kHashBits);
+            uint32_t candidate = head[h];
+            head[h] = static_cast<uint32_t>(i);
+
+            if (candidate != UINT32_MAX && i - candidate <= kWindow &&
+                memcmp(data + candidate, data + i, kMinMatch) == 0)
+            {
+                size_t limit = len - i < kMaxMatch ? len - i : kMaxMatch;
+                size_t matchLen = kMinMatch;
+                while (matchLen < limit && data[candidate + matchLen] == data[i + matchLen]) ++matchLen;
+                putMatch(bw, fc, static_cast<int>(matchLen), static_cast<int>(i - candidate));
+                i += matchLen;
+                continue;
+            }
+        }
+        putLiteral(bw, fc, data[i]);
+        ++i;
+    }
+    putLiteral(bw, fc, 256); // end of block
+}
+
+// Ends a non-final run of blocks on a byte boundary with an empty stored
+// block, so the next stripe's blocks can be appended as whole bytes.
+inline void deflateSyncFlush(BitWriter& bw, std::vector<uint8_t>& out)
+{
+    bw.put(0, 1);
+    bw.put(0, 2); // BTYPE=00 stored
+    bw.alignToByte();
+    const uint8_t empty[4] = {0x00, 0x00, 0xFF, 0xFF};
+    out.insert(out.end(), empty, empty + 4);
+}
+
+inline void putBe32(std::vector<uint8_t>& out, uint32_t v)
+{
+    out.push_back(static_cast<uint8_t>(v >> 24));
+    out.push_back(static_cast<uint8_t>(v >> 16));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+inline void writeChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t len)
+{
+    putBe32(out, static_cast<uint32_t>(len));
+    size_t typeStart = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (len) out.insert(out.end(), data, data + len);
+    uint32_t crc = crc32(0, out.data() + typeStart, len + 4);
+    putBe32(out, crc);
+}
+
+// BGRA rows [y0, y1) -> PNG scanlines: one filter byte, then RGB with the Up
+// filter. Rows are written to out at their final offset, so stripes can
+// filter into one buffer in parallel.
+inline void filterRows(const uint8_t* bgra, int width, int y0, int y1, size_t stride, uint8_t* out)
+{
+    const size_t rowBytes = static_cast<size_t>(width) * 3 + 1;
+    for (int y = y0; y < y1; ++y)
+    {
+        const uint8_t* src = bgra + stride * y;
+        const uint8_t* prev = y > 0 ? src - stride : nullptr;
+        uint8_t* dst = out + rowBytes * y;
+        *dst++ = prev ? 2 : 0; // 2 = Up, 0 = None for the first row
+        if (prev)
+        {
+            for (int x = 0; x < width; ++x, src += 4, prev += 4)
+            {
+                *dst++ = static_cast<uint8_t>(src[2] - prev[2]);
+                *dst++ = static_cast<uint8_t>(src[1] - prev[1]);
+                *dst++ = static_cast<uint8_t>(src[0] - prev[0]);
+            }
+        }
+        else
+        {
+            for (int x = 0; x < width; ++x, src += 4)
+            {
+                *dst++ = src[2];
+                *dst++ = src[1];
+                *dst++ = src[0];
+            }
+        }
+    }
+}
+
+// Below this many scanline bytes per stripe, thread start-up and the matches
+// lost at stripe boundaries cost more than the parallelism saves.
+static const size_t kMinStripeBytes = 256 * 1024;
+
+struct Stripe
+{
+    int y0 = 0;
+    int y1 = 0;
+    std::vector<uint8_t> deflated;
+    uint32_t adler = 1;
+};
+
+inline void encodeStripe(const uint8_t* bgra, int width, size_t stride, PngLevel level, bool final,
+                         uint8_t* scanlines, Stripe& stripe)
+{
+    const size_t rowBytes = static_cast<size_t>(width) * 3 + 1;
+    filterRows(bgra, width, stripe.y0, stripe.y1, stride, scanlines);
+    const uint8_t* data = scanlines + rowBytes * stripe.y0;
+    const size_t len = rowBytes * (stripe.y1 - stripe.y0);
+
+    stripe.deflated.reserve(level == PngStore ? len + len / 65535 * 5 + 16 : len / 4);
+    BitWriter bw(stripe.deflated);
+    if (level == PngStore)
+    {
+        // Stored blocks already end byte-aligned.
+        deflateStore(data, len, final, bw, stripe.deflated);
+    }
+    else
+    {
+        deflateFast(data, len, final, bw);
+        if (!final) deflateSyncFlush(bw, stripe.deflated);
+    }
+    bw.alignToByte();
+    stripe.adler = adler32(1, data, len);
+}
+
+} // namespace pngfast
+
+// Encodes top-down BGRA pixels (alpha ignored) as an RGB PNG. threads > 1
+// splits large images into that many stripes encoded concurrently; small
+// images always take one stripe on the calling thread.
+inline bool encodePngFast(const uint8_t* bgra, int width, int height, size_t stride, PngLevel level,
+                          std::vector<uint8_t>& out, int threads = 1)
+{
+    using namespace pngfast;
+    if (width <= 0 || height <= 0) return false;
+
+    const size_t rowBytes = static_cast<size_t>(width) * 3 + 1;
+    std::vector<uint8_t> scanlines(rowBytes * height);
+
+    size_t count = threads > 1 ? static_cast<size_t>(threads) : 1;
+    if (count > scanlines.size() / kMinStripeBytes) count = scanlines.size() / kMinStripeBytes;
+    if (count > static_cast<size_t>(height)) count = height;
+    if (count < 1) count = 1;
+
+    std::vector<Stripe> stripes(count);
+    const int rowsPerStripe = static_cast<int>((height + count - 1) / count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        stripes[i].y0 = static_cast<int>(i) * rowsPerStripe;
+        stripes[i].y1 = stripes[i].y0 + rowsPerStripe < height ? stripes[i].y0 + rowsPerStripe : height;
+    }
+    // Rounding up can leave trailing stripes empty; drop them.
+    while (stripes.size() > 1 && stripes.back().y0 >= height) stripes.pop_back();
+
+    // Stripe 0 runs here; the rest get a thread each.
+    std::vector<std::thread> workers;
+    workers.reserve(stripes.size());
+    for (size_t i = 1; i < stripes.size(); ++i)
+    {
+        const bool final = i + 1 == stripes.size();
+        Stripe& stripe = stripes[i];
+        try
+        {
+            workers.emplace_back([=, &stripe, &scanlines]() {
+                encodeStripe(bgra, width, stride, level, final, scanlines.data(), stripe);
+            });
+        }
+        catch (...)
+        {
+            encodeStripe(bgra, width, stride, level, final, scanlines.data(), stripe);
+        }
+    }
+    encodeStripe(bgra, width, stride, level, stripes.size() == 1, scanlines.data(), stripes[0]);
+    for (std::thread& worker : workers) worker.join();
+
+    size_t deflatedSize = 0;
+    for (const Stripe& stripe : stripes) deflatedSize += stripe.deflated.size();
+
+    std::vector<uint8_t> idat;
+    idat.reserve(deflatedSize + 6);
+    idat.push_back(0x78); // zlib: deflate, 32K window
+    idat.push_back(0x01); // fastest, no dictionary
+    uint32_t adler = stripes[0].adler;
+    for (size_t i = 0; i < stripes.size(); ++i)
+    {
+        const Stripe& stripe = stripes[i];
+        idat.insert(idat.end(), stripe.deflated.begin(), stripe.deflated.end());
+        if (i) adler = adler32Combine(adler, stripe.adler, rowBytes * (stripe.y1 - stripe.y0));
+    }
+    putBe32(idat, adler);
+
+    static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    uint8_t ihdr[13];
+    ihdr[0] = static_cast<uint8_t>(width >> 24);
+    ihdr[1] = static_cast<uint8_t>(width >> 16);
+    ihdr[2] = static_cast<uint8_t>(width >> 8);
+    ihdr[3] = static_cast<uint8_t>(width);
+    ihdr[4] = static_cast<uint8_t>(height >> 24);
+    ihdr[5] = static_cast<uint8_t>(height >> 16);
+    ihdr[6] = static_cast<uint8_t>(height >> 8);
+    ihdr[7] = static_cast<uint8_t>(height);
+    ihdr[8] = 8;  // bit depth
+    ihdr[9] = 2;  // color type: RGB
+    ihdr[10] = 0; // deflate
+    ihdr[11] = 0; // adaptive filtering
+    ihdr[12] = 0; // no interlace
+
+    out.clear();
+    out.reserve(idat.size() + 64);
+    out.insert(out.end(), kSignature, kSignature + 8);
+    writeChunk(out, "IHDR", ihdr, sizeof(ihdr));
+    writeChunk(out, "IDAT", idat.data(), idat.size());
+    writeChunk(out, "IEND", nullptr, 0);
+    return true;
+}
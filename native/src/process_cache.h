@@ -0,0 +1,149 @@
+// process_cache.h - LRU cache of process exe names for window lookups.
+//
+// Resolving a name costs OpenProcess + QueryFullProcessImageName +
+// CloseHandle. Entries are keyed by pid plus process creation time, so a
+// recycled pid never inherits another process's name. Each entry also
+// remembers the windows it was resolved for, so repeated hovers over the
+// same app skip kernel handle operations entirely. Lookups are serialized,
+// since stella_native_host runs several tools that share one cache.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <list>
+#include <string>
+#include <vector>
+
+class ProcessNameCache
+{
+public:
+    explicit ProcessNameCache(size_t capacity = 64) : capacity_(capacity) {}
+
+    // Exe name (no directory, UTF-8) of the process owning hwnd. pid must be what
+    // GetWindowThreadProcessId(hwnd) just returned: window handles die with
+    // their process, so a known hwnd still reporting the same pid proves the
+    // process is the one cached. Empty if unknown.
+    std::string lookup(HWND hwnd, DWORD pid)
+    {
+        if (!pid) return std::string();
+        AcquireSRWLockExclusive(&lock_);
+        std::string name = lookupLocked(hwnd, pid);
+        ReleaseSRWLockExclusive(&lock_);
+        return name;
+    }
+
+private:
+    std::string lookupLocked(HWND hwnd, DWORD pid)
+    {
+
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            if (it->pid == pid && it->ownsWindow(hwnd))
+            {
+                entries_.splice(entries_.begin(), entries_, it);
+                return it->name;
+            }
+        }
+
+        HANDLE hProc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+        if (!hProc) return std::string();
+
+        ULONGLONG created = 0;
+        FILETIME creation, exitTime, kernel, user;
+        if (GetProcessTimes(hProc, &creation, &exitTime, &kernel, &user))
+        {
+            created = (static_cast<ULONGLONG>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+        }
+
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            if (it->pid == pid && it->created == created && created != 0)
+            {
+                CloseHandle(hProc);
+                it->addWindow(hwnd);
+                entries_.splice(entries_.begin(), entries_, it);
+                return it->name;
+            }
+        }
+
+        wchar_t processName[MAX_PATH] = {};
+        DWORD size = MAX_PATH;
+        BOOL named = QueryFullProcessImageNameW(hProc, 0, processName, &size);
+        CloseHandle(hProc);
+        if (!named) return std::string();
+
+        // Extract just the exe name from the full path, as UTF-8
+        const wchar_t* exeNameW = processName;
+        for (const wchar_t* p = processName; *p; ++p)
+        {
+            if (*p == L'\\' || *p == L'/')
+                exeNameW = p + 1;
+        }
+        const std::string exeName = toUtf8(exeNameW);
+
+        // Without a creation time the pid cannot be told apart from a
+        // recycled one, so do not cache it.
+        if (!created) return exeName;
+
+        // A recycled pid leaves a dead entry behind; drop it now.
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            if (it->pid == pid)
+            {
+                entries_.erase(it);
+                break;
+            }
+        }
+
+        Entry entry;
+        entry.pid = pid;
+        entry.created = created;
+        entry.name = exeName;
+        entry.addWindow(hwnd);
+        entries_.push_front(entry);
+        if (entries_.size() > capacity_) entries_.pop_back();
+        return entries_.front().name;
+    }
+
+    static std::string toUtf8(const wchar_t* text)
+    {
+        std::string out;
+        const int length = WideCharToMultiByte(CP_UTF8, 0, text, -1, NULL, 0, NULL, NULL);
+        if (length <= 1) return out;
+        out.resize(length - 1);
+        WideCharToMultiByte(CP_UTF8, 0, text, -1, &out[0], length, NULL, NULL);
+        return out;
+    }
+
+    struct Entry
+    {
+        DWORD pid = 0;
+        ULONGLONG created = 0;
+        std::string name;
+        std::vector<HWND> windows; // most recent last
+
+        bool ownsWindow(HWND hwnd) const
+        {
+            for (HWND known : windows)
+            {
+                if (known == hwnd) return true;
+            }
+            return false;
+        }
+
+        void addWindow(HWND hwnd)
+        {
+            for (HWND known : windows)
+            {
+                if (known == hwnd) return;
+            }
+            if (windows.size() >= 8) windows.erase(windows.begin());
+            windows.push_back(hwnd);
+        }
+    };
+
+    size_t capacity_;
+    SRWLOCK lock_ = SRWLOCK_INIT;
+    std::list<Entry> entries_; // most recently used first
+};
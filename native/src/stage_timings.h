@@ -0,0 +1,98 @@
+// stage_timings.h - Opt-in per-stage timings of one window_info request.
+//
+// --timings (or "timings":true in server mode) adds the microseconds the
+// helper spent in each stage to the response:
+//   "timings":{"resolveUs":..,"processUs":..,"captureUs":..,"encodeUs":..,"totalUs":..}
+// Stages that did not run are left out. "gdiplusUs" is GDI+ startup plus the
+// encoder CLSID lookup (0 once warm), "resolveUs" the z-order walk (or
+// snapshot lookup), "processUs" the process name lookup, "captureUs" the
+// backend named in "image", "saveUs" the screenshot file write, "uiaUs" the
+// UI Automation reads (uia_text.h). "totalUs" runs from the start of the
+// request (of the process, for one-shot CLI runs) to the response, so spawn
+// cost is the caller's wall time minus it.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "latency_histogram.h"
+
+struct StageTimings
+{
+    enum Stage
+    {
+        Gdiplus,
+        Resolve,
+        Process,
+        Capture,
+        Mask,
+        Downscale,
+        Diff,
+        Encode,
+        Save,
+        Uia,
+        StageCount
+    };
+
+    bool enabled = false;
+    int64_t start = 0; // QPC ticks
+    int64_t ticks[StageCount] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1}; // -1 = did not run
+
+    void begin()
+    {
+        enabled = true;
+        start = qpcNow();
+    }
+
+    // Adds end - begin to stage (a stage may run more than once).
+    void add(Stage stage, int64_t beginTicks, int64_t endTicks)
+    {
+        if (!enabled) return;
+        const int64_t spent = endTicks > beginTicks ? endTicks - beginTicks : 0;
+        ticks[stage] = ticks[stage] < 0 ? spent : ticks[stage] + spent;
+    }
+
+    // ,"timings":{...} with totalUs up to now, or nothing when disabled.
+    std::string toJson() const
+    {
+        if (!enabled) return std::string();
+        static const char* const names[StageCount] = {"gdiplusUs", "resolveUs", "processUs", "captureUs", "maskUs",
+                                                      "downscaleUs", "diffUs", "encodeUs", "saveUs", "uiaUs"};
+        std::string out = ",\"timings\":{";
+        char field[48];
+        for (int i = 0; i < StageCount; ++i)
+        {
+            if (ticks[i] < 0) continue;
+            snprintf(field, sizeof(field), "\"%s\":%llu,", names[i],
+                     static_cast<unsigned long long>(qpcToMicros(ticks[i])));
+            out += field;
+        }
+        snprintf(field, sizeof(field), "\"totalUs\":%llu}",
+                 static_cast<unsigned long long>(qpcToMicros(qpcNow() - start)));
+        out += field;
+        return out;
+    }
+};
+
+// Times one scope into a stage; a no-op unless timings are enabled.
+class StageTimer
+{
+public:
+    StageTimer(StageTimings& timings, StageTimings::Stage stage)
+        : timings_(timings), stage_(stage), begin_(timings.enabled ? qpcNow() : 0)
+    {
+    }
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+    ~StageTimer()
+    {
+        if (timings_.enabled) timings_.add(stage_, begin_, qpcNow());
+    }
+
+private:
+    StageTimings& timings_;
+    StageTimings::Stage stage_;
+    int64_t begin_;
+};
@@ -0,0 +1,417 @@
+// stella_native_host.exe - One resident process for the native helpers.
+// Runs mouse_block and window_info (--serve, --watch) as threads instead of
+// separate exes, so the window index, process name cache, GDI+ and the DXGI
+// capture session are created once and shared by every feature.
+//
+// Each tool keeps its own line protocol; the host only multiplexes the byte
+// streams over stdin/stdout as frames:
+//   u32 payload length (little-endian), u8 channel, payload
+// Channel 0 is control, one text line per frame:
+//   <- READY 1                              host protocol version, at startup
+//   -> OPEN <channel> <tool> [args...]      tool: mouse_block | window_info
+//   <- OPENED <channel> | ERROR <channel> <reason>
+//   -> CLOSE <channel>                      closes the tool's stdin
+//   <- CLOSED <channel> <exit code>         after its last output frame
+// Frames on other channels are the tool's stdin/stdout, as if it ran alone.
+// At most one instance of mouse_block, window_info --serve and
+// window_info --watch may be open at a time; one-shot window_info queries
+// stay with window_info.exe. Closing stdin closes every channel and exits.
+// Compile: cl /O2 /EHsc stella_native_host.cpp /link user32.lib gdi32.lib gdiplus.lib ole32.lib oleaut32.lib d3d11.lib dxgi.lib dwmapi.lib /OUT:stella_native_host.exe
+
+#include "mouse_block_tool.h"
+#include "window_info_tool.h"
+
+#include <fcntl.h>
+#include <io.h>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+static const int HOST_PROTOCOL_VERSION = 1;
+static const int MAX_CHANNELS = 256;
+static const uint32_t MAX_FRAME_BYTES = 16 * 1024 * 1024;
+
+typedef int (*ToolMain)(int argc, char* argv[], const ToolContext& context);
+
+struct Channel
+{
+    uint8_t id = 0;
+    std::string mode; // "mouse_block", "window_info --serve", ...
+    ToolMain run = nullptr;
+    std::vector<std::string> args; // argv, including the tool name
+    HANDLE inWrite = NULL;         // host end of the tool's stdin, owned by inputThread
+    HANDLE outRead = NULL;         // host end of the tool's stdout
+    FILE* in = nullptr;
+    FILE* out = nullptr;
+    HANDLE toolThread = NULL;
+
+    // Input frames waiting for inputThread to write them to inWrite.
+    HANDLE inputThread = NULL;
+    SRWLOCK inputLock = SRWLOCK_INIT;
+    CONDITION_VARIABLE inputReady = CONDITION_VARIABLE_INIT;
+    std::deque<std::vector<char>> input; // guarded by inputLock
+    bool inputClosed = false;            // guarded by inputLock; set by CLOSE
+};
+
+static CRITICAL_SECTION g_frameLock;   // serializes frames on stdout
+static CRITICAL_SECTION g_channelLock; // guards g_channels
+static Channel* g_channels[MAX_CHANNELS] = {};
+static ToolContext g_sharedContext = {};
+
+static void writeFrame(uint8_t channel, const void* data, uint32_t length)
+{
+    uint8_t header[5];
+    memcpy(header, &length, 4);
+    header[4] = channel;
+    EnterCriticalSection(&g_frameLock);
+    fwrite(header, 1, sizeof(header), stdout);
+    if (length) fwrite(data, 1, length, stdout);
+    fflush(stdout);
+    LeaveCriticalSection(&g_frameLock);
+}
+
+static void writeControl(const std::string& line)
+{
+    writeFrame(0, line.data(), static_cast<uint32_t>(line.size()));
+}
+
+static bool readExact(void* buffer, size_t length)
+{
+    return fread(buffer, 1, length, stdin) == length;
+}
+
+static DWORD WINAPI toolThreadProc(LPVOID param)
+{
+    Channel* channel = static_cast<Channel*>(param);
+    std::vector<char*> argv;
+    for (std::string& arg : channel->args) argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    ToolContext context = g_sharedContext;
+    context.in = channel->in;
+    context.out = channel->out;
+    const int code = channel->run(static_cast<int>(channel->args.size()), argv.data(), context);
+
+    // EOF on the pump side; stdin is closed by CLOSE or host shutdown.
+    fclose(channel->out);
+    channel->out = nullptr;
+    return static_cast<DWORD>(code);
+}
+
+// No more input for the channel; its stdin closes once the queue is written.
+static void stopChannelInput(Channel* channel)
+{
+    AcquireSRWLockExclusive(&channel->inputLock);
+    channel->inputClosed = true;
+    ReleaseSRWLockExclusive(&channel->inputLock);
+    WakeConditionVariable(&channel->inputReady);
+}
+
+// Writes queued input to the tool's stdin. Each channel has its own, so a
+// tool that stops reading (a window_info server inside a slow UIA or
+// PrintWindow call) backs up only its own queue, never the host's stdin
+// reader or the other channels. Closing stdin is the tool's shutdown
+// signal, so that happens here too, after the last queued frame.
+static DWORD WINAPI inputThreadProc(LPVOID param)
+{
+    Channel* channel = static_cast<Channel*>(param);
+    std::vector<char> data;
+    for (;;)
+    {
+        AcquireSRWLockExclusive(&channel->inputLock);
+        while (channel->input.empty() && !channel->inputClosed)
+        {
+            SleepConditionVariableSRW(&channel->inputReady, &channel->inputLock, INFINITE, 0);
+        }
+        const bool done = channel->input.empty();
+        if (!done)
+        {
+            data.swap(channel->input.front());
+            channel->input.pop_front();
+        }
+        ReleaseSRWLockExclusive(&channel->inputLock);
+        if (done) break;
+
+        DWORD written = 0;
+        if (!WriteFile(channel->inWrite, data.data(), static_cast<DWORD>(data.size()), &written, NULL)) break;
+    }
+    CloseHandle(channel->inWrite);
+    channel->inWrite = NULL;
+    return 0;
+}
+
+// Forwards tool output as frames until the tool closes its stdout, then
+// reports CLOSED and frees the channel.
+static DWORD WINAPI pumpThreadProc(LPVOID param)
+{
+    Channel* channel = static_cast<Channel*>(param);
+    char buffer[64 * 1024];
+    DWORD read = 0;
+    while (ReadFile(channel->outRead, buffer, sizeof(buffer), &read, NULL) && read)
+    {
+        writeFrame(channel->id, buffer, read);
+    }
+
+    WaitForSingleObject(channel->toolThread, INFINITE);
+    DWORD code = 1;
+    GetExitCodeThread(channel->toolThread, &code);
+
+    EnterCriticalSection(&g_channelLock);
+    g_channels[channel->id] = nullptr;
+    LeaveCriticalSection(&g_channelLock);
+
+    // Closing the read end fails a write still blocked on a tool that exited
+    // without reading, so the input thread always finishes.
+    if (channel->in) fclose(channel->in);
+    stopChannelInput(channel);
+    WaitForSingleObject(channel->inputThread, INFINITE);
+    CloseHandle(channel->inputThread);
+    CloseHandle(channel->outRead);
+    CloseHandle(channel->toolThread);
+    writeControl("CLOSED " + std::to_string(channel->id) + " " + std::to_string(code));
+    delete channel;
+    return 0;
+}
+
+static std::vector<std::string> splitWords(const std::string& line)
+{
+    std::vector<std::string> words;
+    size_t pos = 0;
+    while (pos < line.size())
+    {
+        const size_t end = line.find(' ', pos);
+        const size_t stop = end == std::string::npos ? line.size() : end;
+        if (stop > pos) words.push_back(line.substr(pos, stop - pos));
+        pos = stop + 1;
+    }
+    return words;
+}
+
+// Maps the requested tool and arguments to a run function and the mode
+// name used to enforce one instance per mode.
+static bool resolveTool(const std::vector<std::string>& args, ToolMain& run, std::string& mode)
+{
+    if (args[0] == "mouse_block")
+    {
+        run = runMouseBlock;
+        mode = "mouse_block";
+        return true;
+    }
+    if (args[0] == "window_info" && args.size() >= 2 && (args[1] == "--serve" || args[1] == "--watch"))
+    {
+        run = runWindowInfo;
+        mode = "window_info " + args[1];
+        return true;
+    }
+    return false;
+}
+
+static std::string openChannel(int id, const std::vector<std::string>& args)
+{
+    if (id <= 0 || id >= MAX_CHANNELS) return "invalid channel";
+    if (args.empty()) return "missing tool";
+
+    ToolMain run = nullptr;
+    std::string mode;
+    if (!resolveTool(args, run, mode)) return "unsupported tool";
+
+    EnterCriticalSection(&g_channelLock);
+    bool busy = g_channels[id] != nullptr;
+    for (int i = 1; i < MAX_CHANNELS && !busy; ++i)
+    {
+        busy = g_channels[i] && g_channels[i]->mode == mode;
+    }
+    LeaveCriticalSection(&g_channelLock);
+    if (busy) return "channel or tool busy";
+
+    HANDLE inRead = NULL, inWrite = NULL, outRead = NULL, outWrite = NULL;
+    if (!CreatePipe(&inRead, &inWrite, NULL, 0)) return "pipe failed";
+    if (!CreatePipe(&outRead, &outWrite, NULL, 0))
+    {
+        CloseHandle(inRead);
+        CloseHandle(inWrite);
+        return "pipe failed";
+    }
+
+    Channel* channel = new Channel;
+    channel->id = static_cast<uint8_t>(id);
+    channel->mode = mode;
+    channel->run = run;
+    channel->args = args;
+    channel->inWrite = inWrite;
+    channel->outRead = outRead;
+    // The CRT owns inRead/outWrite from here; fclose releases them.
+    channel->in = _fdopen(_open_osfhandle(reinterpret_cast<intptr_t>(inRead), _O_RDONLY | _O_BINARY), "rb");
+    channel->out = _fdopen(_open_osfhandle(reinterpret_cast<intptr_t>(outWrite), _O_WRONLY | _O_BINARY), "wb");
+    if (!channel->in || !channel->out)
+    {
+        if (channel->in) fclose(channel->in);
+        if (channel->out) fclose(channel->out);
+        CloseHandle(inWrite);
+        CloseHandle(outRead);
+        delete channel;
+        return "stream failed";
+    }
+
+    channel->toolThread = CreateThread(NULL, 0, toolThreadProc, channel, CREATE_SUSPENDED, NULL);
+    if (!channel->toolThread)
+    {
+        fclose(channel->in);
+        fclose(channel->out);
+        CloseHandle(inWrite);
+        CloseHandle(outRead);
+        delete channel;
+        return "thread failed";
+    }
+    channel->inputThread = CreateThread(NULL, 0, inputThreadProc, channel, 0, NULL);
+    if (!channel->inputThread)
+    {
+        TerminateThread(channel->toolThread, 1); // never ran
+        CloseHandle(channel->toolThread);
+        fclose(channel->in);
+        fclose(channel->out);
+        CloseHandle(inWrite);
+        CloseHandle(outRead);
+        delete channel;
+        return "thread failed";
+    }
+
+    // The pump frees the channel once the tool has exited, so it is only
+    // published after all three threads exist.
+    HANDLE pump = CreateThread(NULL, 0, pumpThreadProc, channel, 0, NULL);
+    if (!pump)
+    {
+        TerminateThread(channel->toolThread, 1); // never ran
+        CloseHandle(channel->toolThread);
+        stopChannelInput(channel); // closes inWrite
+        WaitForSingleObject(channel->inputThread, INFINITE);
+        CloseHandle(channel->inputThread);
+        fclose(channel->in);
+        fclose(channel->out);
+        CloseHandle(outRead);
+        delete channel;
+        return "thread failed";
+    }
+    CloseHandle(pump);
+
+    EnterCriticalSection(&g_channelLock);
+    g_channels[id] = channel;
+    LeaveCriticalSection(&g_channelLock);
+
+    // OPENED goes out before the tool can print READY on its channel.
+    writeControl("OPENED " + std::to_string(id));
+    ResumeThread(channel->toolThread);
+    return std::string();
+}
+
+// Closing the tool's stdin is its shutdown signal; queued input goes first.
+static void closeChannelInput(uint8_t id)
+{
+    EnterCriticalSection(&g_channelLock);
+    Channel* channel = g_channels[id];
+    if (channel) stopChannelInput(channel);
+    LeaveCriticalSection(&g_channelLock);
+}
+
+static void handleControl(const std::string& line)
+{
+    std::vector<std::string> words = splitWords(line);
+    if (words.size() < 2) return;
+    const int id = atoi(words[1].c_str());
+
+    if (words[0] == "OPEN")
+    {
+        std::vector<std::string> args(words.begin() + 2, words.end());
+        const std::string error = openChannel(id, args);
+        if (!error.empty()) writeControl("ERROR " + std::to_string(id) + " " + error);
+    }
+    else if (words[0] == "CLOSE" && id > 0 && id < MAX_CHANNELS)
+    {
+        closeChannelInput(static_cast<uint8_t>(id));
+    }
+}
+
+static void forwardToChannel(uint8_t id, const std::vector<char>& payload)
+{
+    if (payload.empty()) return;
+
+    // Only queued here; the lock keeps the pump from freeing the channel.
+    EnterCriticalSection(&g_channelLock);
+    Channel* channel = g_channels[id];
+    if (channel)
+    {
+        AcquireSRWLockExclusive(&channel->inputLock);
+        const bool queued = !channel->inputClosed;
+        if (queued) channel->input.push_back(payload);
+        ReleaseSRWLockExclusive(&channel->inputLock);
+        if (queued) WakeConditionVariable(&channel->inputReady);
+    }
+    LeaveCriticalSection(&g_channelLock);
+}
+
+static bool anyChannelOpen()
+{
+    EnterCriticalSection(&g_channelLock);
+    bool open = false;
+    for (int i = 1; i < MAX_CHANNELS && !open; ++i) open = g_channels[i] != nullptr;
+    LeaveCriticalSection(&g_channelLock);
+    return open;
+}
+
+int main()
+{
+    enablePerMonitorDpiAwareness();
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+    InitializeCriticalSection(&g_frameLock);
+    InitializeCriticalSection(&g_channelLock);
+
+    // Shared by every tool for the life of the host.
+    WindowIndex index;
+    index.start();
+    g_sharedContext.index = &index;
+    g_sharedContext.hosted = true;
+
+    writeControl("READY " + std::to_string(HOST_PROTOCOL_VERSION));
+
+    std::vector<char> payload;
+    for (;;)
+    {
+        uint8_t header[5];
+        if (!readExact(header, sizeof(header))) break;
+        uint32_t length = 0;
+        memcpy(&length, header, 4);
+        if (length > MAX_FRAME_BYTES)
+        {
+            fprintf(stderr, "Frame too large: %u\n", length);
+            break;
+        }
+        payload.resize(length);
+        if (length && !readExact(payload.data(), length)) break;
+
+        if (header[4] == 0)
+        {
+            handleControl(std::string(payload.begin(), payload.end()));
+        }
+        else
+        {
+            forwardToChannel(header[4], payload);
+        }
+    }
+
+    // Parent went away: every tool sees EOF on its stdin and winds down.
+    for (int i = 1; i < MAX_CHANNELS; ++i)
+    {
+        closeChannelInput(static_cast<uint8_t>(i));
+    }
+    for (int waited = 0; waited < 3000 && anyChannelOpen(); waited += 10)
+    {
+        Sleep(10);
+    }
+
+    index.stop();
+    shutdownGdiplus();
+    return 0;
+}
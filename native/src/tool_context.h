@@ -0,0 +1,30 @@
+// tool_context.h - Streams and shared state a native tool runs against.
+//
+// Each tool (mouse_block_tool.h, window_info_tool.h) is a run function rather
+// than a main(), so it can be built as its own exe or run on a thread inside
+// stella_native_host.exe. Standalone, in/out are stdin/stdout and the tool
+// owns everything it uses. Hosted, in/out are in-process pipes of one channel
+// and the host lends its long-lived state.
+
+#pragma once
+
+#include <cstdio>
+
+class WindowIndex;
+
+struct ToolContext
+{
+    FILE* in;
+    FILE* out;
+    // Started by the host for the whole process; null means the tool makes
+    // its own (server mode) or walks the live z-order.
+    WindowIndex* index;
+    // Process-wide state (GDI+, DXGI session) outlives the tool.
+    bool hosted;
+};
+
+static inline ToolContext standaloneToolContext()
+{
+    ToolContext context = {stdin, stdout, nullptr, false};
+    return context;
+}
@@ -0,0 +1,263 @@
+// uia_text.h - Text of the focused element and of the element at a point,
+// read through UI Automation instead of a screenshot and OCR.
+//
+// "uia":true (--uia) adds
+//   "uia":{"focused":{"name":..,"controlType":..,"pid":P,"text":..}|null,
+//          "selection":".."|null,"atPoint":{...}|null,"timedOut":false}
+// "text" is the element's ValuePattern value, else its TextPattern document
+// text; "selection" is the focused element's TextPattern selection (what
+// selected-text.ts asks PowerShell for), ranges joined by newlines. Strings
+// are cut to UIA_MAX_CHARS. "pid" tells whether the focused element belongs
+// to the window that was queried.
+// UIA calls go into the target process and a busy app can stall them, so a
+// request runs under a budget ("uiaBudgetMs", UIA_DEFAULT_BUDGET_MS): the
+// IUIAutomation2 timeouts bound each cross-process call, steps still left
+// once it is spent are skipped, and "timedOut":true says so. The automation
+// object is created once per thread (once per server) and kept.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <ole2.h>
+#include <uiautomation.h>
+#include <string>
+
+#include "json_writer.h"
+#include "latency_histogram.h"
+
+#pragma comment(lib, "ole32.lib")
+#pragma comment(lib, "oleaut32.lib")
+
+static const int UIA_DEFAULT_BUDGET_MS = 500;
+static const size_t UIA_MAX_CHARS = 16384;
+
+namespace uiatext
+{
+
+// Declared by UIAutomationClient.h but only defined in uuid.lib on some
+// SDKs; MinGW lacks several of them.
+static const CLSID kCUIAutomation = {0xff48dba4, 0x60ef, 0x4201, {0xaa, 0x87, 0x54, 0x10, 0x3e, 0xef, 0x59, 0x4e}};
+static const IID kIUIAutomation = {0x30cbe57d, 0xd9d0, 0x452a, {0xab, 0x13, 0x7a, 0xc5, 0xac, 0x48, 0x25, 0xee}};
+static const IID kIUIAutomation2 = {0x34723aff, 0x0c9d, 0x49d0, {0x98, 0x96, 0x7a, 0xb5, 0x2d, 0xf8, 0xcd, 0x8a}};
+static const IID kIValuePattern = {0xa94cd8b1, 0x0844, 0x4cd6, {0x9d, 0x2d, 0x64, 0x05, 0x37, 0xab, 0x39, 0xe9}};
+static const IID kITextPattern = {0x32eba289, 0x3583, 0x42c9, {0x9c, 0x59, 0x3b, 0x6d, 0x9a, 0x1e, 0x9b, 0x6a}};
+static const PATTERNID kValuePatternId = 10002; // UIA_ValuePatternId
+static const PATTERNID kTextPatternId = 10014;  // UIA_TextPatternId
+
+struct ThreadState
+{
+    bool tried = false;
+    bool comInitialized = false;
+    IUIAutomation* automation = nullptr;
+    DWORD timeoutMs = 0; // last IUIAutomation2 timeouts set
+};
+
+inline ThreadState& threadState()
+{
+    static thread_local ThreadState state;
+    return state;
+}
+
+struct Budget
+{
+    int64_t start;
+    uint64_t limitUs;
+    bool timedOut = false;
+
+    // False (and timedOut) once the budget is spent.
+    bool left()
+    {
+        if (!timedOut && qpcToMicros(qpcNow() - start) >= limitUs) timedOut = true;
+        return !timedOut;
+    }
+};
+
+template <class T>
+inline void release(T*& object)
+{
+    if (object) object->Release();
+    object = nullptr;
+}
+
+inline void writeBstr(JsonWriter& json, BSTR value)
+{
+    size_t length = value ? SysStringLen(value) : 0;
+    if (length > UIA_MAX_CHARS) length = UIA_MAX_CHARS;
+    json.string(value ? value : L"", length);
+}
+
+// ValuePattern value, else TextPattern document text; false when neither.
+inline bool readElementText(IUIAutomationElement* element, BSTR& text)
+{
+    text = nullptr;
+    IUIAutomationValuePattern* value = nullptr;
+    if (SUCCEEDED(element->GetCurrentPatternAs(kValuePatternId, kIValuePattern, reinterpret_cast<void**>(&value))) &&
+        value)
+    {
+        value->get_CurrentValue(&text);
+        release(value);
+        if (text && SysStringLen(text)) return true;
+        SysFreeString(text);
+        text = nullptr;
+    }
+
+    IUIAutomationTextPattern* pattern = nullptr;
+    if (FAILED(element->GetCurrentPatternAs(kTextPatternId, kITextPattern, reinterpret_cast<void**>(&pattern))) ||
+        !pattern)
+    {
+        return false;
+    }
+    IUIAutomationTextRange* document = nullptr;
+    if (SUCCEEDED(pattern->get_DocumentRange(&document)) && document)
+    {
+        document->GetText(static_cast<int>(UIA_MAX_CHARS), &text);
+        release(document);
+    }
+    release(pattern);
+    return text != nullptr;
+}
+
+inline void writeElement(JsonWriter& json, IUIAutomationElement* element, Budget& budget)
+{
+    BSTR name = nullptr;
+    BSTR controlType = nullptr;
+    int pid = 0;
+    element->get_CurrentName(&name);
+    element->get_CurrentLocalizedControlType(&controlType);
+    element->get_CurrentProcessId(&pid);
+
+    json.raw('{').key("name");
+    writeBstr(json, name);
+    json.raw(',').key("controlType");
+    writeBstr(json, controlType);
+    json.raw(',').key("pid").number(static_cast<long long>(pid));
+    SysFreeString(name);
+    SysFreeString(controlType);
+
+    BSTR text = nullptr;
+    if (budget.left() && readElementText(element, text))
+    {
+        json.raw(',').key("text");
+        writeBstr(json, text);
+    }
+    SysFreeString(text);
+    json.raw('}');
+}
+
+// The focused element's selected text; false without a TextPattern or
+// selection.
+inline bool writeSelection(JsonWriter& json, IUIAutomationElement* element, Budget& budget)
+{
+    IUIAutomationTextPattern* pattern = nullptr;
+    if (FAILED(element->GetCurrentPatternAs(kTextPatternId, kITextPattern, reinterpret_cast<void**>(&pattern))) ||
+        !pattern)
+    {
+        return false;
+    }
+    IUIAutomationTextRangeArray* ranges = nullptr;
+    int count = 0;
+    if (FAILED(pattern->GetSelection(&ranges)) || !ranges || FAILED(ranges->get_Length(&count)) || count <= 0)
+    {
+        release(ranges);
+        release(pattern);
+        return false;
+    }
+
+    std::wstring selection;
+    for (int i = 0; i < count && selection.size() < UIA_MAX_CHARS && budget.left(); ++i)
+    {
+        IUIAutomationTextRange* range = nullptr;
+        BSTR text = nullptr;
+        if (SUCCEEDED(ranges->GetElement(i, &range)) && range &&
+            SUCCEEDED(range->GetText(static_cast<int>(UIA_MAX_CHARS - selection.size()), &text)) && text)
+        {
+            if (!selection.empty()) selection += L'\n';
+            selection.append(text, SysStringLen(text));
+        }
+        SysFreeString(text);
+        release(range);
+    }
+    release(ranges);
+    release(pattern);
+    if (selection.empty()) return false;
+    if (selection.size() > UIA_MAX_CHARS) selection.resize(UIA_MAX_CHARS);
+    json.string(selection.data(), selection.size());
+    return true;
+}
+
+} // namespace uiatext
+
+// The calling thread's automation object, created (with COM) on first use;
+// null when UIA is unavailable.
+static IUIAutomation* uiAutomation()
+{
+    uiatext::ThreadState& state = uiatext::threadState();
+    if (!state.tried)
+    {
+        state.tried = true;
+        // MTA, as UIA clients should be; a thread that already chose STA
+        // keeps it (RPC_E_CHANGED_MODE) and still works.
+        state.comInitialized = SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED));
+        CoCreateInstance(uiatext::kCUIAutomation, NULL, CLSCTX_INPROC_SERVER, uiatext::kIUIAutomation,
+                         reinterpret_cast<void**>(&state.automation));
+    }
+    return state.automation;
+}
+
+// Releases the calling thread's automation object and its COM init.
+static void releaseUiAutomation()
+{
+    uiatext::ThreadState& state = uiatext::threadState();
+    uiatext::release(state.automation);
+    if (state.comInitialized) CoUninitialize();
+    state = uiatext::ThreadState();
+}
+
+// Appends ,"uia":{...} for the focused element and the element at pt.
+static void appendUiaText(std::string& head, POINT pt, int budgetMs)
+{
+    JsonWriter json(head, 1024);
+    json.raw(',').key("uia");
+    IUIAutomation* automation = uiAutomation();
+    if (!automation)
+    {
+        json.raw("null");
+        return;
+    }
+
+    if (budgetMs <= 0) budgetMs = UIA_DEFAULT_BUDGET_MS;
+    uiatext::ThreadState& state = uiatext::threadState();
+    if (state.timeoutMs != static_cast<DWORD>(budgetMs))
+    {
+        IUIAutomation2* timeouts = nullptr;
+        if (SUCCEEDED(automation->QueryInterface(uiatext::kIUIAutomation2, reinterpret_cast<void**>(&timeouts))) &&
+            timeouts)
+        {
+            timeouts->put_ConnectionTimeout(static_cast<DWORD>(budgetMs));
+            timeouts->put_TransactionTimeout(static_cast<DWORD>(budgetMs));
+            uiatext::release(timeouts);
+        }
+        state.timeoutMs = static_cast<DWORD>(budgetMs);
+    }
+    uiatext::Budget budget = {qpcNow(), static_cast<uint64_t>(budgetMs) * 1000};
+
+    IUIAutomationElement* focused = nullptr;
+    automation->GetFocusedElement(&focused);
+    json.raw('{').key("focused");
+    if (focused) uiatext::writeElement(json, focused, budget);
+    else json.raw("null");
+
+    json.raw(',').key("selection");
+    if (!focused || !budget.left() || !uiatext::writeSelection(json, focused, budget)) json.raw("null");
+    uiatext::release(focused);
+
+    json.raw(',').key("atPoint");
+    IUIAutomationElement* atPoint = nullptr;
+    if (budget.left()) automation->ElementFromPoint(pt, &atPoint);
+    if (atPoint) uiatext::writeElement(json, atPoint, budget);
+    else json.raw("null");
+    uiatext::release(atPoint);
+
+    json.raw(',').key("timedOut").boolean(budget.timedOut).raw('}');
+}
@@ -0,0 +1,183 @@
+// visible_region.h - Which parts of a top-level window nothing covers.
+//
+// PrintWindow renders a window's own content even where other windows are
+// on top of it, and the capture alone cannot tell the two apart. The visible
+// region is the window's rect minus the rect of every top-level window above
+// it in z-order, as disjoint rects in screen coordinates (physical pixels).
+// Server mode takes the z-order from the WindowIndex snapshot, one-shot
+// queries walk it live. Occluders are measured by their DWM extended frame
+// bounds, so the invisible resize borders around Windows 10+ frames do not
+// count as cover; cloaked windows (other virtual desktops, suspended UWP
+// apps), click-through overlays and excluded pids do not count at all.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <dwmapi.h>
+#include <algorithm>
+#include <vector>
+
+#include "window_index.h"
+
+#pragma comment(lib, "dwmapi.lib")
+
+namespace visibleregion
+{
+
+inline bool intersects(const RECT& a, const RECT& b)
+{
+    return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+// Replaces every rect of region that cut overlaps with the (up to four)
+// pieces of it outside cut.
+inline void subtract(std::vector<RECT>& region, const RECT& cut)
+{
+    std::vector<RECT> out;
+    out.reserve(region.size() + 4);
+    for (const RECT& r : region)
+    {
+        if (!intersects(r, cut))
+        {
+            out.push_back(r);
+            continue;
+        }
+        // Full-width bands above and below the cut, then the sides between.
+        if (r.top < cut.top) out.push_back(RECT{r.left, r.top, r.right, cut.top});
+        if (cut.bottom < r.bottom) out.push_back(RECT{r.left, cut.bottom, r.right, r.bottom});
+        const LONG top = r.top > cut.top ? r.top : cut.top;
+        const LONG bottom = r.bottom < cut.bottom ? r.bottom : cut.bottom;
+        if (r.left < cut.left) out.push_back(RECT{r.left, top, cut.left, bottom});
+        if (cut.right < r.right) out.push_back(RECT{cut.right, top, r.right, bottom});
+    }
+    region.swap(out);
+}
+
+struct Occluder
+{
+    HWND hwnd;
+    DWORD pid;
+    RECT rect;
+};
+
+inline bool isExcluded(DWORD pid, const std::vector<DWORD>& excluded)
+{
+    for (DWORD value : excluded)
+    {
+        if (value == pid) return true;
+    }
+    return false;
+}
+
+// Cuts what an occluder actually draws over out of region.
+inline void applyOccluder(const Occluder& occluder, const std::vector<DWORD>& excluded, std::vector<RECT>& region)
+{
+    if (isExcluded(occluder.pid, excluded)) return;
+    if (GetWindowLongW(occluder.hwnd, GWL_EXSTYLE) & WS_EX_TRANSPARENT) return;
+    DWORD cloaked = 0;
+    if (SUCCEEDED(DwmGetWindowAttribute(occluder.hwnd, DWMWA_CLOAKED, &cloaked, sizeof(cloaked))) && cloaked)
+    {
+        return;
+    }
+    RECT frame = occluder.rect;
+    RECT extended = {};
+    if (SUCCEEDED(DwmGetWindowAttribute(occluder.hwnd, DWMWA_EXTENDED_FRAME_BOUNDS, &extended, sizeof(extended))))
+    {
+        frame = extended;
+    }
+    subtract(region, frame);
+}
+
+// Windows above target whose rect overlaps bounds, front to back. False when
+// target is not in the snapshot (it changed since); the caller walks live.
+inline bool occludersFromIndex(WindowIndex& index, HWND target, const RECT& bounds, std::vector<Occluder>& out)
+{
+    bool found = false;
+    index.withSnapshot([&](const WindowIndex::Snapshot& snap) {
+        for (size_t i = 0; i < snap.size(); ++i)
+        {
+            if (snap.hwnd[i] == target)
+            {
+                found = true;
+                return;
+            }
+            if (intersects(snap.rect[i], bounds)) out.push_back(Occluder{snap.hwnd[i], snap.pid[i], snap.rect[i]});
+        }
+    });
+    if (!found) out.clear();
+    return found;
+}
+
+inline void occludersFromZOrder(HWND target, const RECT& bounds, std::vector<Occluder>& out)
+{
+    for (HWND hwnd = GetTopWindow(NULL); hwnd && hwnd != target; hwnd = GetWindow(hwnd, GW_HWNDNEXT))
+    {
+        RECT rect = {};
+        if (!IsWindowVisible(hwnd) || !GetWindowRect(hwnd, &rect) || !intersects(rect, bounds)) continue;
+        DWORD pid = 0;
+        GetWindowThreadProcessId(hwnd, &pid);
+        out.push_back(Occluder{hwnd, pid, rect});
+    }
+}
+
+} // namespace visibleregion
+
+// Parts of bounds (target's rect on screen) that are on the desktop and not
+// covered by windows above target, ignoring windows of excludedPids. Empty
+// when fully covered or minimized.
+static void computeVisibleRegion(HWND target, const RECT& bounds, const std::vector<DWORD>& excludedPids,
+                                 WindowIndex* index, std::vector<RECT>& visible)
+{
+    visible.clear();
+    RECT desktop;
+    desktop.left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+    desktop.top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    desktop.right = desktop.left + GetSystemMetrics(SM_CXVIRTUALSCREEN);
+    desktop.bottom = desktop.top + GetSystemMetrics(SM_CYVIRTUALSCREEN);
+    RECT onScreen;
+    if (IsIconic(target) || !IntersectRect(&onScreen, &bounds, &desktop)) return;
+
+    std::vector<visibleregion::Occluder> occluders;
+    if (!index || !visibleregion::occludersFromIndex(*index, target, bounds, occluders))
+    {
+        visibleregion::occludersFromZOrder(target, bounds, occluders);
+    }
+    visible.assign(1, onScreen);
+    for (const visibleregion::Occluder& occluder : occluders)
+    {
+        visibleregion::applyOccluder(occluder, excludedPids, visible);
+        if (visible.empty()) break;
+    }
+}
+
+// Paints every pixel of a w x h BGRA image whose screen position (origin +
+// x, y) is outside visible opaque black, as PrintWindow leaves unpainted areas.
+static void maskOutsideRegion(BYTE* pixels, size_t stride, int w, int h, POINT origin,
+                              const std::vector<RECT>& visible)
+{
+    std::vector<unsigned char> keep(static_cast<size_t>(w));
+    for (int y = 0; y < h; ++y)
+    {
+        const LONG screenY = origin.y + y;
+        std::fill(keep.begin(), keep.end(), 0);
+        for (const RECT& r : visible)
+        {
+            if (screenY < r.top || screenY >= r.bottom) continue;
+            LONG left = r.left - origin.x;
+            LONG right = r.right - origin.x;
+            if (left < 0) left = 0;
+            if (right > w) right = w;
+            for (LONG x = left; x < right; ++x) keep[x] = 1;
+        }
+        BYTE* row = pixels + stride * y;
+        for (int x = 0; x < w; ++x)
+        {
+            if (keep[x]) continue;
+            row[x * 4 + 0] = 0;
+            row[x * 4 + 1] = 0;
+            row[x * 4 + 2] = 0;
+            row[x * 4 + 3] = 0xFF;
+        }
+    }
+}
@@ -0,0 +1,220 @@
+// window_index.h - Cached z-order snapshot of visible top-level windows.
+//
+// findTopLevelWindowAtPoint walks every top-level window (hundreds, most of
+// them hidden tool windows) with three syscalls each on every query. In
+// server mode the helper keeps this compact struct-of-arrays snapshot
+// instead and answers point queries from memory. A background thread owns
+// out-of-context WinEvent hooks and only flips a dirty flag; the snapshot is
+// rebuilt lazily by the next query after windows are created, destroyed,
+// shown, hidden, moved or reordered.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <atomic>
+#include <vector>
+
+class WindowIndex
+{
+public:
+    // Struct-of-arrays, front-to-back z-order. Valid while the lock is held.
+    struct Snapshot
+    {
+        std::vector<HWND> hwnd;
+        std::vector<DWORD> pid;
+        std::vector<RECT> rect;
+
+        size_t size() const { return hwnd.size(); }
+    };
+
+    WindowIndex() { InitializeSRWLock(&lock_); }
+    WindowIndex(const WindowIndex&) = delete;
+    WindowIndex& operator=(const WindowIndex&) = delete;
+    ~WindowIndex() { stop(); }
+
+    // Starts the hook thread. Without it the index rebuilds on every query.
+    bool start()
+    {
+        if (thread_) return true;
+        s_instance = this;
+        ready_ = CreateEventW(NULL, TRUE, FALSE, NULL);
+        thread_ = CreateThread(NULL, 0, hookThread, this, 0, &threadId_);
+        if (!thread_)
+        {
+            CloseHandle(ready_);
+            ready_ = NULL;
+            return false;
+        }
+        WaitForSingleObject(ready_, 2000);
+        CloseHandle(ready_);
+        ready_ = NULL;
+        return hooked_;
+    }
+
+    void stop()
+    {
+        if (!thread_) return;
+        PostThreadMessageW(threadId_, WM_QUIT, 0, 0);
+        WaitForSingleObject(thread_, 2000);
+        CloseHandle(thread_);
+        thread_ = NULL;
+        hooked_ = false;
+        dirty_ = true;
+        if (s_instance == this) s_instance = nullptr;
+    }
+
+    void invalidate() { dirty_ = true; }
+
+    // Runs fn(const Snapshot&) against an up-to-date snapshot.
+    template <class Fn>
+    void withSnapshot(Fn fn)
+    {
+        AcquireSRWLockExclusive(&lock_);
+        if (dirty_.exchange(false) || !hooked_)
+        {
+            rebuild();
+        }
+        fn(static_cast<const Snapshot&>(snapshot_));
+        ReleaseSRWLockExclusive(&lock_);
+    }
+
+    // For each point, the topmost indexed window containing it whose pid is
+    // not excluded. Entries already set in found are left alone.
+    void windowsAtPoints(const std::vector<POINT>& points, const std::vector<DWORD>& excludedPids,
+                         std::vector<HWND>& found)
+    {
+        const std::vector<HWND> initial = found;
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            withSnapshot([&](const Snapshot& snap) {
+                for (size_t p = 0; p < points.size(); ++p)
+                {
+                    if (found[p]) continue;
+                    const POINT pt = points[p];
+                    for (size_t i = 0; i < snap.size(); ++i)
+                    {
+                        const RECT& r = snap.rect[i];
+                        if (pt.x < r.left || pt.x >= r.right || pt.y < r.top || pt.y >= r.bottom) continue;
+                        if (isExcluded(snap.pid[i], excludedPids)) continue;
+                        found[p] = snap.hwnd[i];
+                        break;
+                    }
+                }
+            });
+
+            // WinEvents arrive asynchronously, so a hit can be a few ms stale.
+            // One cheap check per hit catches a window that just moved or closed.
+            bool stale = false;
+            for (size_t p = 0; p < points.size(); ++p)
+            {
+                if (found[p] && !initial[p] && !stillContains(found[p], points[p]))
+                {
+                    stale = true;
+                    break;
+                }
+            }
+            if (!stale) return;
+            found = initial;
+            dirty_ = true;
+        }
+    }
+
+private:
+    static WindowIndex* s_instance;
+
+    SRWLOCK lock_;
+    Snapshot snapshot_;
+    std::atomic<bool> dirty_{true};
+    bool hooked_ = false;
+    HANDLE thread_ = NULL;
+    HANDLE ready_ = NULL;
+    DWORD threadId_ = 0;
+
+    static bool isExcluded(DWORD pid, const std::vector<DWORD>& excluded)
+    {
+        for (DWORD value : excluded)
+        {
+            if (value == pid) return true;
+        }
+        return false;
+    }
+
+    static bool stillContains(HWND hwnd, POINT pt)
+    {
+        RECT r = {};
+        if (!IsWindowVisible(hwnd) || !GetWindowRect(hwnd, &r)) return false;
+        return pt.x >= r.left && pt.x < r.right && pt.y >= r.top && pt.y < r.bottom;
+    }
+
+    void rebuild()
+    {
+        snapshot_.hwnd.clear();
+        snapshot_.pid.clear();
+        snapshot_.rect.clear();
+        for (HWND hwnd = GetTopWindow(NULL); hwnd; hwnd = GetWindow(hwnd, GW_HWNDNEXT))
+        {
+            if (!IsWindowVisible(hwnd)) continue;
+            RECT rect = {};
+            if (!GetWindowRect(hwnd, &rect)) continue;
+            if (rect.right <= rect.left || rect.bottom <= rect.top) continue;
+            DWORD pid = 0;
+            GetWindowThreadProcessId(hwnd, &pid);
+            snapshot_.hwnd.push_back(hwnd);
+            snapshot_.pid.push_back(pid);
+            snapshot_.rect.push_back(rect);
+        }
+    }
+
+    static void CALLBACK onWinEvent(HWINEVENTHOOK, DWORD event, HWND hwnd, LONG idObject, LONG idChild,
+                                    DWORD, DWORD)
+    {
+        WindowIndex* self = s_instance;
+        if (!self || idObject != OBJID_WINDOW || idChild != CHILDID_SELF || !hwnd) return;
+        // Child-window churn does not affect the top-level index. A destroyed
+        // window can no longer be inspected, so always count it.
+        if (event != EVENT_OBJECT_DESTROY && GetAncestor(hwnd, GA_PARENT) != GetDesktopWindow()) return;
+        self->dirty_ = true;
+    }
+
+    static DWORD WINAPI hookThread(LPVOID param)
+    {
+        WindowIndex* self = static_cast<WindowIndex*>(param);
+        const DWORD flags = WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS;
+
+        // Separate ranges so uninteresting events in between (focus,
+        // selection, state, name) are never marshalled to this thread.
+        HWINEVENTHOOK hooks[] = {
+            SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_REORDER, NULL, onWinEvent, 0, 0, flags),
+            SetWinEventHook(EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_LOCATIONCHANGE, NULL, onWinEvent, 0, 0, flags),
+            SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, NULL, onWinEvent, 0, 0, flags),
+            SetWinEventHook(EVENT_SYSTEM_MINIMIZESTART, EVENT_SYSTEM_MINIMIZEEND, NULL, onWinEvent, 0, 0, flags),
+        };
+        bool allHooked = true;
+        for (HWINEVENTHOOK hook : hooks)
+        {
+            allHooked = allHooked && hook != NULL;
+        }
+        self->hooked_ = allHooked;
+        self->dirty_ = true;
+
+        // Make sure the thread has a message queue before start() returns,
+        // so PostThreadMessage(WM_QUIT) cannot be lost.
+        MSG msg;
+        PeekMessageW(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+        SetEvent(self->ready_);
+
+        while (GetMessageW(&msg, NULL, 0, 0) > 0)
+        {
+            DispatchMessageW(&msg);
+        }
+
+        for (HWINEVENTHOOK hook : hooks)
+        {
+            if (hook) UnhookWinEvent(hook);
+        }
+        return 0;
+    }
+};
+
+WindowIndex* WindowIndex::s_instance = nullptr;
@@ -1,118 +1,605 @@
-// window_info - Returns JSON info about the window at a given screen point
-// Usage: window_info <x> <y> [--exclude-pids=1,2,3] [--screenshot=path.png]
-// Build: swiftc -O -o window_info src/window_info.swift -framework CoreGraphics -framework AppKit
+// window_info - JSON info (and captures) of the window at a screen point, macOS build.
+// Usage: window_info <x> <y> [--exclude-pids=1,2,3] [--screenshot=path.png|-] [--format=png|jpeg|raw]
+//                    [--quality=0-100] [--max-size=WxH] [--scale=0.5] [--timings]
+//        window_info --points=x1,y1;x2,y2;... [--exclude-pids=1,2,3]
+//        window_info --serve
+// Build: native/build.sh
 // Output: {"title":"...","process":"...","pid":123,"bounds":{"x":0,"y":0,"width":800,"height":600}}
+//
+// Speaks the same protocol as the Windows helper (window_info_tool.h), as
+// specified in docs/WINDOW_INFO_PROTOCOL.md: --serve answers one JSON request
+// per stdin line after READY, --screenshot=- / "frame":true send the image as
+// a binary frame after its JSON line, and --points= / "points" resolve many
+// points against one window list. Points and bounds are in points (DIPs), so
+// "space" is accepted and ignored. Windows-only fields that add to the reply
+// (diff, visibleRegion, tree, uia, ...) are ignored; "rect" and the prefetch
+// requests answer "unsupported".
+//
+// Window captures use ScreenCaptureKit on macOS 14+ (SCScreenshotManager,
+// scaled to the requested size in the capture) and CGWindowListCreateImage
+// before that; the image header names the backend used. The server keeps the
+// ScreenCaptureKit window list between requests and refreshes it only when a
+// window is missing from it.
 
 import AppKit
 import CoreGraphics
 import Foundation
+import ImageIO
+import ScreenCaptureKit
 
-func parseExcludedPids(_ args: ArraySlice<String>) -> Set<Int> {
-    let prefix = "--exclude-pids="
-    var pids = Set<Int>()
-
-    for arg in args {
-        guard arg.hasPrefix(prefix) else { continue }
-        let payload = String(arg.dropFirst(prefix.count))
-        for rawValue in payload.split(separator: ",") {
-            let value = rawValue.trimmingCharacters(in: .whitespacesAndNewlines)
-            guard let pid = Int(value), pid > 0 else { continue }
-            pids.insert(pid)
-        }
-    }
-
-    return pids
-}
-
-func parseScreenshotPath(_ args: ArraySlice<String>) -> String? {
-    let prefix = "--screenshot="
-    for arg in args {
-        guard arg.hasPrefix(prefix) else { continue }
-        return String(arg.dropFirst(prefix.count))
-    }
-    return nil
-}
+// MARK: - JSON
 
 func escapeJson(_ s: String) -> String {
     var out = ""
-    for ch in s {
-        switch ch {
+    out.reserveCapacity(s.utf8.count)
+    for scalar in s.unicodeScalars {
+        switch scalar {
         case "\"": out += "\\\""
         case "\\": out += "\\\\"
         case "\n": out += "\\n"
         case "\r": out += "\\r"
         case "\t": out += "\\t"
-        default: out.append(ch)
+        case "\u{08}": out += "\\b"
+        case "\u{0C}": out += "\\f"
+        default:
+            if scalar.value < 0x20 {
+                out += String(format: "\\u%04x", scalar.value)
+            } else {
+                out.unicodeScalars.append(scalar)
+            }
         }
     }
     return out
 }
 
-guard CommandLine.arguments.count >= 3,
-      let x = Double(CommandLine.arguments[1]),
-      let y = Double(CommandLine.arguments[2]) else {
-    fputs("Usage: window_info <x> <y>\n", stderr)
-    exit(1)
-}
-
-let point = CGPoint(x: x, y: y)
-let extraArgs = CommandLine.arguments.dropFirst(3)
-let excludedPids = parseExcludedPids(extraArgs)
-let screenshotPath = parseScreenshotPath(extraArgs)
-
-// Get all on-screen windows (excluding desktop elements)
-guard let windowList = CGWindowListCopyWindowInfo(
-    [.optionOnScreenOnly, .excludeDesktopElements],
-    kCGNullWindowID
-) as? [[String: Any]] else {
-    print("{\"error\":\"failed to get window list\"}")
-    exit(0)
-}
-
-// Find the topmost window whose bounds contain the point
-for window in windowList {
-    guard let boundsDict = window[kCGWindowBounds as String] as? [String: CGFloat],
-          let wx = boundsDict["X"],
-          let wy = boundsDict["Y"],
-          let ww = boundsDict["Width"],
-          let wh = boundsDict["Height"] else { continue }
-
-    let rect = CGRect(x: wx, y: wy, width: ww, height: wh)
-    guard rect.contains(point) else { continue }
-
-    // Skip windows with zero area or layer < 0 (system elements)
-    guard ww > 0, wh > 0 else { continue }
-    if let layer = window[kCGWindowLayer as String] as? Int, layer < 0 { continue }
-
-    let title = (window[kCGWindowName as String] as? String) ?? ""
-    let ownerName = (window[kCGWindowOwnerName as String] as? String) ?? ""
-    let pid = (window[kCGWindowOwnerPID as String] as? Int) ?? 0
-    if excludedPids.contains(pid) { continue }
-
-    let windowID = (window[kCGWindowNumber as String] as? CGWindowID) ?? 0
-
-    let json = """
-    {"title":"\(escapeJson(title))","process":"\(escapeJson(ownerName))","pid":\(pid),"bounds":{"x":\(Int(wx)),"y":\(Int(wy)),"width":\(Int(ww)),"height":\(Int(wh))}}
-    """
-    print(json.trimmingCharacters(in: .whitespacesAndNewlines))
-
-    // Capture screenshot if requested
-    if let ssPath = screenshotPath, windowID != 0 {
-        if let cgImage = CGWindowListCreateImage(
-            .null,
-            .optionIncludingWindow,
-            windowID,
-            [.boundsIgnoreFraming]
-        ) {
-            let bitmapRep = NSBitmapImageRep(cgImage: cgImage)
-            if let pngData = bitmapRep.representation(using: .png, properties: [:]) {
-                let url = URL(fileURLWithPath: ssPath)
-                try? pngData.write(to: url)
+// Stdout carries binary frames, so everything goes through one unbuffered
+// handle; print() would interleave its own buffer with the frame bytes.
+let stdoutHandle = FileHandle.standardOutput
+
+func writeMessage(_ line: String, _ bytes: Data? = nil) {
+    stdoutHandle.write(Data(line.utf8))
+    if let bytes, !bytes.isEmpty { stdoutHandle.write(bytes) }
+}
+
+// MARK: - Timings
+
+// Opt-in per-stage microseconds, the macOS subset of stage_timings.h.
+struct StageTimings {
+    enum Stage: Int, CaseIterable {
+        case resolve, capture, downscale, encode, save
+
+        var name: String {
+            switch self {
+            case .resolve: return "resolveUs"
+            case .capture: return "captureUs"
+            case .downscale: return "downscaleUs"
+            case .encode: return "encodeUs"
+            case .save: return "saveUs"
+            }
+        }
+    }
+
+    var enabled = false
+    var start: UInt64 = 0
+    var nanos = [UInt64?](repeating: nil, count: Stage.allCases.count) // nil = did not run
+
+    static func now() -> UInt64 { DispatchTime.now().uptimeNanoseconds }
+
+    mutating func begin() {
+        enabled = true
+        start = StageTimings.now()
+    }
+
+    // Runs body and adds its duration to stage.
+    mutating func time<T>(_ stage: Stage, _ body: () -> T) -> T {
+        guard enabled else { return body() }
+        let begin = StageTimings.now()
+        let result = body()
+        nanos[stage.rawValue] = (nanos[stage.rawValue] ?? 0) + (StageTimings.now() - begin)
+        return result
+    }
+
+    // ,"timings":{...} with totalUs up to now, or nothing when disabled.
+    func toJson() -> String {
+        guard enabled else { return "" }
+        var out = ",\"timings\":{"
+        for stage in Stage.allCases {
+            guard let spent = nanos[stage.rawValue] else { continue }
+            out += "\"\(stage.name)\":\(spent / 1000),"
+        }
+        return out + "\"totalUs\":\((StageTimings.now() - start) / 1000)}"
+    }
+}
+
+// MARK: - Window lookup
+
+struct WindowEntry {
+    let id: CGWindowID
+    let title: String
+    let owner: String
+    let pid: Int
+    let bounds: CGRect
+}
+
+// On-screen windows front to back, without desktop elements, zero-area
+// windows or system layers below 0.
+func listWindows() -> [WindowEntry]? {
+    guard let windowList = CGWindowListCopyWindowInfo(
+        [.optionOnScreenOnly, .excludeDesktopElements],
+        kCGNullWindowID
+    ) as? [[String: Any]] else {
+        return nil
+    }
+
+    var windows: [WindowEntry] = []
+    windows.reserveCapacity(windowList.count)
+    for window in windowList {
+        guard let boundsDict = window[kCGWindowBounds as String] as? [String: CGFloat],
+              let wx = boundsDict["X"],
+              let wy = boundsDict["Y"],
+              let ww = boundsDict["Width"],
+              let wh = boundsDict["Height"],
+              ww > 0, wh > 0 else { continue }
+        if let layer = window[kCGWindowLayer as String] as? Int, layer < 0 { continue }
+
+        windows.append(WindowEntry(
+            id: (window[kCGWindowNumber as String] as? CGWindowID) ?? 0,
+            title: (window[kCGWindowName as String] as? String) ?? "",
+            owner: (window[kCGWindowOwnerName as String] as? String) ?? "",
+            pid: (window[kCGWindowOwnerPID as String] as? Int) ?? 0,
+            bounds: CGRect(x: wx, y: wy, width: ww, height: wh)
+        ))
+    }
+    return windows
+}
+
+// The topmost window containing point whose pid is not excluded.
+func windowAt(_ point: CGPoint, in windows: [WindowEntry], excluding excludedPids: Set<Int>) -> WindowEntry? {
+    windows.first { $0.bounds.contains(point) && !excludedPids.contains($0.pid) }
+}
+
+func windowFields(_ window: WindowEntry) -> String {
+    let b = window.bounds
+    return "\"title\":\"\(escapeJson(window.title))\",\"process\":\"\(escapeJson(window.owner))\"," +
+        "\"pid\":\(window.pid),\"bounds\":{\"x\":\(Int(b.origin.x)),\"y\":\(Int(b.origin.y))," +
+        "\"width\":\(Int(b.width)),\"height\":\(Int(b.height))}"
+}
+
+// {"results":[...]} aligned with points, from one window list.
+func batchResponse(_ idField: String, _ points: [CGPoint], _ excludedPids: Set<Int>,
+                   _ timings: inout StageTimings) -> String {
+    let windows = timings.time(.resolve) { listWindows() } ?? []
+    var cache: [CGWindowID: String] = [:] // windows hit by several points are formatted once
+    var results: [String] = []
+    results.reserveCapacity(points.count)
+    for point in points {
+        guard let window = windowAt(point, in: windows, excluding: excludedPids) else {
+            results.append("{\"error\":\"no window at point\"}")
+            continue
+        }
+        if let formatted = cache[window.id] {
+            results.append(formatted)
+            continue
+        }
+        let formatted = "{\(windowFields(window))}"
+        cache[window.id] = formatted
+        results.append(formatted)
+    }
+    return "{\(idField)\"results\":[\(results.joined(separator: ","))]\(timings.toJson())}\n"
+}
+
+// MARK: - Capture
+
+enum ImageFormat: String {
+    case png, jpeg, raw
+}
+
+// How the caller wants the screenshot delivered, if at all.
+struct CaptureRequest {
+    var screenshotPath: String? = nil // legacy: write a PNG file here
+    var frame = false                 // stream the image as a binary frame after the JSON line
+    var format = ImageFormat.png
+    var quality = 85                  // jpeg, 0-100
+    var maxWidth = 0                  // 0 = unbounded
+    var maxHeight = 0
+    var scale = 1.0                   // applied before the max-size clamp
+
+    var wantsImage: Bool { frame || screenshotPath != nil }
+    // Screenshot files are always PNG; frames use the requested format.
+    var deliveredFormat: ImageFormat { frame ? format : .png }
+}
+
+// "webp" has no ImageIO encoder on macOS; it is delivered as the other lossy format.
+func parseImageFormat(_ value: String) -> ImageFormat? {
+    value == "webp" ? .jpeg : ImageFormat(rawValue: value)
+}
+
+func clampQuality(_ value: Double) -> Int {
+    Int(min(max(value, 0), 100))
+}
+
+// The output size for request, preserving aspect ratio; never upscales
+// (image_scale.h scaledSize).
+func scaledSize(width: Int, height: Int, _ request: CaptureRequest) -> (width: Int, height: Int) {
+    var factor = request.scale > 0 && request.scale < 1 ? request.scale : 1
+    if request.maxWidth > 0, Double(width) * factor > Double(request.maxWidth) {
+        factor = Double(request.maxWidth) / Double(width)
+    }
+    if request.maxHeight > 0, Double(height) * factor > Double(request.maxHeight) {
+        factor = Double(request.maxHeight) / Double(height)
+    }
+    let outW = min(max(Int(Double(width) * factor + 0.5), 1), width)
+    let outH = min(max(Int(Double(height) * factor + 0.5), 1), height)
+    return (outW, outH)
+}
+
+struct CapturedFrame {
+    let image: CGImage
+    let backend: String
+}
+
+// Completion-handler results handed across the semaphore wait.
+final class Pending<T>: @unchecked Sendable {
+    var value: T?
+}
+
+let CAPTURE_TIMEOUT_MS = 2000
+
+@available(macOS 14.0, *)
+final class ScreenCaptureKitBackend {
+    static let shared = ScreenCaptureKitBackend()
+
+    private var windows: [CGWindowID: SCWindow] = [:]
+
+    // Fetching shareable content costs tens of ms, so the list is kept and
+    // refetched only for a window it does not know.
+    private func refresh() {
+        let fetched = Pending<[SCWindow]>()
+        let done = DispatchSemaphore(value: 0)
+        SCShareableContent.getExcludingDesktopWindows(true, onScreenWindowsOnly: true) { content, _ in
+            fetched.value = content?.windows
+            done.signal()
+        }
+        guard done.wait(timeout: .now() + .milliseconds(CAPTURE_TIMEOUT_MS)) == .success,
+              let list = fetched.value else { return }
+        windows = Dictionary(list.map { ($0.windowID, $0) }, uniquingKeysWith: { first, _ in first })
+    }
+
+    // Just the window's own pixels, at the requested size; nil when it could
+    // not be captured (the caller falls back to CGWindowList).
+    func capture(_ window: WindowEntry, _ request: CaptureRequest) -> CGImage? {
+        if windows[window.id] == nil { refresh() }
+        guard let scWindow = windows[window.id] else { return nil }
+
+        let filter = SCContentFilter(desktopIndependentWindow: scWindow)
+        let pixelScale = CGFloat(filter.pointPixelScale)
+        let size = scaledSize(width: Int(window.bounds.width * pixelScale),
+                              height: Int(window.bounds.height * pixelScale), request)
+        let config = SCStreamConfiguration()
+        config.width = size.width
+        config.height = size.height
+        config.showsCursor = false
+        config.ignoreShadowsSingleWindow = true
+        config.pixelFormat = kCVPixelFormatType_32BGRA
+
+        let captured = Pending<CGImage>()
+        let done = DispatchSemaphore(value: 0)
+        SCScreenshotManager.captureImage(contentFilter: filter, configuration: config) { image, _ in
+            captured.value = image
+            done.signal()
+        }
+        guard done.wait(timeout: .now() + .milliseconds(CAPTURE_TIMEOUT_MS)) == .success,
+              let image = captured.value else {
+            windows[window.id] = nil // possibly stale; refetched next time
+            return nil
+        }
+        return image
+    }
+}
+
+func captureWindow(_ window: WindowEntry, _ request: CaptureRequest) -> CapturedFrame? {
+    guard window.id != 0 else { return nil }
+    if #available(macOS 14.0, *),
+       let image = ScreenCaptureKitBackend.shared.capture(window, request) {
+        return CapturedFrame(image: image, backend: "screencapturekit")
+    }
+    guard let image = CGWindowListCreateImage(.null, .optionIncludingWindow, window.id, [.boundsIgnoreFraming]) else {
+        return nil
+    }
+    return CapturedFrame(image: image, backend: "cgwindowlist")
+}
+
+// Draws image into a top-down BGRA bitmap of width x height.
+func drawBgra(_ image: CGImage, width: Int, height: Int) -> CGContext? {
+    guard let context = CGContext(
+        data: nil,
+        width: width,
+        height: height,
+        bitsPerComponent: 8,
+        bytesPerRow: width * 4,
+        space: CGColorSpace(name: CGColorSpace.sRGB) ?? CGColorSpaceCreateDeviceRGB(),
+        bitmapInfo: CGImageAlphaInfo.premultipliedFirst.rawValue | CGBitmapInfo.byteOrder32Little.rawValue
+    ) else {
+        return nil
+    }
+    context.interpolationQuality = .high
+    context.draw(image, in: CGRect(x: 0, y: 0, width: width, height: height))
+    return context
+}
+
+// Backends that did not scale in the capture are downscaled here.
+func downscale(_ image: CGImage, _ request: CaptureRequest) -> CGImage {
+    let size = scaledSize(width: image.width, height: image.height, request)
+    guard size.width != image.width || size.height != image.height,
+          let scaled = drawBgra(image, width: size.width, height: size.height)?.makeImage() else {
+        return image
+    }
+    return scaled
+}
+
+struct EncodedImage {
+    let format: ImageFormat
+    let width: Int
+    let height: Int
+    let bytes: Data
+}
+
+func encodeImage(_ image: CGImage, _ format: ImageFormat, quality: Int) -> EncodedImage? {
+    if format == .raw {
+        guard let context = drawBgra(image, width: image.width, height: image.height),
+              let pixels = context.data else { return nil }
+        let bytes = Data(bytes: pixels, count: context.bytesPerRow * image.height)
+        return EncodedImage(format: .raw, width: image.width, height: image.height, bytes: bytes)
+    }
+
+    let data = NSMutableData()
+    let type = (format == .jpeg ? "public.jpeg" : "public.png") as CFString
+    guard let destination = CGImageDestinationCreateWithData(data as CFMutableData, type, 1, nil) else { return nil }
+    var properties: [CFString: Any] = [:]
+    if format == .jpeg { properties[kCGImageDestinationLossyCompressionQuality] = Double(quality) / 100 }
+    CGImageDestinationAddImage(destination, image, properties as CFDictionary)
+    guard CGImageDestinationFinalize(destination) else { return nil }
+    return EncodedImage(format: format, width: image.width, height: image.height, bytes: data as Data)
+}
+
+// Captures window and delivers the image: head is the response's leading
+// fields (id, window fields), without braces. Frames announce their length
+// in "image":{"bytes":N} and the bytes follow the line; "image":null means
+// no frame follows.
+func finishCapture(_ head: String, _ window: WindowEntry, _ request: CaptureRequest, _ timings: inout StageTimings) {
+    var encoded: EncodedImage? = nil
+    var backend = ""
+    if let captured = timings.time(.capture, { captureWindow(window, request) }) {
+        backend = captured.backend
+        let image = timings.time(.downscale) { downscale(captured.image, request) }
+        encoded = timings.time(.encode) { encodeImage(image, request.deliveredFormat, quality: request.quality) }
+    }
+
+    if let path = request.screenshotPath, !request.frame {
+        var saved = false
+        if let encoded {
+            saved = timings.time(.save) { (try? encoded.bytes.write(to: URL(fileURLWithPath: path))) != nil }
+        }
+        writeMessage("{\(head),\"screenshot\":\(saved)\(timings.toJson())}\n")
+        return
+    }
+    guard let encoded else {
+        writeMessage("{\(head),\"image\":null\(timings.toJson())}\n")
+        return
+    }
+    let header = ",\"image\":{\"format\":\"\(encoded.format.rawValue)\",\"backend\":\"\(backend)\"," +
+        "\"width\":\(encoded.width),\"height\":\(encoded.height),\"bytes\":\(encoded.bytes.count)}"
+    writeMessage("{\(head)\(header)\(timings.toJson())}\n", encoded.bytes)
+}
+
+// The JSON response for the window at point and, for image requests, the
+// image after it. Progressive requests get the window fields first, marked
+// "partial":true, and {"id":N,"image":...} once the image is encoded.
+func writeWindowResponse(_ idField: String, _ point: CGPoint, _ excludedPids: Set<Int>,
+                         _ request: CaptureRequest, progressive: Bool, _ timings: inout StageTimings) {
+    let windows = timings.time(.resolve) { listWindows() }
+    guard let windows else {
+        writeMessage("{\(idField)\"error\":\"failed to get window list\"}\n")
+        return
+    }
+    guard let window = windowAt(point, in: windows, excluding: excludedPids) else {
+        writeMessage("{\(idField)\"error\":\"no window at point\"}\n")
+        return
+    }
+
+    var head = idField + windowFields(window)
+    guard request.wantsImage else {
+        writeMessage("{\(head)\(timings.toJson())}\n")
+        return
+    }
+    if progressive {
+        writeMessage("{\(head),\"partial\":true}\n")
+        head = String(idField.dropLast()) // drop the trailing comma
+    }
+    finishCapture(head, window, request, &timings)
+}
+
+// MARK: - Server mode
+
+func number(_ value: Any?) -> Double? {
+    guard let value = value as? NSNumber, CFGetTypeID(value) != CFBooleanGetTypeID() else { return nil }
+    return value.doubleValue
+}
+
+func bool(_ value: Any?) -> Bool {
+    guard let value = value as? NSNumber, CFGetTypeID(value) == CFBooleanGetTypeID() else { return false }
+    return value.boolValue
+}
+
+func handleServerRequest(_ request: [String: Any]) {
+    let idField = "\"id\":\(Int64(number(request["id"]) ?? 0)),"
+    func fail(_ error: String) {
+        writeMessage("{\(idField)\"error\":\"\(escapeJson(error))\"}\n")
+    }
+
+    var timings = StageTimings()
+    if bool(request["timings"]) { timings.begin() }
+
+    var excludedPids = Set<Int>()
+    for item in request["excludePids"] as? [Any] ?? [] {
+        if let pid = number(item), pid > 0 { excludedPids.insert(Int(pid)) }
+    }
+
+    if request["space"] != nil, !["dip", "physical"].contains(request["space"] as? String ?? "") {
+        fail("unknown space")
+        return
+    }
+    for field in ["rect", "prefetch", "fromPrefetch", "dropPrefetch"] where request[field] != nil {
+        fail("unsupported")
+        return
+    }
+
+    // "points":[[x,y],...] resolves many points in one window list, metadata only.
+    if let pointList = request["points"] {
+        var points: [CGPoint] = []
+        for item in pointList as? [Any] ?? [] {
+            guard let pair = item as? [Any], pair.count == 2, let px = number(pair[0]), let py = number(pair[1]) else {
+                fail("invalid points")
+                return
             }
+            points.append(CGPoint(x: px, y: py))
+        }
+        if !(pointList is [Any]) {
+            fail("invalid points")
+            return
         }
+        writeMessage(batchResponse(idField, points, excludedPids, &timings))
+        return
     }
 
-    exit(0)
+    var capture = CaptureRequest()
+    capture.screenshotPath = request["screenshot"] as? String
+    capture.frame = bool(request["frame"])
+    if let format = request["format"] {
+        guard let name = format as? String, let parsed = parseImageFormat(name) else {
+            fail("unknown format")
+            return
+        }
+        capture.format = parsed
+    }
+    if let png = request["png"] {
+        guard let mode = png as? String, ["store", "fast", "best"].contains(mode) else {
+            fail("unknown png mode")
+            return
+        }
+    }
+    if let quality = number(request["quality"]) { capture.quality = clampQuality(quality) }
+    capture.maxWidth = Int(number(request["maxWidth"]) ?? 0)
+    capture.maxHeight = Int(number(request["maxHeight"]) ?? 0)
+    capture.scale = number(request["scale"]) ?? 1
+
+    guard let x = number(request["x"]), let y = number(request["y"]) else {
+        fail("missing point")
+        return
+    }
+    writeWindowResponse(idField, CGPoint(x: x, y: y), excludedPids, capture,
+                        progressive: bool(request["progressive"]), &timings)
+}
+
+func runServer() -> Int32 {
+    writeMessage("READY\n")
+    while let line = readLine(strippingNewline: true) {
+        if line.isEmpty { continue }
+        guard let data = line.data(using: .utf8),
+              let request = (try? JSONSerialization.jsonObject(with: data)) as? [String: Any] else {
+            writeMessage("{\"error\":\"invalid request\"}\n")
+            continue
+        }
+        autoreleasepool {
+            handleServerRequest(request)
+        }
+    }
+    return 0
+}
+
+// MARK: - CLI
+
+func argValue(_ args: ArraySlice<String>, _ prefix: String) -> String? {
+    for arg in args where arg.hasPrefix(prefix) {
+        return String(arg.dropFirst(prefix.count))
+    }
+    return nil
+}
+
+func parseExcludedPids(_ args: ArraySlice<String>) -> Set<Int> {
+    var pids = Set<Int>()
+    guard let payload = argValue(args, "--exclude-pids=") else { return pids }
+    for rawValue in payload.split(separator: ",") {
+        let value = rawValue.trimmingCharacters(in: .whitespacesAndNewlines)
+        guard let pid = Int(value), pid > 0 else { continue }
+        pids.insert(pid)
+    }
+    return pids
+}
+
+// Parses "x1,y1;x2,y2;..." from --points=.
+func parsePointsArg(_ value: String) -> [CGPoint]? {
+    var points: [CGPoint] = []
+    for pair in value.split(separator: ";") {
+        let parts = pair.split(separator: ",")
+        guard parts.count == 2, let px = Double(parts[0]), let py = Double(parts[1]) else { return nil }
+        points.append(CGPoint(x: px, y: py))
+    }
+    return points.isEmpty ? nil : points
 }
 
-print("{\"error\":\"no window at point\"}")
+func usage() -> Int32 {
+    fputs("Usage: window_info <x> <y> | --points=x1,y1;x2,y2 | --serve\n", stderr)
+    return 1
+}
+
+func runCli(_ arguments: [String]) -> Int32 {
+    var timings = StageTimings()
+    if arguments.contains("--timings") { timings.begin() }
+    if arguments.contains("--serve") { return runServer() }
+
+    let flags = arguments.dropFirst()
+    let excludedPids = parseExcludedPids(flags)
+    if let value = argValue(flags, "--points=") {
+        guard let points = parsePointsArg(value) else {
+            fputs("Invalid --points\n", stderr)
+            return 1
+        }
+        writeMessage(batchResponse("", points, excludedPids, &timings))
+        return 0
+    }
+
+    guard arguments.count >= 3, let x = Double(arguments[1]), let y = Double(arguments[2]) else { return usage() }
+    let extraArgs = arguments.dropFirst(3)
+
+    var capture = CaptureRequest()
+    if let target = argValue(extraArgs, "--screenshot=") {
+        if target == "-" { capture.frame = true } else { capture.screenshotPath = target }
+    }
+    if let value = argValue(extraArgs, "--format=") {
+        guard let format = parseImageFormat(value) else {
+            fputs("Unknown --format\n", stderr)
+            return 1
+        }
+        capture.format = format
+    }
+    if let value = argValue(extraArgs, "--quality="), let quality = Double(value) {
+        capture.quality = clampQuality(quality)
+    }
+    if let value = argValue(extraArgs, "--max-size=") {
+        let parts = value.split(separator: "x", omittingEmptySubsequences: false)
+        capture.maxWidth = parts.count > 0 ? Int(parts[0]) ?? 0 : 0
+        capture.maxHeight = parts.count > 1 ? Int(parts[1]) ?? 0 : 0
+    }
+    if let value = argValue(extraArgs, "--scale="), let scale = Double(value) { capture.scale = scale }
+
+    writeWindowResponse("", CGPoint(x: x, y: y), excludedPids, capture, progressive: false, &timings)
+    return 0
+}
+
+// ScreenCaptureKit may deliver its completions on the main queue, so the
+// helper runs on its own thread while the main thread serves that queue.
+Thread.detachNewThread {
+    exit(runCli(CommandLine.arguments))
+}
+dispatchMain()
@@ -0,0 +1,327 @@
+// window_info_addon.node - Node-API build of window_info_tool.h for in-process
+// window queries from Electron, without spawning window_info.exe.
+//   getWindowAtPoint(x, y, excludePids?, space?) -> {title, process, pid, bounds,
+//       dipBounds, monitor} | null
+//   captureWindow(x, y, options?) -> Promise<{title, process, pid, bounds, dipBounds,
+//       monitor, image: {format, backend, width, height, data: Buffer}} | null>
+// captureWindow options mirror the server request fields: excludePids,
+// format, quality, png, backend, maxWidth, maxHeight, scale, space. Points
+// are physical unless space is "dip"; Electron itself is per-monitor DPI
+// aware, so the rects are physical here too. Capture and
+// encode run on the libuv thread pool, one at a time (the DXGI session and
+// GDI+ encoders are shared). Lookups walk the live z-order on the calling
+// thread: the WindowIndex hooks skip their own process, which here is
+// Electron itself.
+// Node-API is ABI-stable, so one build loads in any Electron version.
+// Build: node-gyp rebuild (binding.gyp)
+
+#include "window_info_tool.h"
+
+#include <node_api.h>
+
+static SRWLOCK g_captureLock = SRWLOCK_INIT;
+
+#define NAPI_CALL(env, call)                                                  \
+    do                                                                        \
+    {                                                                         \
+        if ((call) != napi_ok)                                                \
+        {                                                                     \
+            napi_throw_error((env), nullptr, "window_info_addon: " #call);    \
+            return nullptr;                                                   \
+        }                                                                     \
+    } while (0)
+
+static napi_value makeString(napi_env env, const std::wstring& value)
+{
+    napi_value result = nullptr;
+    napi_create_string_utf16(env, reinterpret_cast<const char16_t*>(value.c_str()), value.size(), &result);
+    return result;
+}
+
+static napi_value makeString(napi_env env, const std::string& utf8)
+{
+    napi_value result = nullptr;
+    napi_create_string_utf8(env, utf8.c_str(), utf8.size(), &result);
+    return result;
+}
+
+static void setNumber(napi_env env, napi_value object, const char* name, double value)
+{
+    napi_value number = nullptr;
+    napi_create_double(env, value, &number);
+    napi_set_named_property(env, object, name, number);
+}
+
+static napi_value makeRectObject(napi_env env, const RECT& rect)
+{
+    napi_value object = nullptr;
+    napi_create_object(env, &object);
+    setNumber(env, object, "x", rect.left);
+    setNumber(env, object, "y", rect.top);
+    setNumber(env, object, "width", rect.right - rect.left);
+    setNumber(env, object, "height", rect.bottom - rect.top);
+    return object;
+}
+
+static napi_value makeWindowObject(napi_env env, const WindowFields& fields)
+{
+    napi_value object = nullptr;
+    napi_value monitor = nullptr;
+    napi_create_object(env, &object);
+    napi_create_object(env, &monitor);
+    napi_set_named_property(env, object, "title", makeString(env, fields.title));
+    napi_set_named_property(env, object, "process", makeString(env, fields.process));
+    setNumber(env, object, "pid", fields.pid);
+    napi_set_named_property(env, object, "bounds", makeRectObject(env, fields.rect));
+    napi_set_named_property(env, object, "dipBounds", makeRectObject(env, fields.dipRect));
+    napi_set_named_property(env, monitor, "id", makeString(env, fields.monitor.id));
+    setNumber(env, monitor, "dpi", fields.monitor.dpi);
+    setNumber(env, monitor, "scale", fields.monitor.scale);
+    napi_set_named_property(env, monitor, "bounds", makeRectObject(env, fields.monitor.bounds));
+    napi_set_named_property(env, object, "monitor", monitor);
+    return object;
+}
+
+// Physical points truncate; DIP points convert with their fractions.
+static bool readPoint(napi_env env, napi_value* args, size_t argc, POINT& pt, bool dip = false)
+{
+    double x = 0, y = 0;
+    if (argc < 2 || napi_get_value_double(env, args[0], &x) != napi_ok ||
+        napi_get_value_double(env, args[1], &y) != napi_ok)
+    {
+        return false;
+    }
+    if (dip)
+    {
+        pt = dipToPhysical(x, y);
+        return true;
+    }
+    pt.x = static_cast<LONG>(x);
+    pt.y = static_cast<LONG>(y);
+    return true;
+}
+
+// "dip" or "physical" (the default when absent); false for anything else.
+static bool readSpace(napi_env env, napi_value value, bool& dip)
+{
+    napi_valuetype type = napi_undefined;
+    if (!value || napi_typeof(env, value, &type) != napi_ok || type == napi_undefined || type == napi_null)
+        return true;
+    char buffer[16] = {};
+    size_t length = 0;
+    if (napi_get_value_string_utf8(env, value, buffer, sizeof(buffer), &length) != napi_ok) return false;
+    dip = strcmp(buffer, "dip") == 0;
+    return dip || strcmp(buffer, "physical") == 0;
+}
+
+static void readExcludedPids(napi_env env, napi_value value, std::vector<DWORD>& excluded)
+{
+    bool isArray = false;
+    if (!value || napi_is_array(env, value, &isArray) != napi_ok || !isArray) return;
+    uint32_t length = 0;
+    napi_get_array_length(env, value, &length);
+    for (uint32_t i = 0; i < length; ++i)
+    {
+        napi_value item = nullptr;
+        double pid = 0;
+        if (napi_get_element(env, value, i, &item) == napi_ok &&
+            napi_get_value_double(env, item, &pid) == napi_ok && pid > 0)
+        {
+            excluded.push_back(static_cast<DWORD>(pid));
+        }
+    }
+}
+
+static napi_value getProperty(napi_env env, napi_value object, const char* name)
+{
+    bool has = false;
+    napi_value value = nullptr;
+    if (!object || napi_has_named_property(env, object, name, &has) != napi_ok || !has) return nullptr;
+    napi_get_named_property(env, object, name, &value);
+    napi_valuetype type = napi_undefined;
+    napi_typeof(env, value, &type);
+    return type == napi_undefined || type == napi_null ? nullptr : value;
+}
+
+static bool getStringProperty(napi_env env, napi_value object, const char* name, std::string& out)
+{
+    napi_value value = getProperty(env, object, name);
+    if (!value) return false;
+    char buffer[64] = {};
+    size_t length = 0;
+    if (napi_get_value_string_utf8(env, value, buffer, sizeof(buffer), &length) != napi_ok) return false;
+    out.assign(buffer, length);
+    return true;
+}
+
+static bool getNumberProperty(napi_env env, napi_value object, const char* name, double& out)
+{
+    napi_value value = getProperty(env, object, name);
+    return value && napi_get_value_double(env, value, &out) == napi_ok;
+}
+
+static napi_value getWindowAtPoint(napi_env env, napi_callback_info info)
+{
+    size_t argc = 4;
+    napi_value args[4] = {};
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    bool dip = false;
+    if (argc >= 4 && !readSpace(env, args[3], dip))
+    {
+        napi_throw_range_error(env, nullptr, "unknown space");
+        return nullptr;
+    }
+    POINT pt;
+    if (!readPoint(env, args, argc, pt, dip))
+    {
+        napi_throw_type_error(env, nullptr, "getWindowAtPoint(x, y, excludePids?, space?) expects numbers");
+        return nullptr;
+    }
+    std::vector<DWORD> excluded;
+    if (argc >= 3) readExcludedPids(env, args[2], excluded);
+
+    napi_value result = nullptr;
+    HWND hwnd = resolveWindowAtPoint(pt, excluded);
+    if (!hwnd)
+    {
+        NAPI_CALL(env, napi_get_null(env, &result));
+        return result;
+    }
+    return makeWindowObject(env, readWindowFields(hwnd));
+}
+
+struct CaptureWork
+{
+    napi_async_work work = nullptr;
+    napi_deferred deferred = nullptr;
+    POINT pt = {};
+    std::vector<DWORD> excluded;
+    CaptureBackend backend = BackendPrintWindow;
+    ResizeOptions resize;
+    EncodeOptions encode;
+
+    // Results, filled on the worker thread.
+    bool found = false;
+    bool captured = false;
+    WindowFields fields;
+    CaptureBackend used = BackendPrintWindow;
+    EncodedImage image;
+};
+
+static void executeCapture(napi_env, void* data)
+{
+    CaptureWork* work = static_cast<CaptureWork*>(data);
+    HWND hwnd = resolveWindowAtPoint(work->pt, work->excluded);
+    if (!hwnd) return;
+    work->found = true;
+    work->fields = readWindowFields(hwnd);
+
+    AcquireSRWLockExclusive(&g_captureLock);
+    work->captured = ensureGdiplus() &&
+                     captureWindowImage(hwnd, work->backend, work->resize, work->encode, work->image, work->used);
+    ReleaseSRWLockExclusive(&g_captureLock);
+}
+
+static void completeCapture(napi_env env, napi_status status, void* data)
+{
+    CaptureWork* work = static_cast<CaptureWork*>(data);
+    napi_value result = nullptr;
+    if (status != napi_ok || !work->found)
+    {
+        napi_get_null(env, &result);
+    }
+    else
+    {
+        result = makeWindowObject(env, work->fields);
+        napi_value image = nullptr;
+        if (work->captured)
+        {
+            napi_create_object(env, &image);
+            napi_value format = nullptr, backend = nullptr, buffer = nullptr;
+            void* bytes = nullptr;
+            napi_create_string_utf8(env, imageFormatName(work->image.format), NAPI_AUTO_LENGTH, &format);
+            napi_create_string_utf8(env, captureBackendName(work->used), NAPI_AUTO_LENGTH, &backend);
+            napi_create_buffer_copy(env, work->image.bytes.size(), work->image.bytes.data(), &bytes, &buffer);
+            napi_set_named_property(env, image, "format", format);
+            napi_set_named_property(env, image, "backend", backend);
+            setNumber(env, image, "width", work->image.width);
+            setNumber(env, image, "height", work->image.height);
+            napi_set_named_property(env, image, "data", buffer);
+        }
+        else
+        {
+            napi_get_null(env, &image);
+        }
+        napi_set_named_property(env, result, "image", image);
+    }
+    napi_resolve_deferred(env, work->deferred, result);
+    napi_delete_async_work(env, work->work);
+    delete work;
+}
+
+static napi_value captureWindow(napi_env env, napi_callback_info info)
+{
+    size_t argc = 3;
+    napi_value args[3] = {};
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, nullptr, nullptr));
+
+    CaptureWork* work = new CaptureWork;
+    if (!readPoint(env, args, argc, work->pt))
+    {
+        delete work;
+        napi_throw_type_error(env, nullptr, "captureWindow(x, y, options?) expects numbers");
+        return nullptr;
+    }
+
+    napi_value options = argc >= 3 ? args[2] : nullptr;
+    readExcludedPids(env, getProperty(env, options, "excludePids"), work->excluded);
+    std::string text;
+    const char* invalid = nullptr;
+    if (getStringProperty(env, options, "format", text) && !parseImageFormat(text.c_str(), work->encode.format))
+        invalid = "unknown format";
+    if (getStringProperty(env, options, "png", text) && !parsePngMode(text.c_str(), work->encode.png))
+        invalid = "unknown png mode";
+    if (getStringProperty(env, options, "backend", text) && !parseCaptureBackend(text.c_str(), work->backend))
+        invalid = "unknown backend";
+    bool dip = false;
+    if (!readSpace(env, getProperty(env, options, "space"), dip)) invalid = "unknown space";
+    if (invalid)
+    {
+        delete work;
+        napi_throw_range_error(env, nullptr, invalid);
+        return nullptr;
+    }
+    double number = 0;
+    if (getNumberProperty(env, options, "quality", number)) work->encode.quality = clampQuality(number);
+    if (getNumberProperty(env, options, "maxWidth", number)) work->resize.maxWidth = static_cast<int>(number);
+    if (getNumberProperty(env, options, "maxHeight", number)) work->resize.maxHeight = static_cast<int>(number);
+    if (getNumberProperty(env, options, "scale", number)) work->resize.scale = number;
+    work->encode.threads = defaultEncodeThreads();
+    if (dip) readPoint(env, args, argc, work->pt, true);
+
+    napi_value promise = nullptr;
+    napi_value name = nullptr;
+    if (napi_create_promise(env, &work->deferred, &promise) != napi_ok ||
+        napi_create_string_utf8(env, "captureWindow", NAPI_AUTO_LENGTH, &name) != napi_ok ||
+        napi_create_async_work(env, nullptr, name, executeCapture, completeCapture, work, &work->work) != napi_ok ||
+        napi_queue_async_work(env, work->work) != napi_ok)
+    {
+        delete work;
+        napi_throw_error(env, nullptr, "window_info_addon: failed to queue capture");
+        return nullptr;
+    }
+    return promise;
+}
+
+static napi_value init(napi_env env, napi_value exports)
+{
+    napi_property_descriptor properties[] = {
+        {"getWindowAtPoint", nullptr, getWindowAtPoint, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"captureWindow", nullptr, captureWindow, nullptr, nullptr, nullptr, napi_default, nullptr},
+    };
+    NAPI_CALL(env, napi_define_properties(env, exports, sizeof(properties) / sizeof(properties[0]), properties));
+    return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
@@ -0,0 +1,1455 @@
+// window_info_tool.h - JSON info (and captures) of the window at a screen point.
+// Runs as window_info.exe (window_info.cpp) or, for --serve and --watch, as a
+// stella_native_host channel; runWindowInfo is the entry point either way.
+// The request protocol is shared with the macOS build (window_info.swift) and
+// specified in docs/WINDOW_INFO_PROTOCOL.md; keep the two in step.
+// Usage: window_info.exe <x> <y> [--exclude-pids=1,2,3] [--screenshot=path.png|-]
+//                        [--format=png|jpeg|webp|raw] [--quality=0-100] [--png=store|fast|best]
+//                        [--max-size=WxH] [--scale=0.5] [--backend=printwindow|dxgi] [--dip] [--timings]
+//                        [--visible-region] [--mask-occluded] [--tree[=depth]] [--uia [--uia-budget=ms]]
+//        window_info.exe --points=x1,y1;x2,y2;... [--exclude-pids=1,2,3] [--dip] [--timings]
+//        window_info.exe --rect=x,y,w,h [--screenshot=...] [--format=...] [--backend=...] [--dip] ...
+//        window_info.exe --serve
+//        window_info.exe --watch [--exclude-pids=1,2,3]
+// Output: {"title":"...","process":"...","pid":123,"bounds":{"x":0,"y":0,"width":800,"height":600},
+//          "dipBounds":{...},"monitor":{"id":"\\\\.\\DISPLAY1","dpi":144,"scale":1.5,"bounds":{...}}}
+//
+// Points and "bounds" are physical pixels (the helpers are per-monitor DPI
+// aware, monitor_dpi.h). "dipBounds" is the same rect in DIPs at the scale
+// of the window's monitor. --dip, or "space":"dip" on a server request,
+// takes the query points in DIPs instead, as Electron reports them.
+//
+// Server mode (--serve) stays resident like mouse_block.exe: it prints READY,
+// then answers one JSON request per stdin line with one JSON response line on
+// stdout until stdin closes. GDI+ and encoder CLSIDs are set up at most once.
+//   Request:  {"id":1,"x":100,"y":200,"excludePids":[1,2],"screenshot":"C:\\tmp\\a.png"}
+//   Response: {"id":1,"title":"...","process":"...","pid":123,"bounds":{...},"screenshot":true}
+//             {"id":1,"error":"no window at point"}
+//
+// Image frames (--screenshot=- or "frame":true) skip the temp file: the JSON
+// line carries "image":{"format":"png","width":W,"height":H,"bytes":N} and
+// exactly N image bytes follow it on stdout ("image":null = no frame).
+// "format":"raw" sends top-down BGRA (stride = width * 4) with no encode.
+// Server requests take the same encoder options as fields: "format",
+// "quality", "png", "maxWidth", "maxHeight", "scale". Encoders live in
+// image_encode.h; downscaling (never upscaling) in image_scale.h. The
+// "image" width/height describe the delivered image, "bounds" the window.
+// "backend":"dxgi" captures via Desktop Duplication (capture_dxgi.h) and
+// falls back to PrintWindow; the image header names the backend used.
+// Server captures are pipelined: the request thread resolves and captures,
+// an encode pool (encode_pool.h) downscales, encodes and writes the reply,
+// and large PNGs deflate in parallel stripes. Replies to image requests can
+// therefore arrive out of request order; match them by "id". With
+// "progressive":true the window fields are sent as soon as the window is
+// resolved, as {"id":N,...,"partial":true}, and {"id":N,"image":{...}} (or
+// "screenshot") follows once the image is encoded.
+// "diff":true frame requests are compared with the window's last frame by
+// tile hash (frame_diff.h). The client lists the request ids whose frames it
+// still holds in "diffBase"; against one of those the reply is either
+// "unchanged":true with no image, or an image of just the changed area with
+// its placement. Diff replies carry the window's "hwnd".
+// "visibleRegion":true (--visible-region) adds "visible":[[x,y,w,h],...],
+// the parts of the window's rect on screen that no window above it covers
+// (visible_region.h); "maskOccluded":true (--mask-occluded) also paints the
+// covered parts of the capture black before it is downscaled and encoded.
+// --tree[=depth] ("tree":depth or true) adds "tree":[...], the window's
+// child HWNDs down to depth (4 by default) as one flat array from a single
+// EnumChildWindows walk: class, bounds, visibility and parent index each
+// (window_tree.h).
+// --uia ("uia":true, "uiaBudgetMs") adds "uia":{...}, the text of the
+// focused element, its selection and the element at the point, read through
+// UI Automation under a time budget (uia_text.h). Server mode keeps one
+// IUIAutomation for all requests.
+// "prefetch":true captures the window at the point ahead of time (when a
+// gesture starts, while the user is still choosing) and holds the pixels
+// without encoding; the reply is {"id":N,"hwnd":H,"prefetched":true}. A later
+// "fromPrefetch":true frame request is answered from them, with
+// "prefetchAgeMs", if it resolves to the same window, asks for the same
+// backend, comes within "prefetchMaxAgeMs" (PREFETCH_MAX_AGE_MS) and no
+// top-level window has moved, restacked or changed visibility in between;
+// otherwise it fails with "no prefetch" and the caller captures live. The
+// held frame is used up by the first "fromPrefetch" either way, and
+// "dropPrefetch":true releases it. Prefetching is PrintWindow only: a DXGI
+// frame taken mid-gesture would show the gesture's own overlays.
+// Rect captures (--rect=, or "rect":[x,y,w,h] in server mode) copy that
+// part of the virtual desktop, whatever windows are on it, with the same
+// encoder options: one BitBlt from the screen DC ("backend":"bitblt"), or
+// the DXGI session with "backend":"dxgi". The reply carries the captured
+// "rect" (clipped to the desktop) instead of window fields.
+// --timings, or "timings":true on a server request, adds "timings":{...}
+// with the microseconds spent per stage (stage_timings.h) to the final
+// response line of the request.
+// Batch queries (--points=, or "points":[[x,y],...] in server mode) resolve
+// every point in one z-order walk and answer {"results":[...]} with one
+// entry per point, in order; each entry is the usual object or an error.
+// Point lookups in server mode use the WinEvent-invalidated snapshot in
+// window_index.h instead of walking every top-level window per request.
+// Watch mode (--watch) streams the foreground window like mouse_block.exe
+// streams clicks: READY, then one JSON line per change until stdin closes.
+//   {"event":"foreground"|"title"|"bounds","title":...,"process":...,"pid":...,"bounds":{...}}
+//   {"event":"closed"}  (the tracked foreground window was destroyed)
+// Foreground changes to excluded pids are ignored, so the last external
+// window stays current while our own UI has focus.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstring>
+
+#include <dwmapi.h>
+
+#include "capture_dxgi.h"
+#include "dib_pool.h"
+#include "encode_pool.h"
+#include "frame_diff.h"
+#include "image_encode.h"
+#include "image_scale.h"
+
+#pragma comment(lib, "dwmapi.lib")
+#include "json_reader.h"
+#include "json_writer.h"
+#include "stage_timings.h"
+#include "tool_context.h"
+#include "uia_text.h"
+#include "visible_region.h"
+#include "window_query.h"
+#include "window_tree.h"
+
+// Streams of the run on this thread. Hosted, --serve and --watch run on
+// separate threads of one process, each with its own channel.
+static thread_local ToolContext g_infoIo;
+
+// Server mode only: idle DIB sections kept between captures. Without it each
+// capture gets its own section, freed with the image. Like g_infoIo, this and
+// the other per-server state below are thread_local: hosted, two servers may
+// run at once, and each owns what its runServer set up.
+static thread_local DibPool* g_dibPool = nullptr;
+
+// A DIB section of at least w x h, from the pool in server mode. The lease
+// returns it to the pool (or frees it) once the last image holding it is gone.
+static DibSurface* acquireSurface(int w, int h, std::shared_ptr<void>& lease)
+{
+    DibPool* pool = g_dibPool;
+    DibSurface* surface = pool ? pool->acquire(w, h) : DibPool::create(w, h);
+    if (!surface) return nullptr;
+    lease.reset(surface, [pool](void* p) {
+        DibSurface* released = static_cast<DibSurface*>(p);
+        if (pool) pool->release(released);
+        else DibPool::destroy(released);
+    });
+    return surface;
+}
+
+// Points image at the top-left w x h of a surface GDI has drawn into.
+static void borrowSurface(DibSurface* surface, const std::shared_ptr<void>& lease, int w, int h,
+                          CapturedImage& image)
+{
+    // GDI may batch drawing; the CPU reads the bits directly from here on.
+    GdiFlush();
+
+    // GDI leaves the alpha byte undefined (usually 0); consumers treat the
+    // buffer as BGRA, so make it opaque.
+    const size_t stride = surface->stride();
+    for (int y = 0; y < h; ++y)
+    {
+        BYTE* px = surface->bits + stride * y;
+        for (int x = 0; x < w; ++x)
+        {
+            px[x * 4 + 3] = 0xFF;
+        }
+    }
+
+    image.width = w;
+    image.height = h;
+    image.pixels.clear();
+    image.view = surface->bits;
+    image.viewStride = stride;
+    image.lease = lease;
+}
+
+// Renders hwnd into a DIB section; image borrows the section's pixels.
+static bool captureWindowPrintWindow(HWND hwnd, CapturedImage& image)
+{
+    RECT rect = {};
+    GetWindowRect(hwnd, &rect);
+    int w = rect.right - rect.left;
+    int h = rect.bottom - rect.top;
+    if (w <= 0 || h <= 0) return false;
+
+    std::shared_ptr<void> lease;
+    DibSurface* surface = acquireSurface(w, h, lease);
+    if (!surface) return false;
+
+    // A reused section still holds the last capture; start from black like
+    // a fresh bitmap in case the window leaves parts unpainted.
+    PatBlt(surface->dc, 0, 0, w, h, BLACKNESS);
+
+    // PW_RENDERFULLCONTENT (0x2) captures the full window including DWM-composited content
+    BOOL ok = PrintWindow(hwnd, surface->dc, 2);
+    if (!ok)
+    {
+        // Fallback: try without PW_RENDERFULLCONTENT
+        ok = PrintWindow(hwnd, surface->dc, 0);
+    }
+    if (!ok) return false;
+    borrowSurface(surface, lease, w, h, image);
+    image.origin.x = rect.left;
+    image.origin.y = rect.top;
+    return true;
+}
+
+// Copies a rect of the virtual desktop (physical pixels) in one BitBlt from
+// the screen DC. CAPTUREBLT includes layered windows such as tooltips.
+static bool captureScreenBitBlt(const RECT& rect, CapturedImage& image)
+{
+    const int w = rect.right - rect.left;
+    const int h = rect.bottom - rect.top;
+    if (w <= 0 || h <= 0) return false;
+
+    std::shared_ptr<void> lease;
+    DibSurface* surface = acquireSurface(w, h, lease);
+    if (!surface) return false;
+    HDC screen = GetDC(NULL);
+    if (!screen) return false;
+    const BOOL ok = BitBlt(surface->dc, 0, 0, w, h, screen, rect.left, rect.top, SRCCOPY | CAPTUREBLT);
+    ReleaseDC(NULL, screen);
+    if (!ok) return false;
+    borrowSurface(surface, lease, w, h, image);
+    image.origin.x = rect.left;
+    image.origin.y = rect.top;
+    return true;
+}
+
+enum CaptureBackend
+{
+    BackendPrintWindow, // asks the window to render itself; works when covered
+    BackendDxgi,        // copies the composed desktop; works for GPU-composited apps
+    BackendBitBlt,      // screen rects only: one BitBlt from the screen DC
+};
+
+static const char* captureBackendName(CaptureBackend backend)
+{
+    switch (backend)
+    {
+    case BackendDxgi:   return "dxgi";
+    case BackendBitBlt: return "bitblt";
+    default:            return "printwindow";
+    }
+}
+
+static bool parseCaptureBackend(const char* value, CaptureBackend& backend)
+{
+    if (strcmp(value, "printwindow") == 0) { backend = BackendPrintWindow; return true; }
+    if (strcmp(value, "dxgi") == 0)        { backend = BackendDxgi;        return true; }
+    return false;
+}
+
+// Kept alive for the whole process so server mode reuses one warm session.
+static DxgiCapture g_dxgi;
+
+static bool captureWindowDxgi(HWND hwnd, CapturedImage& image)
+{
+    // A minimized window is not on screen; only PrintWindow can render it.
+    if (IsIconic(hwnd)) return false;
+
+    // Extended frame bounds exclude the invisible resize borders and are in
+    // physical pixels, matching the duplicated desktop.
+    RECT rect = {};
+    if (FAILED(DwmGetWindowAttribute(hwnd, DWMWA_EXTENDED_FRAME_BOUNDS, &rect, sizeof(rect))))
+    {
+        GetWindowRect(hwnd, &rect);
+    }
+    return g_dxgi.capture(rect, image);
+}
+
+// Captures with the requested backend, falling back to PrintWindow.
+static bool captureWindowPixels(HWND hwnd, CaptureBackend requested, CapturedImage& image,
+                                CaptureBackend& used)
+{
+    if (requested == BackendDxgi && captureWindowDxgi(hwnd, image))
+    {
+        used = BackendDxgi;
+        return true;
+    }
+    used = BackendPrintWindow;
+    return captureWindowPrintWindow(hwnd, image);
+}
+
+static bool captureWindowPixels(HWND hwnd, CaptureBackend requested, CapturedImage& image, CaptureBackend& used,
+                                StageTimings& timings)
+{
+    StageTimer timer(timings, StageTimings::Capture);
+    return captureWindowPixels(hwnd, requested, image, used);
+}
+
+// Screen rect captures: DXGI when requested, otherwise (and as its fallback)
+// BitBlt. PrintWindow has no meaning for a rect, so it selects BitBlt too.
+static bool captureScreenRect(const RECT& rect, CaptureBackend requested, CapturedImage& image,
+                              CaptureBackend& used)
+{
+    if (requested == BackendDxgi && g_dxgi.capture(rect, image))
+    {
+        used = BackendDxgi;
+        return true;
+    }
+    used = BackendBitBlt;
+    return captureScreenBitBlt(rect, image);
+}
+
+// Clips rect to the virtual desktop; false when nothing of it is on screen.
+static bool clipToVirtualScreen(const RECT& rect, RECT& clipped)
+{
+    RECT desktop;
+    desktop.left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+    desktop.top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    desktop.right = desktop.left + GetSystemMetrics(SM_CXVIRTUALSCREEN);
+    desktop.bottom = desktop.top + GetSystemMetrics(SM_CYVIRTUALSCREEN);
+    return IntersectRect(&clipped, &rect, &desktop) != FALSE;
+}
+
+// Downscaling reads borrowed pixels in place and leaves owned ones behind.
+// False when the image already fits.
+static bool downscaleCapture(CapturedImage& image, const ResizeOptions& resize)
+{
+    if (!downscaleBgra(image.data(), image.stride(), image.width, image.height, resize, image.pixels))
+    {
+        return false;
+    }
+    image.releaseView();
+    return true;
+}
+
+// Timed into the downscale stage only when it resized anything.
+static void downscaleCapture(CapturedImage& image, const ResizeOptions& resize, StageTimings& timings)
+{
+    const int64_t start = timings.enabled ? qpcNow() : 0;
+    if (downscaleCapture(image, resize)) timings.add(StageTimings::Downscale, start, qpcNow());
+}
+
+// Timed into the GDI+ stage when the format goes through GDI+.
+static bool prepareEncoder(const EncodeOptions& options, StageTimings& timings)
+{
+    if (!usesGdiplus(options)) return prepareEncoder(options);
+    StageTimer timer(timings, StageTimings::Gdiplus);
+    return prepareEncoder(options);
+}
+
+static bool captureWindowImage(HWND hwnd, CaptureBackend backend, const ResizeOptions& resize,
+                               const EncodeOptions& options, EncodedImage& out, CaptureBackend& used)
+{
+    CapturedImage image;
+    if (!captureWindowPixels(hwnd, backend, image, used)) return false;
+    downscaleCapture(image, resize);
+    return encodeImage(image, options, out);
+}
+
+static bool writeFileUtf8Path(const char* utf8Path, const std::vector<BYTE>& bytes)
+{
+    int wideLen = MultiByteToWideChar(CP_UTF8, 0, utf8Path, -1, NULL, 0);
+    if (wideLen <= 0) return false;
+    std::vector<wchar_t> widePath(wideLen);
+    MultiByteToWideChar(CP_UTF8, 0, utf8Path, -1, widePath.data(), wideLen);
+
+    HANDLE file = CreateFileW(widePath.data(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    DWORD written = 0;
+    BOOL ok = WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written, NULL);
+    CloseHandle(file);
+    return ok && written == bytes.size();
+}
+
+// Only set in server mode; one-shot CLI queries walk the live z-order.
+static thread_local WindowIndex* g_windowIndex = nullptr;
+
+// Server mode only: encode workers, and the stripe threads each PNG may use.
+static thread_local EncodePool* g_encodePool = nullptr;
+static thread_local int g_encodeThreads = 1;
+
+// Server mode only: tile hashes of the last frame sent per window.
+static thread_local FrameCache* g_frameCache = nullptr;
+
+static const int PREFETCH_MAX_AGE_MS = 3000;
+
+// A "prefetch" capture held for the "fromPrefetch" request that confirms it.
+struct PrefetchedFrame
+{
+    HWND hwnd = NULL;
+    RECT bounds = {};           // window rect when captured
+    CapturedImage image;        // as captured, not masked or downscaled
+    CaptureBackend used = BackendPrintWindow;
+    std::vector<RECT> visible;  // the window's visible region when captured
+    int64_t capturedAt = 0;     // QPC ticks
+};
+
+// Server mode only: the one held prefetch, touched by the request thread only.
+static thread_local PrefetchedFrame* g_prefetch = nullptr;
+
+// Encode workers and the request thread both write responses, so each
+// message (JSON line plus any frame bytes) goes out whole under this lock.
+static SRWLOCK g_responseLock = SRWLOCK_INIT;
+
+static void writeMessage(FILE* out, const std::string& line, const std::vector<BYTE>* bytes = nullptr)
+{
+    AcquireSRWLockExclusive(&g_responseLock);
+    fwrite(line.data(), 1, line.size(), out);
+    if (bytes && !bytes->empty()) fwrite(bytes->data(), 1, bytes->size(), out);
+    fflush(out);
+    ReleaseSRWLockExclusive(&g_responseLock);
+}
+
+// How the caller wants the screenshot delivered, if at all.
+struct CaptureRequest
+{
+    std::string screenshotPath; // legacy: write a PNG file here
+    bool frame = false;         // stream the image as a binary frame after the JSON line
+    CaptureBackend backend = BackendPrintWindow;
+    ResizeOptions resize;
+    EncodeOptions encode;
+    bool diff = false;                // server: compare with this window's last frame
+    std::vector<long long> diffBases; // request ids of frames the client still holds
+    bool visibleRegion = false;       // report the uncovered parts of the window
+    bool maskOccluded = false;        // paint covered parts of the capture black
+    std::vector<DWORD> excludedPids;  // their windows never count as cover
+    int treeDepth = 0;                // > 0: add the child window tree to this depth
+    bool uia = false;                 // add UI Automation text (focused element, selection, at point)
+    int uiaBudgetMs = UIA_DEFAULT_BUDGET_MS;
+    POINT point = {};                 // the query point, physical
+};
+
+static bool wantsVisibleRegion(const CaptureRequest& capture)
+{
+    return capture.visibleRegion || capture.maskOccluded;
+}
+
+// The parts of hwnd's rect on screen that no non-excluded window covers.
+static void computeWindowVisibleRegion(HWND hwnd, const CaptureRequest& capture, std::vector<RECT>& visible)
+{
+    RECT bounds = {};
+    GetWindowRect(hwnd, &bounds);
+    computeVisibleRegion(hwnd, bounds, capture.excludedPids, g_windowIndex, visible);
+}
+
+// Appends "visible":[[x,y,w,h],...] (screen coordinates).
+static void appendVisibleRegion(std::string& head, const std::vector<RECT>& visible)
+{
+    head += ",\"visible\":[";
+    for (size_t i = 0; i < visible.size(); ++i)
+    {
+        const RECT& r = visible[i];
+        char entry[64];
+        snprintf(entry, sizeof(entry), "%s[%ld,%ld,%ld,%ld]", i ? "," : "", r.left, r.top, r.right - r.left,
+                 r.bottom - r.top);
+        head += entry;
+    }
+    head += ']';
+}
+
+// Window fields beyond the basic ones that a request asked for. visible is
+// computed here unless it already holds the region (prefetched frames).
+static void appendRequestedFields(std::string& head, HWND hwnd, const CaptureRequest& capture,
+                                  std::vector<RECT>& visible, StageTimings& timings, bool visibleKnown = false)
+{
+    if (wantsVisibleRegion(capture))
+    {
+        if (!visibleKnown) computeWindowVisibleRegion(hwnd, capture, visible);
+        appendVisibleRegion(head, visible);
+    }
+    if (capture.treeDepth > 0) appendChildTree(head, hwnd, capture.treeDepth);
+    if (capture.uia)
+    {
+        StageTimer timer(timings, StageTimings::Uia);
+        appendUiaText(head, capture.point, capture.uiaBudgetMs);
+    }
+}
+
+// "maskOccluded": blacks out what the user cannot see, before any downscale.
+static void maskCapture(CapturedImage& image, const CaptureRequest& capture, const std::vector<RECT>& visible,
+                        StageTimings& timings)
+{
+    if (!capture.maskOccluded) return;
+    StageTimer timer(timings, StageTimings::Mask);
+    maskOutsideRegion(image.mutableData(), image.stride(), image.width, image.height, image.origin, visible);
+}
+
+static bool wantsImage(const CaptureRequest& capture)
+{
+    return capture.frame || !capture.screenshotPath.empty();
+}
+
+// Screenshot files are always PNG; frames use the requested format.
+static EncodeOptions deliveredEncodeOptions(const CaptureRequest& capture)
+{
+    EncodeOptions options = capture.encode;
+    if (!capture.frame) options.format = FormatPng;
+    return options;
+}
+
+// Second stage of a capture: downscale, encode and deliver the pixels.
+// head is the response's leading fields (id, window fields), without braces;
+// imageFields is appended inside "image". Frames announce their length in
+// "image":{"bytes":N} and the bytes follow the line; "image":null means no
+// frame follows. Enabled timings close the response.
+static void finishCapture(FILE* out, const std::string& head, CapturedImage& image, bool captured,
+                          CaptureBackend used, const CaptureRequest& capture, StageTimings& timings,
+                          const std::string& imageFields = std::string())
+{
+    EncodedImage encoded;
+    bool ok = false;
+    if (captured)
+    {
+        downscaleCapture(image, capture.resize, timings);
+        const EncodeOptions options = deliveredEncodeOptions(capture);
+        prepareEncoder(options, timings);
+        StageTimer timer(timings, StageTimings::Encode);
+        ok = encodeImage(image, options, encoded);
+    }
+
+    if (!capture.frame)
+    {
+        bool saved = false;
+        if (ok)
+        {
+            StageTimer timer(timings, StageTimings::Save);
+            saved = writeFileUtf8Path(capture.screenshotPath.c_str(), encoded.bytes);
+        }
+        writeMessage(out, "{" + head + ",\"screenshot\":" + (saved ? "true" : "false") + timings.toJson() + "}\n");
+        return;
+    }
+    if (!ok)
+    {
+        writeMessage(out, "{" + head + ",\"image\":null" + timings.toJson() + "}\n");
+        return;
+    }
+
+    char header[192];
+    snprintf(header, sizeof(header),
+             ",\"image\":{\"format\":\"%s\",\"backend\":\"%s\",\"width\":%d,\"height\":%d,\"bytes\":%lu",
+             imageFormatName(encoded.format), captureBackendName(used), encoded.width, encoded.height,
+             static_cast<unsigned long>(encoded.bytes.size()));
+    writeMessage(out, "{" + head + header + imageFields + "}" + timings.toJson() + "}\n", &encoded.bytes);
+}
+
+// Writes the JSON response for hwnd and, for frame requests, the image bytes
+// immediately after it, all on the calling thread.
+static void writeWindowResponse(const std::string& idField, HWND hwnd, const CaptureRequest& capture,
+                                StageTimings& timings)
+{
+    std::string head = idField + formatWindowFields(hwnd, &timings);
+    std::vector<RECT> visible;
+    appendRequestedFields(head, hwnd, capture, visible, timings);
+    if (!wantsImage(capture))
+    {
+        writeMessage(g_infoIo.out, "{" + head + timings.toJson() + "}\n");
+        return;
+    }
+
+    CapturedImage image;
+    CaptureBackend used = BackendPrintWindow;
+    const bool captured = captureWindowPixels(hwnd, capture.backend, image, used, timings);
+    if (captured) maskCapture(image, capture, visible, timings);
+    finishCapture(g_infoIo.out, head, image, captured, used, capture, timings);
+}
+
+// Encoder settings a cached frame must share for a diff against it to be
+// usable by the client.
+static uint64_t encodeSignature(const EncodeOptions& options)
+{
+    return static_cast<uint64_t>(options.format) | static_cast<uint64_t>(options.png) << 8 |
+           static_cast<uint64_t>(options.quality) << 16;
+}
+
+// "diff":true frame requests. Downscales the capture here (the hashes are of
+// the delivered pixels) and compares it with the last frame of hwnd, if the
+// client still holds that frame ("diffBase":[ids]). Returns false after
+// answering {"id":N,...,"hwnd":H,"unchanged":true,"base":B}. When the bounding
+// box of the dirty tiles covers less than half the frame, image is cropped to
+// it and imageFields gets its placement:
+//   "x","y","frameWidth","frameHeight","base":B,"dirty":[[x,y,w,h],...]
+// Otherwise the whole frame is sent as usual.
+static bool diffWithLastFrame(FILE* out, std::string& head, long long requestId, HWND hwnd,
+                              CapturedImage& image, const CaptureRequest& capture, std::string& imageFields,
+                              StageTimings& timings)
+{
+    downscaleCapture(image, capture.resize, timings);
+    StageTimer timer(timings, StageTimings::Diff);
+    head += ",\"hwnd\":" + std::to_string(static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(hwnd)));
+
+    FrameDiff diff;
+    g_frameCache->update(reinterpret_cast<uintptr_t>(hwnd), requestId, encodeSignature(deliveredEncodeOptions(capture)),
+                         image.data(), image.stride(), image.width, image.height, capture.diffBases, diff);
+    if (!diff.hasBase) return true;
+    if (diff.unchanged)
+    {
+        writeMessage(out, "{" + head + ",\"unchanged\":true,\"base\":" + std::to_string(diff.baseId) +
+                              timings.toJson() + "}\n");
+        return false;
+    }
+    const size_t total = static_cast<size_t>(image.width) * image.height;
+    const size_t boxPixels = static_cast<size_t>(diff.bounds.width()) * diff.bounds.height();
+    if (boxPixels * 2 >= total) return true;
+
+    char placement[128];
+    snprintf(placement, sizeof(placement), ",\"x\":%d,\"y\":%d,\"frameWidth\":%d,\"frameHeight\":%d,\"base\":%lld",
+             diff.bounds.left, diff.bounds.top, image.width, image.height, diff.baseId);
+    imageFields = placement;
+    imageFields += ",\"dirty\":[";
+    for (size_t i = 0; i < diff.runs.size(); ++i)
+    {
+        const TileRect& run = diff.runs[i];
+        char entry[64];
+        snprintf(entry, sizeof(entry), "%s[%d,%d,%d,%d]", i ? "," : "", run.left, run.top, run.width(), run.height());
+        imageFields += entry;
+    }
+    imageFields += ']';
+
+    std::vector<BYTE> cropped;
+    cropBgra(image.data(), image.stride(), diff.bounds, cropped);
+    image.pixels.swap(cropped);
+    image.releaseView();
+    image.width = diff.bounds.width();
+    image.height = diff.bounds.height();
+    return true;
+}
+
+// Server-mode response: captures here, then hands downscale, encode and
+// delivery to the encode pool so the next request can be captured meanwhile.
+// Progressive requests get the window fields first, marked "partial":true,
+// and a second {"id":N,"image":...} (or "screenshot") message when the
+// encode finishes. A prefetched frame stands in for the capture.
+static void submitWindowResponse(const std::string& idField, long long requestId, HWND hwnd,
+                                 const CaptureRequest& capture, bool progressive, StageTimings& timings,
+                                 PrefetchedFrame* prefetched = nullptr)
+{
+    FILE* out = g_infoIo.out;
+    std::string head = idField + formatWindowFields(hwnd, &timings);
+    std::vector<RECT> visible;
+    if (prefetched)
+    {
+        head += ",\"prefetchAgeMs\":" +
+                std::to_string(static_cast<unsigned long long>(qpcToMicros(qpcNow() - prefetched->capturedAt) / 1000));
+        visible.swap(prefetched->visible);
+    }
+    appendRequestedFields(head, hwnd, capture, visible, timings, prefetched != nullptr);
+    if (!wantsImage(capture))
+    {
+        writeMessage(out, "{" + head + timings.toJson() + "}\n");
+        return;
+    }
+    if (progressive)
+    {
+        writeMessage(out, "{" + head + ",\"partial\":true}\n");
+        head = idField.substr(0, idField.size() - 1); // drop the trailing comma
+    }
+
+    CapturedImage image;
+    CaptureBackend used = BackendPrintWindow;
+    bool captured = true;
+    if (prefetched)
+    {
+        image = std::move(prefetched->image);
+        used = prefetched->used;
+    }
+    else
+    {
+        captured = captureWindowPixels(hwnd, capture.backend, image, used, timings);
+    }
+    if (captured) maskCapture(image, capture, visible, timings);
+    std::string imageFields;
+    CaptureRequest deliver = capture;
+    if (captured && capture.frame && capture.diff && g_frameCache)
+    {
+        if (!diffWithLastFrame(out, head, requestId, hwnd, image, capture, imageFields, timings)) return;
+        deliver.resize = ResizeOptions(); // already downscaled, maybe cropped
+    }
+    if (!captured || !g_encodePool || !prepareEncoder(deliveredEncodeOptions(deliver), timings))
+    {
+        finishCapture(out, head, image, captured, used, deliver, timings, imageFields);
+        return;
+    }
+    g_encodePool->submit([out, head, image = std::move(image), used, deliver, timings, imageFields]() mutable {
+        finishCapture(out, head, image, true, used, deliver, timings, imageFields);
+    });
+}
+
+// Screen rect captures ({"rect":[x,y,w,h]} or --rect=): the reply carries
+// the captured "rect" (clipped to the virtual desktop) in place of the window
+// fields. In server mode the encode runs on the pool like window captures.
+static void writeRectResponse(const std::string& idField, const RECT& requested, const CaptureRequest& capture,
+                              StageTimings& timings)
+{
+    FILE* out = g_infoIo.out;
+    RECT rect;
+    if (!clipToVirtualScreen(requested, rect))
+    {
+        writeMessage(out, "{" + idField + "\"error\":\"rect off screen\"}\n");
+        return;
+    }
+    const std::string head = idField + "\"rect\":" + formatRect(rect);
+    if (!wantsImage(capture))
+    {
+        writeMessage(out, "{" + head + timings.toJson() + "}\n");
+        return;
+    }
+
+    CapturedImage image;
+    CaptureBackend used = BackendBitBlt;
+    bool captured;
+    {
+        StageTimer timer(timings, StageTimings::Capture);
+        captured = captureScreenRect(rect, capture.backend, image, used);
+    }
+    if (!captured || !g_encodePool || !prepareEncoder(deliveredEncodeOptions(capture), timings))
+    {
+        finishCapture(out, head, image, captured, used, capture, timings);
+        return;
+    }
+    g_encodePool->submit([out, head, image = std::move(image), used, capture, timings]() mutable {
+        finishCapture(out, head, image, true, used, capture, timings);
+    });
+}
+
+// DIP rects convert corner by corner (monitor_dpi.h).
+static RECT rectFromDip(double x, double y, double w, double h)
+{
+    const POINT topLeft = dipToPhysical(x, y);
+    const POINT bottomRight = dipToPhysical(x + w, y + h);
+    RECT rect = {topLeft.x, topLeft.y, bottomRight.x, bottomRight.y};
+    return rect;
+}
+
+// One JSON line with a results array aligned to points. Windows hit by
+// several points are formatted once and copied for the repeats.
+static void writeBatchResponse(const std::string& idField, const std::vector<POINT>& points,
+                               const std::vector<DWORD>& excludedPids, StageTimings& timings)
+{
+    std::vector<HWND> found;
+    {
+        StageTimer timer(timings, StageTimings::Resolve);
+        resolveWindowsAtPoints(points, excludedPids, found, g_windowIndex);
+    }
+
+    struct Formatted
+    {
+        HWND hwnd;
+        size_t offset; // of the object in out
+        size_t length;
+    };
+    std::vector<Formatted> formatted;
+    std::string out;
+    JsonWriter json(out, 64 + points.size() * 384);
+    json.raw('{').raw(idField).key("results").raw('[');
+    for (size_t i = 0; i < found.size(); ++i)
+    {
+        if (i) json.raw(',');
+        if (!found[i])
+        {
+            json.raw("{\"error\":\"no window at point\"}");
+            continue;
+        }
+
+        const Formatted* repeat = nullptr;
+        for (const Formatted& entry : formatted)
+        {
+            if (entry.hwnd == found[i]) repeat = &entry;
+        }
+        if (repeat)
+        {
+            // Reserved first, so the source stays valid while appending.
+            out.reserve(out.size() + repeat->length);
+            out.append(out.data() + repeat->offset, repeat->length);
+            continue;
+        }
+        const size_t offset = out.size();
+        json.raw('{');
+        writeWindowFields(json, found[i], &timings);
+        json.raw('}');
+        formatted.push_back(Formatted{found[i], offset, out.size() - offset});
+    }
+    json.raw(']').raw(timings.toJson()).raw("}\n");
+    writeMessage(g_infoIo.out, out);
+}
+
+// Parses "x1,y1;x2,y2;..." from --points=. Coordinates stay doubles until
+// the caller knows whether they are DIPs, which may be fractional.
+static bool parsePointsArg(const char* value, std::vector<std::pair<double, double>>& points)
+{
+    const char* p = value;
+    while (*p)
+    {
+        char* end = nullptr;
+        const double x = strtod(p, &end);
+        if (end == p || *end != ',') return false;
+        p = end + 1;
+        const double y = strtod(p, &end);
+        if (end == p) return false;
+        points.emplace_back(x, y);
+        p = end;
+        if (*p == ';') ++p;
+        else if (*p) return false;
+    }
+    return !points.empty();
+}
+
+// Parses "x,y,w,h" from --rect=; w and h must be positive.
+static bool parseRectArg(const char* value, double rect[4])
+{
+    const char* p = value;
+    for (int i = 0; i < 4; ++i)
+    {
+        char* end = nullptr;
+        rect[i] = strtod(p, &end);
+        if (end == p || (i < 3 && *end != ',') || (i == 3 && *end)) return false;
+        p = end + 1;
+    }
+    return rect[2] > 0 && rect[3] > 0;
+}
+
+static bool readLine(std::string& line)
+{
+    line.clear();
+    char chunk[4096];
+    while (fgets(chunk, sizeof(chunk), g_infoIo.in))
+    {
+        line += chunk;
+        if (!line.empty() && line.back() == '\n')
+        {
+            line.pop_back();
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            return true;
+        }
+    }
+    return !line.empty();
+}
+
+static void writeServerError(const char* idField, const char* error)
+{
+    std::string out;
+    JsonWriter json(out, 96);
+    json.raw('{').raw(idField).key("error").string(error).raw("}\n");
+    writeMessage(g_infoIo.out, out);
+}
+
+// "prefetch":true: captures hwnd now and holds the pixels, with its visible
+// region, in place of any earlier prefetch. Nothing is encoded yet.
+static void holdPrefetchedFrame(const char* idField, HWND hwnd, const CaptureRequest& capture,
+                                StageTimings& timings)
+{
+    *g_prefetch = PrefetchedFrame();
+    if (capture.backend != BackendPrintWindow)
+    {
+        writeServerError(idField, "prefetch needs printwindow");
+        return;
+    }
+
+    PrefetchedFrame frame;
+    frame.hwnd = hwnd;
+    GetWindowRect(hwnd, &frame.bounds);
+    computeWindowVisibleRegion(hwnd, capture, frame.visible);
+    if (!captureWindowPixels(hwnd, capture.backend, frame.image, frame.used, timings))
+    {
+        writeServerError(idField, "capture failed");
+        return;
+    }
+    frame.capturedAt = qpcNow();
+    *g_prefetch = std::move(frame);
+    writeMessage(g_infoIo.out, std::string("{") + idField + "\"hwnd\":" +
+                                   std::to_string(static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(hwnd))) +
+                                   ",\"prefetched\":true" + timings.toJson() + "}\n");
+}
+
+// Whether frame can stand in for a live capture of hwnd: same window and
+// backend, younger than maxAgeMs, same rect, and covered by the same windows
+// as when it was captured. Only the target is checked: windows of
+// capture.excludedPids (the caller's own overlays, shown and hidden around
+// every gesture) and changes elsewhere on screen do not count. The index
+// trails WinEvents by a few ms, so a change that recent can slip through.
+static bool prefetchUsable(const PrefetchedFrame& frame, HWND hwnd, const CaptureRequest& capture, int maxAgeMs)
+{
+    if (!frame.hwnd || frame.hwnd != hwnd || capture.backend != BackendPrintWindow) return false;
+    if (qpcToMicros(qpcNow() - frame.capturedAt) >= static_cast<uint64_t>(maxAgeMs) * 1000) return false;
+    RECT bounds = {};
+    if (!GetWindowRect(hwnd, &bounds) || !EqualRect(&bounds, &frame.bounds)) return false;
+
+    std::vector<RECT> visible;
+    computeVisibleRegion(hwnd, bounds, capture.excludedPids, g_windowIndex, visible);
+    if (visible.size() != frame.visible.size()) return false;
+    for (size_t i = 0; i < visible.size(); ++i)
+    {
+        if (!EqualRect(&visible[i], &frame.visible[i])) return false;
+    }
+    return true;
+}
+
+static void handleServerRequest(const JsonValue& request)
+{
+    char idField[32];
+    snprintf(idField, sizeof(idField), "\"id\":%lld,", static_cast<long long>(request.numberOr("id", 0)));
+    StageTimings timings;
+    if (request.boolOr("timings", false)) timings.begin();
+
+    std::vector<DWORD> excludedPids;
+    const JsonValue* exclude = request.find("excludePids");
+    if (exclude && exclude->isArray())
+    {
+        for (const JsonValue& item : exclude->items)
+        {
+            if (item.isNumber() && item.number > 0)
+            {
+                excludedPids.push_back(static_cast<DWORD>(item.number));
+            }
+        }
+    }
+
+    const char* space = request.stringOr("space", nullptr);
+    if (space && strcmp(space, "dip") != 0 && strcmp(space, "physical") != 0)
+    {
+        writeServerError(idField, "unknown space");
+        return;
+    }
+    const bool dip = space && strcmp(space, "dip") == 0;
+
+    if (request.boolOr("dropPrefetch", false))
+    {
+        *g_prefetch = PrefetchedFrame();
+        writeMessage(g_infoIo.out, std::string("{") + idField + "\"dropped\":true}\n");
+        return;
+    }
+
+    // "points":[[x,y],...] resolves many points in one walk, metadata only.
+    const JsonValue* pointList = request.find("points");
+    if (pointList && pointList->isArray())
+    {
+        std::vector<POINT> points;
+        for (const JsonValue& item : pointList->items)
+        {
+            if (!item.isArray() || item.items.size() != 2 || !item.items[0].isNumber() || !item.items[1].isNumber())
+            {
+                writeServerError(idField, "invalid points");
+                return;
+            }
+            POINT pt;
+            pt.x = static_cast<LONG>(item.items[0].number);
+            pt.y = static_cast<LONG>(item.items[1].number);
+            points.push_back(dip ? dipToPhysical(item.items[0].number, item.items[1].number) : pt);
+        }
+        writeBatchResponse(idField, points, excludedPids, timings);
+        return;
+    }
+
+    CaptureRequest capture;
+    capture.screenshotPath = request.stringOr("screenshot", "");
+    capture.frame = request.boolOr("frame", false);
+    const char* format = request.stringOr("format", nullptr);
+    if (format && !parseImageFormat(format, capture.encode.format))
+    {
+        writeServerError(idField, "unknown format");
+        return;
+    }
+    const char* png = request.stringOr("png", nullptr);
+    if (png && !parsePngMode(png, capture.encode.png))
+    {
+        writeServerError(idField, "unknown png mode");
+        return;
+    }
+    const char* backend = request.stringOr("backend", nullptr);
+    if (backend && !parseCaptureBackend(backend, capture.backend))
+    {
+        writeServerError(idField, "unknown backend");
+        return;
+    }
+    capture.encode.quality = clampQuality(request.numberOr("quality", capture.encode.quality));
+    capture.resize.maxWidth = static_cast<int>(request.numberOr("maxWidth", 0));
+    capture.resize.maxHeight = static_cast<int>(request.numberOr("maxHeight", 0));
+    capture.resize.scale = request.numberOr("scale", 1.0);
+    capture.encode.threads = g_encodeThreads;
+    capture.diff = request.boolOr("diff", false);
+    capture.visibleRegion = request.boolOr("visibleRegion", false);
+    capture.maskOccluded = request.boolOr("maskOccluded", false);
+    capture.excludedPids = excludedPids;
+    const JsonValue* tree = request.find("tree");
+    if (tree && tree->isNumber()) capture.treeDepth = static_cast<int>(tree->number);
+    else if (request.boolOr("tree", false)) capture.treeDepth = TREE_DEFAULT_DEPTH;
+    capture.uia = request.boolOr("uia", false);
+    capture.uiaBudgetMs = static_cast<int>(request.numberOr("uiaBudgetMs", UIA_DEFAULT_BUDGET_MS));
+    const JsonValue* bases = request.find("diffBase");
+    if (bases && bases->isArray())
+    {
+        for (const JsonValue& item : bases->items)
+        {
+            if (item.isNumber()) capture.diffBases.push_back(static_cast<long long>(item.number));
+        }
+    }
+
+    // "rect":[x,y,w,h] captures that part of the desktop instead of a window.
+    const JsonValue* rectList = request.find("rect");
+    if (rectList)
+    {
+        double v[4] = {};
+        bool valid = rectList->isArray() && rectList->items.size() == 4;
+        for (size_t i = 0; valid && i < 4; ++i)
+        {
+            valid = rectList->items[i].isNumber();
+            if (valid) v[i] = rectList->items[i].number;
+        }
+        if (!valid || v[2] <= 0 || v[3] <= 0)
+        {
+            writeServerError(idField, "invalid rect");
+            return;
+        }
+        RECT rect = {static_cast<LONG>(v[0]), static_cast<LONG>(v[1]), static_cast<LONG>(v[0] + v[2]),
+                     static_cast<LONG>(v[1] + v[3])};
+        writeRectResponse(idField, dip ? rectFromDip(v[0], v[1], v[2], v[3]) : rect, capture, timings);
+        return;
+    }
+
+    const JsonValue* px = request.find("x");
+    const JsonValue* py = request.find("y");
+    if (!px || !px->isNumber() || !py || !py->isNumber())
+    {
+        writeServerError(idField, "missing point");
+        return;
+    }
+
+    POINT pt;
+    pt.x = static_cast<LONG>(px->number);
+    pt.y = static_cast<LONG>(py->number);
+    if (dip) pt = dipToPhysical(px->number, py->number);
+    capture.point = pt;
+
+    HWND hwnd;
+    {
+        StageTimer timer(timings, StageTimings::Resolve);
+        hwnd = resolveWindowAtPoint(pt, excludedPids, g_windowIndex);
+    }
+    if (!hwnd)
+    {
+        writeServerError(idField, "no window at point");
+        return;
+    }
+
+    if (request.boolOr("prefetch", false))
+    {
+        holdPrefetchedFrame(idField, hwnd, capture, timings);
+        return;
+    }
+
+    const long long requestId = static_cast<long long>(request.numberOr("id", 0));
+    const bool progressive = request.boolOr("progressive", false);
+    if (request.boolOr("fromPrefetch", false))
+    {
+        PrefetchedFrame frame = std::move(*g_prefetch);
+        *g_prefetch = PrefetchedFrame(); // used up, hit or miss
+        const int maxAgeMs = static_cast<int>(request.numberOr("prefetchMaxAgeMs", PREFETCH_MAX_AGE_MS));
+        if (!wantsImage(capture) || !prefetchUsable(frame, hwnd, capture, maxAgeMs))
+        {
+            writeServerError(idField, "no prefetch");
+            return;
+        }
+        submitWindowResponse(idField, requestId, hwnd, capture, progressive, timings, &frame);
+        return;
+    }
+
+    submitWindowResponse(idField, requestId, hwnd, capture, progressive, timings);
+}
+
+static int runServer()
+{
+    // Frames carry raw bytes; text mode would expand every 0x0A into CRLF.
+    _setmode(_fileno(g_infoIo.out), _O_BINARY);
+
+    // Hosted, the host's index is already running and shared with other tools.
+    WindowIndex index;
+    if (g_infoIo.index)
+    {
+        g_windowIndex = g_infoIo.index;
+    }
+    else
+    {
+        index.start();
+        g_windowIndex = &index;
+    }
+
+    // Two workers: one frame encoding while the next is captured. Each PNG
+    // encode also stripes across cores, sized so both workers' stripes fit.
+    const int encodeWorkers = 2;
+    EncodePool pool;
+    pool.start(encodeWorkers);
+    g_encodePool = &pool;
+    g_encodeThreads = defaultEncodeThreads(encodeWorkers);
+    FrameCache frameCache;
+    g_frameCache = &frameCache;
+    DibPool dibPool;
+    g_dibPool = &dibPool;
+    PrefetchedFrame prefetch;
+    g_prefetch = &prefetch;
+
+    writeMessage(g_infoIo.out, "READY\n");
+
+    std::string line;
+    while (readLine(line))
+    {
+        if (line.empty()) continue;
+
+        JsonValue request;
+        JsonReader reader(line.c_str());
+        if (!reader.parse(request) || !request.isObject())
+        {
+            writeMessage(g_infoIo.out, "{\"error\":\"invalid request\"}\n");
+        }
+        else
+        {
+            handleServerRequest(request);
+        }
+    }
+
+    // Queued encodes still owe their responses before stdout is closed.
+    pool.stop();
+    g_encodePool = nullptr;
+    g_frameCache = nullptr;
+    g_prefetch = nullptr;
+    g_dibPool = nullptr;
+    if (g_windowIndex == &index) index.stop();
+    g_windowIndex = nullptr;
+    releaseUiAutomation();
+    if (!g_infoIo.hosted) shutdownGdiplus();
+    return 0;
+}
+
+// --watch state. WinEvent callbacks run on the main thread's message loop.
+static HWND g_watchForeground = NULL;
+static std::vector<DWORD> g_watchExcludedPids;
+static DWORD g_watchThreadId = 0;
+static const UINT_PTR WATCH_BOUNDS_TIMER_ID = 1;
+static const UINT WATCH_BOUNDS_DELAY_MS = 50; // coalesces drag/resize bursts
+
+static void emitWatchEvent(const char* event, HWND hwnd)
+{
+    if (hwnd)
+    {
+        fprintf(g_infoIo.out, "{\"event\":\"%s\",%s}\n", event, formatWindowFields(hwnd).c_str());
+    }
+    else
+    {
+        fprintf(g_infoIo.out, "{\"event\":\"%s\"}\n", event);
+    }
+    fflush(g_infoIo.out);
+}
+
+static void CALLBACK onWatchBoundsTimer(HWND, UINT, UINT_PTR id, DWORD)
+{
+    KillTimer(NULL, id);
+    if (g_watchForeground) emitWatchEvent("bounds", g_watchForeground);
+}
+
+static void setWatchForeground(HWND hwnd)
+{
+    if (!hwnd) return;
+    HWND root = GetAncestor(hwnd, GA_ROOT);
+    if (root) hwnd = root;
+
+    // Our own windows (the chat UI) are not context; keep the previous one.
+    DWORD pid = 0;
+    GetWindowThreadProcessId(hwnd, &pid);
+    if (isPidExcluded(pid, g_watchExcludedPids)) return;
+
+    g_watchForeground = hwnd;
+    emitWatchEvent("foreground", hwnd);
+}
+
+static void CALLBACK onWatchEvent(HWINEVENTHOOK, DWORD event, HWND hwnd, LONG idObject, LONG idChild,
+                                  DWORD, DWORD)
+{
+    if (event == EVENT_SYSTEM_FOREGROUND)
+    {
+        setWatchForeground(hwnd);
+        return;
+    }
+    if (!hwnd || hwnd != g_watchForeground || idObject != OBJID_WINDOW || idChild != CHILDID_SELF) return;
+
+    switch (event)
+    {
+    case EVENT_OBJECT_NAMECHANGE:
+        emitWatchEvent("title", hwnd);
+        break;
+    case EVENT_OBJECT_LOCATIONCHANGE:
+        SetTimer(NULL, WATCH_BOUNDS_TIMER_ID, WATCH_BOUNDS_DELAY_MS, onWatchBoundsTimer);
+        break;
+    case EVENT_OBJECT_DESTROY:
+        g_watchForeground = NULL;
+        emitWatchEvent("closed", NULL);
+        break;
+    }
+}
+
+// Exits the watch loop when the parent closes our stdin (or dies).
+static DWORD WINAPI watchStdinThread(LPVOID in)
+{
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), static_cast<FILE*>(in)))
+    {
+    }
+    PostThreadMessageW(g_watchThreadId, WM_QUIT, 0, 0);
+    return 0;
+}
+
+static int runWatch()
+{
+    g_watchThreadId = GetCurrentThreadId();
+
+    // Ensure the queue exists before the stdin thread can post WM_QUIT.
+    MSG msg;
+    PeekMessageW(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+
+    const DWORD flags = WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS;
+    HWINEVENTHOOK hooks[] = {
+        SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, NULL, onWatchEvent, 0, 0, flags),
+        SetWinEventHook(EVENT_OBJECT_DESTROY, EVENT_OBJECT_DESTROY, NULL, onWatchEvent, 0, 0, flags),
+        // LOCATIONCHANGE and NAMECHANGE are adjacent event ids.
+        SetWinEventHook(EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_NAMECHANGE, NULL, onWatchEvent, 0, 0, flags),
+    };
+    for (HWINEVENTHOOK hook : hooks)
+    {
+        if (!hook)
+        {
+            fprintf(stderr, "Failed to install event hook: %lu\n", GetLastError());
+            return 1;
+        }
+    }
+
+    fprintf(g_infoIo.out, "READY\n");
+    fflush(g_infoIo.out);
+    setWatchForeground(GetForegroundWindow());
+
+    HANDLE stdinThread = CreateThread(NULL, 0, watchStdinThread, g_infoIo.in, 0, NULL);
+    if (stdinThread) CloseHandle(stdinThread);
+
+    while (GetMessageW(&msg, NULL, 0, 0) > 0)
+    {
+        DispatchMessageW(&msg);
+    }
+
+    for (HWINEVENTHOOK hook : hooks)
+    {
+        UnhookWinEvent(hook);
+    }
+    fprintf(g_infoIo.out, "EXIT\n");
+    fflush(g_infoIo.out);
+    return 0;
+}
+
+// Options shared by point and --rect captures, from argv[first] on.
+static bool parseCaptureArgs(int argc, char* argv[], int first, std::vector<DWORD>& excludedPids,
+                             CaptureRequest& capture, bool& dip)
+{
+    for (int i = first; i < argc; ++i)
+    {
+        parseExcludePidsArg(argv[i], excludedPids);
+        if (strcmp(argv[i], "--dip") == 0) dip = true;
+        if (strcmp(argv[i], "--visible-region") == 0) capture.visibleRegion = true;
+        if (strcmp(argv[i], "--mask-occluded") == 0) capture.maskOccluded = true;
+        if (strcmp(argv[i], "--tree") == 0) capture.treeDepth = TREE_DEFAULT_DEPTH;
+        if (strncmp(argv[i], "--tree=", 7) == 0) capture.treeDepth = atoi(argv[i] + 7);
+        if (strcmp(argv[i], "--uia") == 0) capture.uia = true;
+        if (strncmp(argv[i], "--uia-budget=", 13) == 0) capture.uiaBudgetMs = atoi(argv[i] + 13);
+        const char* ssPrefix = "--screenshot=";
+        size_t ssPrefixLen = strlen(ssPrefix);
+        if (strncmp(argv[i], ssPrefix, ssPrefixLen) == 0)
+        {
+            const char* target = argv[i] + ssPrefixLen;
+            // "-" streams the image to stdout instead of touching disk
+            if (strcmp(target, "-") == 0) capture.frame = true;
+            else capture.screenshotPath = target;
+        }
+        const char* formatPrefix = "--format=";
+        size_t formatPrefixLen = strlen(formatPrefix);
+        if (strncmp(argv[i], formatPrefix, formatPrefixLen) == 0 &&
+            !parseImageFormat(argv[i] + formatPrefixLen, capture.encode.format))
+        {
+            fprintf(stderr, "Unknown format: %s\n", argv[i] + formatPrefixLen);
+            return false;
+        }
+        const char* pngPrefix = "--png=";
+        size_t pngPrefixLen = strlen(pngPrefix);
+        if (strncmp(argv[i], pngPrefix, pngPrefixLen) == 0 &&
+            !parsePngMode(argv[i] + pngPrefixLen, capture.encode.png))
+        {
+            fprintf(stderr, "Unknown png mode: %s\n", argv[i] + pngPrefixLen);
+            return false;
+        }
+        const char* qualityPrefix = "--quality=";
+        size_t qualityPrefixLen = strlen(qualityPrefix);
+        if (strncmp(argv[i], qualityPrefix, qualityPrefixLen) == 0)
+        {
+            capture.encode.quality = clampQuality(atof(argv[i] + qualityPrefixLen));
+        }
+        const char* backendPrefix = "--backend=";
+        size_t backendPrefixLen = strlen(backendPrefix);
+        if (strncmp(argv[i], backendPrefix, backendPrefixLen) == 0 &&
+            !parseCaptureBackend(argv[i] + backendPrefixLen, capture.backend))
+        {
+            fprintf(stderr, "Unknown backend: %s\n", argv[i] + backendPrefixLen);
+            return false;
+        }
+        const char* maxSizePrefix = "--max-size=";
+        size_t maxSizePrefixLen = strlen(maxSizePrefix);
+        if (strncmp(argv[i], maxSizePrefix, maxSizePrefixLen) == 0)
+        {
+            // WxH; either side may be 0 for "unbounded"
+            char* end = nullptr;
+            capture.resize.maxWidth = static_cast<int>(strtol(argv[i] + maxSizePrefixLen, &end, 10));
+            if (end && (*end == 'x' || *end == 'X'))
+            {
+                capture.resize.maxHeight = static_cast<int>(strtol(end + 1, nullptr, 10));
+            }
+        }
+        const char* scalePrefix = "--scale=";
+        size_t scalePrefixLen = strlen(scalePrefix);
+        if (strncmp(argv[i], scalePrefix, scalePrefixLen) == 0)
+        {
+            capture.resize.scale = atof(argv[i] + scalePrefixLen);
+        }
+    }
+
+    if (capture.frame)
+    {
+        _setmode(_fileno(g_infoIo.out), _O_BINARY);
+    }
+    capture.encode.threads = defaultEncodeThreads();
+    capture.excludedPids = excludedPids;
+    return true;
+}
+
+static bool hasArg(int argc, char* argv[], const char* flag)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], flag) == 0) return true;
+    }
+    return false;
+}
+
+static int runWindowInfo(int argc, char* argv[], const ToolContext& context)
+{
+    g_infoIo = context;
+    StageTimings timings;
+    if (hasArg(argc, argv, "--timings")) timings.begin();
+
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0)
+    {
+        return runServer();
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--watch") == 0)
+    {
+        g_watchExcludedPids.clear();
+        for (int i = 2; i < argc; ++i)
+        {
+            parseExcludePidsArg(argv[i], g_watchExcludedPids);
+        }
+        return runWatch();
+    }
+
+    const char* pointsPrefix = "--points=";
+    size_t pointsPrefixLen = strlen(pointsPrefix);
+    if (argc >= 2 && strncmp(argv[1], pointsPrefix, pointsPrefixLen) == 0)
+    {
+        std::vector<std::pair<double, double>> coords;
+        if (!parsePointsArg(argv[1] + pointsPrefixLen, coords))
+        {
+            fprintf(stderr, "Invalid points: %s\n", argv[1] + pointsPrefixLen);
+            return 1;
+        }
+        std::vector<DWORD> excludedPids;
+        bool dip = false;
+        for (int i = 2; i < argc; ++i)
+        {
+            parseExcludePidsArg(argv[i], excludedPids);
+            if (strcmp(argv[i], "--dip") == 0) dip = true;
+        }
+        std::vector<POINT> points;
+        points.reserve(coords.size());
+        for (const auto& coord : coords)
+        {
+            if (dip)
+            {
+                points.push_back(dipToPhysical(coord.first, coord.second));
+            }
+            else
+            {
+                POINT pt;
+                pt.x = static_cast<LONG>(coord.first);
+                pt.y = static_cast<LONG>(coord.second);
+                points.push_back(pt);
+            }
+        }
+        writeBatchResponse("", points, excludedPids, timings);
+        fflush(g_infoIo.out);
+        return 0;
+    }
+
+    const char* rectPrefix = "--rect=";
+    size_t rectPrefixLen = strlen(rectPrefix);
+    if (argc >= 2 && strncmp(argv[1], rectPrefix, rectPrefixLen) == 0)
+    {
+        double v[4];
+        if (!parseRectArg(argv[1] + rectPrefixLen, v))
+        {
+            fprintf(stderr, "Invalid rect: %s\n", argv[1] + rectPrefixLen);
+            return 1;
+        }
+        std::vector<DWORD> excludedPids;
+        CaptureRequest capture;
+        bool dip = false;
+        if (!parseCaptureArgs(argc, argv, 2, excludedPids, capture, dip)) return 1;
+        RECT rect = {static_cast<LONG>(v[0]), static_cast<LONG>(v[1]), static_cast<LONG>(v[0] + v[2]),
+                     static_cast<LONG>(v[1] + v[3])};
+        writeRectResponse("", dip ? rectFromDip(v[0], v[1], v[2], v[3]) : rect, capture, timings);
+        fflush(g_infoIo.out);
+        shutdownGdiplus();
+        return 0;
+    }
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: window_info <x> <y>\n");
+        return 1;
+    }
+
+    POINT pt;
+    pt.x = atol(argv[1]);
+    pt.y = atol(argv[2]);
+
+    std::vector<DWORD> excludedPids;
+    CaptureRequest capture;
+
+    bool dip = false;
+    if (!parseCaptureArgs(argc, argv, 3, excludedPids, capture, dip)) return 1;
+    if (dip) pt = dipToPhysical(atof(argv[1]), atof(argv[2]));
+    capture.point = pt;
+
+    HWND hwnd;
+    {
+        StageTimer timer(timings, StageTimings::Resolve);
+        hwnd = resolveWindowAtPoint(pt, excludedPids, g_windowIndex);
+    }
+    if (!hwnd)
+    {
+        fprintf(g_infoIo.out, "{\"error\":\"no window at point\"}\n");
+        return 0;
+    }
+
+    writeWindowResponse("", hwnd, capture, timings);
+    fflush(g_infoIo.out);
+    if (capture.uia) releaseUiAutomation();
+    shutdownGdiplus();
+    return 0;
+}
@@ -0,0 +1,255 @@
+// window_query.h - Window-at-point lookup and JSON formatting shared by the
+// Windows native helpers (window_info.exe, and mouse_block.exe --emit-window).
+// Header-only so each helper stays a single translation unit (see build.ps1).
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "json_writer.h"
+#include "monitor_dpi.h"
+#include "process_cache.h"
+#include "stage_timings.h"
+#include "window_index.h"
+
+static bool isPidExcluded(DWORD pid, const std::vector<DWORD>& excluded)
+{
+    for (DWORD value : excluded)
+    {
+        if (value == pid)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void parseExcludePidsArg(const char* arg, std::vector<DWORD>& excluded)
+{
+    const char* prefix = "--exclude-pids=";
+    const size_t prefixLen = strlen(prefix);
+    if (strncmp(arg, prefix, prefixLen) != 0)
+    {
+        return;
+    }
+
+    const char* p = arg + prefixLen;
+    while (*p)
+    {
+        while (*p == ',' || *p == ' ')
+        {
+            ++p;
+        }
+        if (!*p)
+        {
+            break;
+        }
+
+        char* end = nullptr;
+        unsigned long pid = strtoul(p, &end, 10);
+        if (end == p)
+        {
+            break;
+        }
+        if (pid > 0)
+        {
+            excluded.push_back(static_cast<DWORD>(pid));
+        }
+        p = end;
+        while (*p && *p != ',')
+        {
+            ++p;
+        }
+    }
+}
+
+// Resolves every point in one walk of the z-order. found[i] stays NULL for
+// points not covered by any eligible top-level window.
+static void findTopLevelWindowsAtPoints(const std::vector<POINT>& points, const std::vector<DWORD>& excludedPids,
+                                        std::vector<HWND>& found)
+{
+    size_t remaining = points.size();
+    for (HWND hwnd = GetTopWindow(NULL); hwnd && remaining; hwnd = GetWindow(hwnd, GW_HWNDNEXT))
+    {
+        if (!IsWindowVisible(hwnd))
+        {
+            continue;
+        }
+
+        RECT rect = {};
+        if (!GetWindowRect(hwnd, &rect))
+        {
+            continue;
+        }
+        if (rect.right <= rect.left || rect.bottom <= rect.top)
+        {
+            continue;
+        }
+
+        DWORD pid = 0;
+        bool pidKnown = false;
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            const POINT& pt = points[i];
+            if (found[i]) continue;
+            if (pt.x < rect.left || pt.x >= rect.right || pt.y < rect.top || pt.y >= rect.bottom)
+            {
+                continue;
+            }
+
+            if (!pidKnown)
+            {
+                GetWindowThreadProcessId(hwnd, &pid);
+                pidKnown = true;
+            }
+            if (isPidExcluded(pid, excludedPids))
+            {
+                break;
+            }
+
+            found[i] = hwnd;
+            --remaining;
+        }
+    }
+}
+
+static HWND fallbackWindowAtPoint(POINT pt, const std::vector<DWORD>& excludedPids)
+{
+    // Fallback: WindowFromPoint can find child/nested windows that the
+    // top-level z-order walk misses, but we must still respect PID exclusion.
+    HWND hwnd = WindowFromPoint(pt);
+    if (!hwnd) return NULL;
+
+    HWND fallbackRoot = GetAncestor(hwnd, GA_ROOT);
+    if (fallbackRoot) hwnd = fallbackRoot;
+
+    DWORD fallbackPid = 0;
+    GetWindowThreadProcessId(hwnd, &fallbackPid);
+    return isPidExcluded(fallbackPid, excludedPids) ? NULL : hwnd;
+}
+
+// Resolves the top-level window under each point, honoring PID exclusion.
+// index (server mode) answers from the cached snapshot instead of walking
+// the live z-order.
+static void resolveWindowsAtPoints(const std::vector<POINT>& points, const std::vector<DWORD>& excludedPids,
+                                   std::vector<HWND>& found, WindowIndex* index = nullptr)
+{
+    found.assign(points.size(), NULL);
+    if (index)
+    {
+        index->windowsAtPoints(points, excludedPids, found);
+    }
+    else
+    {
+        findTopLevelWindowsAtPoints(points, excludedPids, found);
+    }
+
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        HWND hwnd = found[i] ? found[i] : fallbackWindowAtPoint(points[i], excludedPids);
+        if (!hwnd) continue;
+
+        // Walk up to the top-level (non-child) window
+        HWND root = GetAncestor(hwnd, GA_ROOT);
+        found[i] = root ? root : hwnd;
+    }
+}
+
+static HWND resolveWindowAtPoint(POINT pt, const std::vector<DWORD>& excludedPids, WindowIndex* index = nullptr)
+{
+    std::vector<POINT> points(1, pt);
+    std::vector<HWND> found;
+    resolveWindowsAtPoints(points, excludedPids, found, index);
+    return found[0];
+}
+
+// Kept for the whole process, so resident modes reuse names across requests.
+static ProcessNameCache g_processNames;
+
+struct WindowFields
+{
+    std::wstring title;  // UTF-16, converted to UTF-8 when written
+    std::string process; // UTF-8
+    DWORD pid = 0;
+    RECT rect = {};    // physical pixels
+    RECT dipRect = {}; // rect at the monitor's scale (monitor_dpi.h)
+    MonitorFields monitor;
+};
+
+// Reads the shared title/process/pid/bounds/monitor fields. timings, when
+// given, gets the process name lookup.
+static WindowFields readWindowFields(HWND hwnd, StageTimings* timings = nullptr)
+{
+    WindowFields fields;
+
+    // Title
+    wchar_t title[512] = {};
+    const int titleLength = GetWindowTextW(hwnd, title, 512);
+    fields.title.assign(title, titleLength > 0 ? titleLength : 0);
+
+    // Bounds
+    GetWindowRect(hwnd, &fields.rect);
+    fields.monitor = readMonitorFields(MonitorFromWindow(hwnd, MONITOR_DEFAULTTONEAREST));
+    fields.dipRect = physicalToDip(fields.rect, fields.monitor.scale);
+
+    // PID + process name
+    const int64_t processStart = timings && timings->enabled ? qpcNow() : 0;
+    GetWindowThreadProcessId(hwnd, &fields.pid);
+    fields.process = g_processNames.lookup(hwnd, fields.pid);
+    if (timings) timings->add(StageTimings::Process, processStart, qpcNow());
+    return fields;
+}
+
+static void writeRect(JsonWriter& json, const RECT& rect)
+{
+    char out[96];
+    snprintf(out, sizeof(out), "{\"x\":%ld,\"y\":%ld,\"width\":%ld,\"height\":%ld}", rect.left, rect.top,
+             rect.right - rect.left, rect.bottom - rect.top);
+    json.raw(out);
+}
+
+static std::string formatRect(const RECT& rect)
+{
+    std::string out;
+    JsonWriter json(out, 96);
+    writeRect(json, rect);
+    return out;
+}
+
+// Writes the shared fields (without braces): title, process, pid, physical
+// "bounds", "dipBounds" and the window's "monitor".
+static void writeWindowFields(JsonWriter& json, const WindowFields& fields)
+{
+    json.key("title").string(fields.title.data(), fields.title.size());
+    json.raw(',').key("process").string(fields.process);
+    json.raw(',').key("pid").number(static_cast<long long>(fields.pid));
+    json.raw(',').key("bounds");
+    writeRect(json, fields.rect);
+    json.raw(',').key("dipBounds");
+    writeRect(json, fields.dipRect);
+    json.raw(',').key("monitor").raw('{').key("id").string(fields.monitor.id);
+    json.raw(',').key("dpi").number(static_cast<long long>(fields.monitor.dpi));
+    json.raw(',').key("scale").number(fields.monitor.scale);
+    json.raw(',').key("bounds");
+    writeRect(json, fields.monitor.bounds);
+    json.raw('}');
+}
+
+static void writeWindowFields(JsonWriter& json, HWND hwnd, StageTimings* timings = nullptr)
+{
+    writeWindowFields(json, readWindowFields(hwnd, timings));
+}
+
+static std::string formatWindowFields(HWND hwnd, StageTimings* timings = nullptr)
+{
+    std::string out;
+    JsonWriter json(out);
+    writeWindowFields(json, hwnd, timings);
+    return out;
+}
@@ -0,0 +1,92 @@
+// window_tree.h - The child HWND hierarchy of a top-level window.
+//
+// One EnumChildWindows pass from the root lists every descendant, parents
+// before their children. Each is written as a flat array entry, with its
+// parent's index so the tree can be rebuilt:
+//   {"hwnd":H,"parent":P,"depth":D,"class":"...","bounds":{...},"visible":true}
+// parent is -1 for children of the root, depth 1 for them. Bounds are
+// physical screen pixels like the window's own "bounds"; visible is
+// IsWindowVisible (so false under a hidden ancestor). Descendants deeper than
+// maxDepth are walked but not written. Past TREE_MAX_ENTRIES the walk stops
+// and the response is marked "treeTruncated":true.
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <string>
+#include <unordered_map>
+
+#include "json_writer.h"
+#include "window_query.h"
+
+static const int TREE_DEFAULT_DEPTH = 4; // --tree / "tree":true
+static const int TREE_MAX_DEPTH = 16;
+static const size_t TREE_MAX_ENTRIES = 2000;
+
+namespace windowtree
+{
+
+struct Walk
+{
+    HWND root;
+    int maxDepth;
+    JsonWriter* json;
+    std::unordered_map<HWND, int> depth; // every window seen
+    std::unordered_map<HWND, int> index; // written windows: their array index
+    int written = 0;
+    bool truncated = false;
+};
+
+inline BOOL CALLBACK visitChild(HWND hwnd, LPARAM param)
+{
+    Walk* walk = reinterpret_cast<Walk*>(param);
+    if (walk->written >= static_cast<int>(TREE_MAX_ENTRIES))
+    {
+        walk->truncated = true;
+        return FALSE;
+    }
+
+    // Parents come first, so a parent missing from the map means the tree
+    // changed mid-walk; the window is then treated as a direct child.
+    HWND parent = GetAncestor(hwnd, GA_PARENT);
+    auto parentDepth = walk->depth.find(parent);
+    const int depth = parent == walk->root || parentDepth == walk->depth.end() ? 1 : parentDepth->second + 1;
+    walk->depth[hwnd] = depth;
+    if (depth > walk->maxDepth) return TRUE;
+
+    auto parentIndex = walk->index.find(parent);
+    wchar_t className[256];
+    const int classLength = GetClassNameW(hwnd, className, 256);
+    RECT rect = {};
+    GetWindowRect(hwnd, &rect);
+
+    JsonWriter& json = *walk->json;
+    if (walk->written) json.raw(',');
+    json.raw('{').key("hwnd").number(static_cast<long long>(reinterpret_cast<uintptr_t>(hwnd)));
+    const int parentAt = parentIndex == walk->index.end() ? -1 : parentIndex->second;
+    json.raw(',').key("parent").number(static_cast<long long>(parentAt));
+    json.raw(',').key("depth").number(static_cast<long long>(depth));
+    json.raw(',').key("class").string(className, classLength > 0 ? classLength : 0);
+    json.raw(',').key("bounds");
+    writeRect(json, rect);
+    json.raw(',').key("visible").boolean(IsWindowVisible(hwnd) != FALSE).raw('}');
+    walk->index[hwnd] = walk->written++;
+    return TRUE;
+}
+
+} // namespace windowtree
+
+// Appends ,"tree":[...] (and ,"treeTruncated":true when capped) for root.
+static void appendChildTree(std::string& head, HWND root, int maxDepth)
+{
+    JsonWriter json(head, 4096);
+    windowtree::Walk walk;
+    walk.root = root;
+    walk.maxDepth = maxDepth < TREE_MAX_DEPTH ? maxDepth : TREE_MAX_DEPTH;
+    walk.json = &json;
+    json.raw(',').key("tree").raw('[');
+    EnumChildWindows(root, windowtree::visitChild, reinterpret_cast<LPARAM>(&walk));
+    json.raw(']');
+    if (walk.truncated) json.raw(',').key("treeTruncated").boolean(true);
+}